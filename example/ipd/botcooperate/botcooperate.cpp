@@ -0,0 +1,21 @@
+#include "botsdk.h"
+
+#include <iostream>
+#include <string_view>
+
+using namespace std;
+
+int main() {
+    Bot::Connection judge;
+    string_view command;
+    while (judge.readLine(command)) {
+        if (command.rfind("MOVE", 0) == 0) {
+            judge.reply("COOPERATE");
+        } else if (command.rfind("NEWGAME", 0) == 0) {
+            judge.reply("READY");
+        } else {
+            cerr << "unknown command" << endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include "botsdk.h"
+
+#include <iostream>
+#include <string_view>
+
+using namespace std;
+
+// Cooperates first, then does whatever the opponent did last.
+int main() {
+    Bot::Connection judge;
+    string_view command;
+    while (judge.readLine(command)) {
+        if (command == "MOVE") {
+            judge.reply("COOPERATE");
+        } else if (command.rfind("MOVE ", 0) == 0) {
+            judge.reply(command.substr(5));
+        } else if (command.rfind("NEWGAME", 0) == 0) {
+            judge.reply("READY");
+        } else {
+            cerr << "unknown command" << endl;
+        }
+    }
+    return 0;
+}
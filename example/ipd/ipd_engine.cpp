@@ -0,0 +1,96 @@
+// Iterated prisoner's dilemma engine
+
+#include "coengine.h"
+#include "engine.h"
+#include "engineplugin.h"
+#include "exchange.h"
+#include "matrixgame.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+
+namespace Engine {
+
+using std::array;
+using std::string;
+using std::to_string;
+using std::vector;
+
+// The usual payoffs: temptation 5, reward 3, punishment 1, sucker 0.
+constexpr MatrixGame<2> IPD({"COOPERATE", "DEFECT"},
+                            {{{{{3, 3}, {0, 5}}},
+                              {{{5, 0}, {1, 1}}}}});
+
+constexpr int PLAYERS = 2;
+constexpr int ROUNDS = 100;
+constexpr int MOVE_TIMEOUT_MS = 100;
+
+// Without time control every move gets a fixed wall-clock limit; with it the
+// player's CPU budget decides and the wall clock only catches hung bots.
+int moveTimeoutMs(const PlayerData& player) {
+    int timeout = player.timeBudget().getWallTimeoutMs();
+    return timeout == -1 ? MOVE_TIMEOUT_MS : timeout;
+}
+
+// Every round each player is asked for its move with MOVE, followed from
+// the second round on by the move its opponent made in the previous round,
+// and answers COOPERATE or DEFECT. The players are asked one after the
+// other, since they are told different things, but neither learns the
+// other's move before both have moved. Bots do not know how many rounds
+// there are; the one with more points wins.
+Task<GameResult> play_game_async(vector<PlayerData>& players) {
+    try {
+        if (players.size() != PLAYERS) {
+            co_return GameResult::createError(
+                players,
+                "This game is meant for " + to_string(PLAYERS) +
+                    " players only");
+        }
+        array<long long, PLAYERS> points = {0, 0};
+        array<int, PLAYERS> moves = {-1, -1};
+        for (int round = 0; round < ROUNDS; round++) {
+            array<int, PLAYERS> lastMoves = moves;
+            for (auto& player : players) {
+                int id = player.getPlayerId();
+                string request = "MOVE";
+                if (lastMoves[1 - id] != -1)
+                    request += " " + string(IPD.name(lastMoves[1 - id]));
+                vector<PlayerData*> asked = {&player};
+                vector<Reply> replies = co_await exchange_async(
+                    asked, request, moveTimeoutMs(player));
+                if (!replies[0].ok()) {
+                    string details = string("Win by opponent error: ") +
+                                     replies[0].describe();
+                    co_return GameResult::createWin(players, players[1 - id],
+                                                    details);
+                }
+                std::string_view reply = replies[0].line;
+                std::string_view response = next_word(reply);
+                moves[id] = IPD.parse(response);
+                if (moves[id] == -1) {
+                    string details =
+                        "Win by opponent error: move not recognized: '" +
+                        string(response) + "'";
+                    co_return GameResult::createWin(players, players[1 - id],
+                                                    details);
+                }
+            }
+            const Payoff& payoff = IPD.payoff(moves[0], moves[1]);
+            points[0] += payoff.first;
+            points[1] += payoff.second;
+        }
+        co_return matrix_game_result(players, points[0], points[1]);
+    } catch (std::exception& e) {
+        co_return GameResult::createError(players, e.what());
+    }
+}
+
+GameResult play_game(vector<PlayerData>& players) noexcept {
+    return run_blocking(play_game_async(players));
+}
+
+}  // namespace Engine
+
+BOTS_JUDGE_ASYNC_ENGINE("ipd")
@@ -1,12 +1,14 @@
+#include "botsdk.h"
+
 #include <iostream>
-#include <string>
+#include <string_view>
 
 using namespace std;
 
 int main() {
-    while (true) {
-        string command;
-        getline(cin, command);
+    Bot::Connection judge;
+    string_view command;
+    while (judge.readLine(command)) {
         cerr << "unknown command" << endl;
     }
     return 0;
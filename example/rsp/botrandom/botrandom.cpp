@@ -1,30 +1,49 @@
+#include "botsdk.h"
+
+#include <cstdlib>
 #include <ctime>
 #include <iostream>
-#include <string>
+#include <string_view>
 
 using namespace std;
 
+static const char* random_move() {
+    switch (rand() % 3) {
+        case 0:
+            return "SCISSORS";
+        case 1:
+            return "ROCK";
+        default:
+            return "PAPER";
+    }
+}
+
 int main(int argc, char** argv) {
     unsigned seed = time(NULL);
     if (argc >= 2)
         seed = atoi(argv[1]);
     srand(seed);
 
-    while (true) {
-        string command;
-        getline(cin, command);
+    Bot::Connection judge;
+    string_view command;
+    while (judge.readLine(command)) {
+        long long new_seed, moves;
         if (command == "MOVE") {
-            switch (rand() % 3) {
-                case 0:
-                    cout << "SCISSORS" << endl;
-                    break;
-                case 1:
-                    cout << "ROCK" << endl;
-                    break;
-                case 2:
-                    cout << "PAPER" << endl;
-                    break;
+            // Offers to answer MOVES <k> with k moves on one line.
+            judge.write(random_move());
+            judge.reply(" BATCH");
+        } else if (command.rfind("MOVES ", 0) == 0 &&
+                   Bot::parse_int(command.substr(6), moves)) {
+            for (long long i = 0; i < moves; i++) {
+                if (i > 0)
+                    judge.write(" ");
+                judge.write(random_move());
             }
+            judge.reply("");
+        } else if (command.rfind("NEWGAME ", 0) == 0 &&
+                   Bot::parse_int(command.substr(8), new_seed)) {
+            srand(new_seed);
+            judge.reply("READY");
         } else {
             cerr << "unknown command" << endl;
         }
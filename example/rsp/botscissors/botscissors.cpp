@@ -1,14 +1,25 @@
+#include "botsdk.h"
+
 #include <iostream>
-#include <string>
+#include <string_view>
 
 using namespace std;
 
 int main() {
-    while (true) {
-        string command;
-        getline(cin, command);
+    Bot::Connection judge;
+    string_view command;
+    while (judge.readLine(command)) {
+        long long moves;
         if (command == "MOVE") {
-            cout << "SCISSORS" << endl;
+            // Offers to answer MOVES <k> with k moves on one line.
+            judge.reply("SCISSORS BATCH");
+        } else if (command.rfind("MOVES ", 0) == 0 &&
+                   Bot::parse_int(command.substr(6), moves)) {
+            for (long long i = 0; i < moves; i++)
+                judge.write(i > 0 ? " SCISSORS" : "SCISSORS");
+            judge.reply("");
+        } else if (command.rfind("NEWGAME", 0) == 0) {
+            judge.reply("READY");
         } else {
             cerr << "unknown command" << endl;
         }
@@ -1,126 +1,146 @@
 // Rock, Scissors, Paper engine
 
+#include "coengine.h"
 #include "engine.h"
+#include "engineplugin.h"
+#include "exchange.h"
+#include "matrixgame.h"
 
+#include <algorithm>
 #include <array>
-#include <cctype>
-#include <cstring>
-#include <limits>
-#include <memory>
+#include <cstdlib>
+#include <string>
+#include <string_view>
 
 namespace Engine {
 
 using std::array;
 using std::string;
 using std::to_string;
-using std::unique_ptr;
 using std::vector;
 
-class Choice {
-   public:
-    virtual bool losesAgainstPaper() const = 0;
-    virtual bool losesAgainstRock() const = 0;
-    virtual bool losesAgainstScissors() const = 0;
-    virtual bool beats(const Choice& choice) const = 0;
-};
+// A round won is worth a point.
+constexpr MatrixGame<3> RSP({"ROCK", "PAPER", "SCISSORS"},
+                            {{{{{0, 0}, {0, 1}, {1, 0}}},
+                              {{{1, 0}, {0, 0}, {0, 1}}},
+                              {{{0, 1}, {1, 0}, {0, 0}}}}});
 
-class Rock : public Choice {
-   public:
-    virtual bool losesAgainstPaper() const override { return true; }
-    virtual bool losesAgainstRock() const override { return false; }
-    virtual bool losesAgainstScissors() const override { return false; }
-    virtual bool beats(const Choice& choice) const override {
-        return choice.losesAgainstRock();
-    }
-};
-
-class Paper : public Choice {
-   public:
-    virtual bool losesAgainstPaper() const override { return false; }
-    virtual bool losesAgainstRock() const override { return false; }
-    virtual bool losesAgainstScissors() const override { return true; }
-    virtual bool beats(const Choice& choice) const override {
-        return choice.losesAgainstPaper();
-    }
-};
+constexpr int PLAYERS = 2;
+constexpr int MOVE_TIMEOUT_MS = 100;
+// A batch gets the time of its moves, up to this: a bot that offers
+// batches answers them at once, and a hung one is caught as soon.
+constexpr int MAX_BATCH_TIMEOUT_MS = 1000;
+constexpr int DEFAULT_ROUNDS = 10;
+constexpr int DEFAULT_BATCH_MOVES = 100;
 
-class Scissors : public Choice {
-   public:
-    virtual bool losesAgainstPaper() const override { return false; }
-    virtual bool losesAgainstRock() const override { return true; }
-    virtual bool losesAgainstScissors() const override { return false; }
-    virtual bool beats(const Choice& choice) const override {
-        return choice.losesAgainstScissors();
-    }
-};
+// Without time control every move gets a fixed wall-clock limit; with it the
+// players' CPU budgets decide and the wall clock only catches hung bots.
+int moveTimeoutMs(const vector<PlayerData>& players) {
+    int timeout = -1;
+    for (const auto& player : players)
+        timeout = std::max(timeout, player.timeBudget().getWallTimeoutMs());
+    return timeout == -1 ? MOVE_TIMEOUT_MS : timeout;
+}
 
-void ignoreLine(std::istream& istr) {
-    istr.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+// A positive setting from the environment, for throughput runs: RSP_ROUNDS
+// is the number of rounds of a game and RSP_BATCH the most moves asked for
+// in one request (1 for one move per exchange).
+int settingFromEnv(const char* name, int fallback) {
+    const char* value = getenv(name);
+    int setting = value != nullptr ? atoi(value) : 0;
+    return setting > 0 ? setting : fallback;
 }
 
-unique_ptr<Choice> choiceFromString(const string& str) {
-    string upperStr = str;
-    if (str == "ROCK") {
-        return unique_ptr<Choice>(new Rock);
-    } else if (str == "PAPER") {
-        return unique_ptr<Choice>(new Paper);
-    } else if (str == "SCISSORS") {
-        return unique_ptr<Choice>(new Scissors);
+// Whether every player offered to answer MOVES, by putting BATCH after its
+// first move. A player on a clock never gets batches: its increment is
+// per exchange.
+bool canBatch(const vector<PlayerData>& players, const vector<Reply>& replies) {
+    for (const auto& player : players) {
+        std::string_view reply = replies[player.getPlayerId()].line;
+        next_word(reply);
+        if (next_word(reply) != "BATCH" || player.timeBudget().isLimited())
+            return false;
     }
-    return nullptr;
+    return true;
 }
 
-constexpr int PLAYERS = 2;
-
-GameResult play_game(vector<PlayerData>& players) noexcept {
+// The judge runs it on a reactor with --concurrency, so that one thread
+// plays many matches while their bots think.
+//
+// The first round is asked for with MOVE, which every bot answers with its
+// move. If both bots offered batches the rest come K at a time: MOVES K is
+// answered with K moves on one line, and the rounds are scored one by one
+// as if they had been asked for separately.
+Task<GameResult> play_game_async(vector<PlayerData>& players) {
+    static const int rounds = settingFromEnv("RSP_ROUNDS", DEFAULT_ROUNDS);
+    static const int batchMoves =
+        settingFromEnv("RSP_BATCH", DEFAULT_BATCH_MOVES);
     try {
         if (players.size() != PLAYERS) {
-            return GameResult::createError(players, "This game is meant for " +
-                                                        to_string(PLAYERS) +
-                                                        " players only");
+            co_return GameResult::createError(
+                players,
+                "This game is meant for " + to_string(PLAYERS) +
+                    " players only");
         }
-        array<int, PLAYERS> winCount = {0, 0};
-        constexpr int ROUNDS = 10;
-        for (int i = 0; i < ROUNDS; i++) {
-            vector<unique_ptr<Choice>> choices;
+        array<long long, PLAYERS> winCount = {0, 0};
+        bool batched = false;
+        for (int round = 0; round < rounds;) {
+            int moves = batched ? std::min(batchMoves, rounds - round) : 1;
+            string request = batched ? "MOVES " + to_string(moves) : "MOVE";
+            int timeout = moveTimeoutMs(players);
+            if (batched)
+                timeout = std::min(timeout * moves, MAX_BATCH_TIMEOUT_MS);
+            // Both players move simultaneously, so ask them at once.
+            vector<Reply> replies =
+                co_await exchange_async(players, request, timeout);
+            array<std::string_view, PLAYERS> answers;
             for (auto& player : players) {
-                auto& stream = player.playerStream();
-                string response;
-                stream.set_timeout_ms(100);
-                stream << "MOVE" << std::endl;
-                stream >> response;
-                ignoreLine(stream);
-                if (stream.eof()) {
-                    string details = string("Win by opponent error: ") +
-                                     stream.get_last_strerror();
-                    return GameResult::createWin(
-                        players, players[1 - player.getPlayerId()], details);
-                }
-                auto choiceP = choiceFromString(response);
-                if (!choiceP) {
-                    string details =
-                        "Win by opponent error: move not recognized: '" +
-                        response + "'";
-                    return GameResult::createWin(
-                        players, players[1 - player.getPlayerId()], details);
+                int id = player.getPlayerId();
+                answers[id] = replies[id].line;
+            }
+            // Player by player, a failed reply loses before the move is
+            // read, as in a round asked for alone.
+            for (int i = 0; i < moves; i++) {
+                array<int, PLAYERS> choices;
+                for (auto& player : players) {
+                    int id = player.getPlayerId();
+                    const Reply& reply = replies[id];
+                    if (!reply.ok()) {
+                        string details = string("Win by opponent error: ") +
+                                         reply.describe();
+                        co_return GameResult::createWin(players,
+                                                        players[1 - id],
+                                                        details);
+                    }
+                    std::string_view response = next_word(answers[id]);
+                    choices[id] = RSP.parse(response);
+                    if (choices[id] == -1) {
+                        string details =
+                            "Win by opponent error: move not recognized: '" +
+                            string(response) + "'";
+                        co_return GameResult::createWin(players,
+                                                        players[1 - id],
+                                                        details);
+                    }
                 }
-                choices.push_back(std::move(choiceP));
+                const Payoff& payoff = RSP.payoff(choices[0], choices[1]);
+                winCount[0] += payoff.first;
+                winCount[1] += payoff.second;
             }
-            if (choices[0]->beats(*choices[1]))
-                winCount[0]++;
-            if (choices[1]->beats(*choices[0]))
-                winCount[1]++;
-        }
-        int winnerId = (winCount[0] > winCount[1] ? 0 : 1);
-        string details = to_string(winCount[winnerId]) + "-" +
-                         to_string(winCount[1 - winnerId]);
-        if (winCount[0] == winCount[1]) {
-            return GameResult::createDraw(players, details);
+            if (round == 0)
+                batched = batchMoves > 1 && canBatch(players, replies);
+            round += moves;
         }
-        return GameResult::createWin(players, players[winnerId], details);
+        co_return matrix_game_result(players, winCount[0], winCount[1]);
     } catch (std::exception& e) {
-        return GameResult::createError(players, e.what());
+        co_return GameResult::createError(players, e.what());
     }
 }
 
+GameResult play_game(vector<PlayerData>& players) noexcept {
+    return run_blocking(play_game_async(players));
+}
+
 }  // namespace Engine
+
+BOTS_JUDGE_ASYNC_ENGINE("rsp")
@@ -0,0 +1,77 @@
+#ifndef BOTPOOL_H
+#define BOTPOOL_H
+
+#include "common.h"
+#include "launcher.h"
+#include "playerstream.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Judge {
+
+// A running bot with the judge's ends of its stdin/stdout pipes.
+struct BotProcess {
+    std::string program;
+    ChildProcess process;
+    filedesc_t read_fd;   // the bot's stdout
+    filedesc_t write_fd;  // the bot's stdin
+    filedesc_t err_fd;    // where the bot's stderr goes
+    int matches_played;
+    off_t err_logged = 0;  // how much of err_fd is in the match log
+    // Set if the bot is talked to over shared memory instead of the pipes.
+    std::shared_ptr<player_transport> transport = nullptr;
+};
+
+// Starts `program` with `seed` as its argument, its stdin and stdout
+// connected to fresh pipes and its stderr to `err_fd`, and with a
+// shared-memory transport if `shm_transport`. A bot that cannot be started
+// gets an explanation in its stderr file and looks to the engine like a bot
+// that exited immediately.
+std::unique_ptr<BotProcess> spawn_bot(const std::string& program,
+                                      unsigned seed,
+                                      filedesc_t err_fd,
+                                      bool shm_transport);
+
+// Kills the bot, reaps it and closes the judge's descriptors.
+void terminate_bot(BotProcess& bot);
+
+// Keeps bots alive between matches for programs that implement the reset
+// protocol: on "NEWGAME <seed>" the bot forgets the previous game, reseeds
+// and answers "READY". Lines still in flight from the previous game are
+// skipped. Programs that never answer are remembered and not pooled again.
+class BotPool {
+   public:
+    explicit BotPool(int reset_timeout_ms);
+    ~BotPool();
+
+    // An idle bot running `program` that has been reset for a new game with
+    // `seed`, or nullptr if the caller has to start a fresh one. Dead or
+    // unresponsive bots found on the way are terminated.
+    std::unique_ptr<BotProcess> acquire(const std::string& program,
+                                        unsigned seed);
+
+    // Returns a bot after its match; it is terminated instead if its program
+    // does not support resets.
+    void release(std::unique_ptr<BotProcess> bot);
+
+    BotPool(const BotPool&) = delete;
+    BotPool& operator=(const BotPool&) = delete;
+
+   private:
+    enum class Support { Unknown, Yes, No };
+
+    bool reset(BotProcess& bot, unsigned seed);
+
+    int reset_timeout_ms;
+    std::mutex mutex;
+    std::map<std::string, Support> support;
+    std::map<std::string, std::vector<std::unique_ptr<BotProcess>>> idle;
+};
+
+}  // namespace Judge
+
+#endif  // !BOTPOOL_H
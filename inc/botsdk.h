@@ -0,0 +1,230 @@
+#ifndef BOTSDK_H
+#define BOTSDK_H
+
+// The bot side of the judge's protocol: newline-terminated lines and the
+// binary frames of framing.h, the same framing playerstream uses on the
+// judge's side. Unlike iostreams, reads and writes go straight to the
+// descriptors (or to the shared-memory rings when the judge runs with
+// --transport shm) through fixed buffers, so answering a message allocates
+// nothing, and output leaves only when it is flushed:
+//
+//     Bot::Connection judge;
+//     std::string_view command;
+//     while (judge.readLine(command)) {
+//         if (command == "MOVE")
+//             judge.reply("ROCK");
+//     }
+//
+// Header-only, so that bots do not need to link against the judge.
+
+#include "framing.h"
+#include "shmbot.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace Bot {
+
+// Parses a whole decimal integer such as the seed of "NEWGAME <seed>".
+inline bool parse_int(std::string_view text, long long& value) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+class Connection {
+   public:
+    static constexpr size_t BUF_SIZE = 1 << 16;
+
+    // Shared memory if the judge set it up, stdin and stdout otherwise.
+    Connection() : Connection(ShmChannel::fromEnvironment()) {}
+
+    // Over `channel`, or stdin and stdout if it is null.
+    explicit Connection(std::unique_ptr<ShmChannel> p_channel)
+        : Connection(STDIN_FILENO, STDOUT_FILENO) {
+        channel = std::move(p_channel);
+    }
+
+    Connection(int p_input_fd, int p_output_fd)
+        : input_fd(p_input_fd),
+          output_fd(p_output_fd),
+          readbuf(BUF_SIZE),
+          writebuf(BUF_SIZE) {}
+
+    // Output still buffered is flushed.
+    ~Connection() { flush(); }
+
+    bool isShm() const { return channel != nullptr; }
+
+    // Reads the next line into `line`, without its newline. The view points
+    // into the connection's buffer and stays valid until the next read.
+    // Returns false once the judge is gone. Pending output is not flushed.
+    bool readLine(std::string_view& line) {
+        if (read_begin == read_end)
+            read_begin = read_end = scanned = 0;
+        while (true) {
+            char* begin = readbuf.data() + read_begin;
+            char* newline = static_cast<char*>(
+                memchr(readbuf.data() + scanned, '\n', read_end - scanned));
+            if (newline != nullptr) {
+                line = std::string_view(begin, newline - begin);
+                read_begin = scanned = newline + 1 - readbuf.data();
+                return true;
+            }
+            scanned = read_end;
+            if (!readMore())
+                return false;
+        }
+    }
+
+    // Reads the next binary frame into `frame`, which stays valid until the
+    // next read like a line. Returns false once the judge is gone or if the
+    // frame is larger than the maximum size.
+    bool readFrame(std::string_view& frame) {
+        if (read_begin == read_end)
+            read_begin = read_end = scanned = 0;
+        while (read_end - read_begin < Frame::HEADER_SIZE) {
+            if (!readMore())
+                return false;
+        }
+        size_t size = Frame::decode_length(readbuf.data() + read_begin);
+        if (size > max_frame_size)
+            return false;
+        while (read_end - read_begin < Frame::HEADER_SIZE + size) {
+            if (!readMore())
+                return false;
+        }
+        frame = std::string_view(
+            readbuf.data() + read_begin + Frame::HEADER_SIZE, size);
+        read_begin += Frame::HEADER_SIZE + size;
+        scanned = read_begin;
+        return true;
+    }
+
+    void setMaxFrameSize(size_t max_size) { max_frame_size = max_size; }
+
+    // Buffers `data`; nothing is sent before flush().
+    void write(std::string_view data) {
+        if (write_end + data.size() > writebuf.size()) {
+            flush();
+            if (data.size() > writebuf.size()) {
+                writeAll(data.data(), data.size());
+                return;
+            }
+        }
+        memcpy(writebuf.data() + write_end, data.data(), data.size());
+        write_end += data.size();
+    }
+
+    void write(long long value) {
+        char digits[24];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+        write(std::string_view(digits, end - digits));
+    }
+
+    void writeLine(std::string_view line) {
+        write(line);
+        write(std::string_view("\n", 1));
+    }
+
+    // Buffers a binary frame holding `frame`.
+    void writeFrame(std::string_view frame) {
+        char header[Frame::HEADER_SIZE];
+        Frame::encode_length(frame.size(), header);
+        write(std::string_view(header, sizeof(header)));
+        write(frame);
+    }
+
+    // Sends everything written so far. Returns false if the judge is gone,
+    // which a bot usually finds out on its next read anyway.
+    bool flush() {
+        if (write_end > 0)
+            writeAll(writebuf.data(), write_end);
+        write_end = 0;
+        return !failed;
+    }
+
+    // Writes `line` and flushes: the usual answer to a command.
+    bool reply(std::string_view line) {
+        writeLine(line);
+        return flush();
+    }
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+   private:
+    // Reads more input behind what is buffered. Makes room by dropping what
+    // was read before, and only grows for messages longer than the buffer.
+    bool readMore() {
+        if (read_end == readbuf.size()) {
+            if (read_begin > 0) {
+                memmove(readbuf.data(), readbuf.data() + read_begin,
+                        read_end - read_begin);
+                read_end -= read_begin;
+                scanned -= read_begin;
+                read_begin = 0;
+            } else {
+                readbuf.resize(2 * readbuf.size());
+            }
+        }
+        ssize_t n =
+            readSome(readbuf.data() + read_end, readbuf.size() - read_end);
+        if (n <= 0)
+            return false;
+        read_end += n;
+        return true;
+    }
+
+    ssize_t readSome(char* buf, size_t len) {
+        if (channel)
+            return channel->read(buf, len);
+        while (true) {
+            ssize_t n = ::read(input_fd, buf, len);
+            if (n != -1 || errno != EINTR)
+                return n;
+        }
+    }
+
+    void writeAll(const char* data, size_t len) {
+        if (failed)
+            return;
+        if (channel) {
+            failed = !channel->write(data, len);
+            return;
+        }
+        while (len > 0) {
+            ssize_t n = ::write(output_fd, data, len);
+            if (n == -1 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                failed = true;
+                return;
+            }
+            data += n;
+            len -= n;
+        }
+    }
+
+    std::unique_ptr<ShmChannel> channel;
+    int input_fd;
+    int output_fd;
+    std::vector<char> readbuf;
+    size_t read_begin = 0;
+    size_t read_end = 0;
+    size_t scanned = 0;
+    size_t max_frame_size = Frame::DEFAULT_MAX_SIZE;
+    std::vector<char> writebuf;
+    size_t write_end = 0;
+    bool failed = false;
+};
+
+}  // namespace Bot
+
+#endif  // !BOTSDK_H
@@ -0,0 +1,236 @@
+#ifndef COENGINE_H
+#define COENGINE_H
+
+// Game engines written as C++20 coroutines. Where play_game() blocks a
+// thread while it waits for the players, play_game_async() suspends at
+// every co_await on them, and a Reactor, an epoll loop the judge runs on
+// each worker thread, resumes it once their replies are in. One thread then
+// drives many matches (--concurrency):
+//
+//     Task<GameResult> play_game_async(std::vector<PlayerData>& players) {
+//         std::vector<Reply> replies =
+//             co_await exchange_async(players, "MOVE", 100);
+//         ...
+//         co_return GameResult::createDraw(players);
+//     }
+//
+//     GameResult play_game(std::vector<PlayerData>& players) noexcept {
+//         return run_blocking(play_game_async(players));
+//     }
+//
+// As with play_game(), exceptions that escape a match end the judge.
+
+#include "exchange.h"
+
+#include <coroutine>
+#include <ctime>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Engine {
+
+// A coroutine that produces a T. It starts when it is awaited, or when a
+// Reactor is given it, and resumes its awaiter when it returns.
+template <class T>
+class Task {
+   public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr exception;
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(
+                *this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept {
+            struct Resumer {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<promise_type> self) noexcept {
+                    std::coroutine_handle<> next =
+                        self.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            return Resumer{};
+        }
+        void return_value(T result) { value.emplace(std::move(result)); }
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    ~Task() {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+    T await_resume() {
+        if (handle.promise().exception)
+            std::rethrow_exception(handle.promise().exception);
+        return std::move(*handle.promise().value);
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+   private:
+    explicit Task(std::coroutine_handle<promise_type> p_handle)
+        : handle(p_handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Resumes coroutines when the descriptors they wait for become ready or
+// their deadlines pass. A reactor belongs to the thread that runs it.
+class Reactor {
+   public:
+    using callback_t = std::function<void(bool ready)>;
+
+    Reactor();
+    ~Reactor();
+
+    // The reactor running on this thread; exits with an error if none is.
+    static Reactor& current();
+
+    // Calls `callback` once: with true as soon as `fd` is ready for
+    // `events`, POLLIN and/or POLLOUT (or hung up), or with false at
+    // `deadline` on CLOCK_MONOTONIC. Returns an id for cancel().
+    uint64_t watch(int fd,
+                   short events,
+                   const timespec& deadline,
+                   callback_t callback);
+    void cancel(uint64_t id);
+
+    // Starts `task` right away and calls `on_done` with its result when it
+    // returns, both from this reactor's thread.
+    template <class T>
+    void spawn(Task<T> task, std::function<void(T)> on_done) {
+        Running running(this);
+        active_tasks++;
+        drive(this, std::move(task), std::move(on_done));
+    }
+
+    // Tasks spawned and not returned yet.
+    size_t tasks() const { return active_tasks; }
+
+    // Waits for the next descriptor or deadline and runs the callbacks
+    // that are due. Returns false if nothing is watched.
+    bool runOnce();
+    // Runs until nothing is watched any more.
+    void run() {
+        while (runOnce()) {
+        }
+    }
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+   private:
+    // Makes this the current reactor while it runs coroutines.
+    class Running {
+       public:
+        explicit Running(Reactor* reactor);
+        ~Running();
+
+       private:
+        Reactor* previous;
+    };
+
+    // The coroutine under every spawned task; it frees itself when done.
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    template <class T>
+    static Detached drive(Reactor* reactor,
+                          Task<T> task,
+                          std::function<void(T)> on_done) {
+        T result = co_await task;
+        on_done(std::move(result));
+        reactor->active_tasks--;
+    }
+
+    struct Watch {
+        int fd;
+        callback_t callback;
+    };
+    struct Deadline {
+        timespec when;
+        uint64_t id;
+        bool operator>(const Deadline& other) const;
+    };
+
+    void fire(uint64_t id, bool ready);
+
+    int epoll_fd;
+    uint64_t next_id = 1;
+    std::unordered_map<uint64_t, Watch> watches;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<>>
+        deadlines;
+    size_t active_tasks = 0;
+};
+
+// exchange() for coroutines: co_await it for the replies. The coroutine is
+// suspended on the current Reactor while the players think, and while a
+// player is too busy to take its message.
+class ExchangeAwaitable {
+   public:
+    ExchangeAwaitable(std::vector<PlayerData*> players,
+                      std::string message,
+                      int timeout_ms);
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> awaiter);
+    std::vector<Reply> await_resume() { return round->finish(); }
+
+   private:
+    void watch(size_t i);
+    void onEvent(size_t i, bool ready);
+
+    std::vector<PlayerData*> players;
+    std::string message;
+    int timeout_ms;
+    std::optional<ExchangeRound> round;
+    Reactor* reactor = nullptr;
+    std::vector<uint64_t> watches;  // per player, 0 when not watched
+    std::coroutine_handle<> handle;
+};
+
+ExchangeAwaitable exchange_async(const std::vector<PlayerData*>& players,
+                                 const std::string& message,
+                                 int timeout_ms);
+
+ExchangeAwaitable exchange_async(std::vector<PlayerData>& players,
+                                 const std::string& message,
+                                 int timeout_ms);
+
+// Plays a coroutine engine's match on a reactor of its own, blocking the
+// calling thread like play_game().
+GameResult run_blocking(Task<GameResult> task);
+
+// The coroutine form of play_game(), for engines that provide one.
+Task<GameResult> play_game_async(std::vector<PlayerData>& players);
+
+}  // namespace Engine
+
+#endif  // !COENGINE_H
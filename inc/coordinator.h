@@ -0,0 +1,201 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+// Spreading the matches of a run over judge processes on many hosts. A
+// coordinator owns the run: it listens on a socket and hands matches out
+// to the workers that connect; every worker plays them with its own bots,
+// engines and settings, and sends the results back.
+//
+// The protocol is lines of tab-separated fields. A worker starts with
+//     HELLO <version> <game>,<game>,... <token>
+// and the coordinator answers RUN <seed>, the run seed the bots' seeds are
+// derived from, or ERROR <why> if the worker lacks a game of the run or
+// the token is not the coordinator's. Both take the token from
+// BOTS_JUDGE_TOKEN; it may be empty only if the coordinator listens on a
+// unix socket or a loopback address.
+// Then the worker asks for up to n matches with GET <n>, and gets
+//     MATCHES <k>
+//     MATCH <ticket> <battle id> <round> <game> <program> <program> ...
+// for 1 <= k <= n once there are matches to play, or END once the run is
+// over. It reports every match with
+//     RESULT <ticket> <type> <game_us> <score>;<score>;... <details>
+// where <type> is a GameResult::ResultType. A worker whose connection
+// breaks, or that keeps a match past its deadline, is lost, and its
+// matches go back to the front of the queue.
+
+#include "common.h"
+#include "engine.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Judge {
+
+// A match as the coordinator hands it out.
+struct RemoteMatch {
+    int job_id;  // the coordinator's own; workers see tickets instead
+    int battle_id;
+    int round;  // of the match among those of its bots at its game
+    std::string game;
+    std::vector<std::string> programs;
+};
+
+// What a worker reports about a match it played.
+struct RemoteResult {
+    uint64_t ticket;
+    Engine::GameResult::ResultType type;
+    long long game_us;
+    std::vector<double> scores;
+    std::string details;
+};
+
+class Coordinator {
+   public:
+    // Returns false once no more results are needed.
+    using result_fun_t = std::function<bool(const RemoteMatch& match,
+                                            const RemoteResult& result,
+                                            const std::string& worker)>;
+
+    // Listens on `address`: "unix:PATH", or "HOST:PORT" for TCP, where an
+    // empty HOST means the loopback address and port 0 any free port.
+    // Workers must have every one of `games` and know `token`. A worker
+    // that keeps a match for twice `match_timeout_ms`, time for the
+    // matches it had already and then this one, is lost. Exits with an
+    // error if it cannot listen.
+    Coordinator(const std::string& address,
+                uint64_t run_seed,
+                std::vector<std::string> games,
+                int match_timeout_ms,
+                std::string token);
+    // Ends the run, as finish() does.
+    ~Coordinator();
+
+    // Where workers connect, with the actual port if 0 was asked for.
+    const std::string& getAddress() const { return bound_address; }
+    // Matches given back to the queue because their worker was lost.
+    int getRequeued() const { return requeued; }
+
+    // Hands `matches` out to the workers, connected already or later, and
+    // reports every result to `on_result`, until all are in or `on_result`
+    // returns false. Results of matches still out then are ignored.
+    // Workers stay connected for the next call.
+    void run(const std::vector<RemoteMatch>& matches,
+             const result_fun_t& on_result);
+
+    // Tells every worker that the run is over and disconnects them.
+    void finish();
+
+    Coordinator(const Coordinator&) = delete;
+    Coordinator& operator=(const Coordinator&) = delete;
+
+   private:
+    using clock = std::chrono::steady_clock;
+
+    // A match handed out to a worker.
+    struct Ticket {
+        size_t index;  // in the matches of this run
+        clock::time_point deadline;
+    };
+
+    struct Connection {
+        filedesc_t fd;
+        std::string name;
+        std::string input;
+        std::string output;
+        bool greeted = false;
+        bool closing = false;  // close once the output is sent
+        int wanted = 0;        // matches asked for with GET, not sent yet
+        std::map<uint64_t, Ticket> out;
+    };
+
+    // The state of one run() call.
+    struct Run {
+        const std::vector<RemoteMatch>& matches;
+        const result_fun_t& on_result;
+        std::deque<size_t> queue;
+        size_t left;
+        bool stopped = false;
+    };
+
+    void accept();
+    void handOut(Run& run);
+    bool receive(Connection& connection, Run& run);
+    bool handle(Connection& connection, const std::string& line, Run& run);
+    bool flush(Connection& connection);
+    void drop(Connection& connection, Run& run, const std::string& why);
+    void removeClosed();
+    void expire(Run& run);
+    int pollTimeoutMs() const;
+
+    filedesc_t listen_fd;
+    std::string unix_path;  // removed when the coordinator is done
+    std::string bound_address;
+    uint64_t run_seed;
+    std::vector<std::string> games;
+    clock::duration match_timeout;
+    std::string token;
+    std::vector<std::unique_ptr<Connection>> connections;
+    int next_worker = 1;
+    uint64_t next_ticket = 1;
+    int requeued = 0;
+    bool finished = false;
+};
+
+// A worker's connection to its coordinator; its methods may be called from
+// several threads at once.
+class WorkerClient {
+   public:
+    // Connects to `address` (see Coordinator) and introduces the worker
+    // with the games it has and the coordinator's token. Exits with an
+    // error if it cannot connect or the coordinator refuses it.
+    WorkerClient(const std::string& address,
+                 const std::vector<std::string>& games,
+                 const std::string& token);
+    ~WorkerClient();
+
+    uint64_t getRunSeed() const { return run_seed; }
+
+    // The next match to play, with its ticket in `job_id`, fetching up to
+    // `batch` matches when none are left over; nothing once the run is
+    // over. Without `wait` it returns nothing rather than wait for the
+    // coordinator or for another thread's call, and the matches it asked
+    // for come with a later call. Exits with an error if the coordinator
+    // goes away.
+    std::optional<RemoteMatch> next(int batch, bool wait = true);
+
+    // Reports a match. A coordinator that has ended the run or gone away
+    // does not want it any more, so failures are ignored.
+    void sendResult(const RemoteResult& result);
+
+    WorkerClient(const WorkerClient&) = delete;
+    WorkerClient& operator=(const WorkerClient&) = delete;
+
+   private:
+    std::string readLine();
+    void readAvailable();
+    bool answerBuffered() const;
+    void send(const std::string& data);
+
+    filedesc_t fd;
+    std::string address;
+    uint64_t run_seed = 0;
+    std::mutex read_mutex;  // serializes next()
+    std::mutex write_mutex;
+    std::string input;
+    std::deque<RemoteMatch> fetched;
+    bool asked = false;  // a GET is waiting for its answer
+    bool disconnected = false;  // by the coordinator, seen by readAvailable()
+    bool ended = false;
+};
+
+}  // namespace Judge
+
+#endif  // !COORDINATOR_H
@@ -3,6 +3,7 @@
 
 #include "common.h"
 #include "playerstream.h"
+#include "timebudget.h"
 
 #include <string>
 #include <vector>
@@ -16,13 +17,25 @@ class PlayerData {
                filedesc_t err_fd,
                std::string program_name,
                int player_id);
+    // A player talking to the judge through `transport` instead of pipes.
+    PlayerData(std::shared_ptr<player_transport> transport,
+               filedesc_t err_fd,
+               std::string program_name,
+               int player_id);
 
     const std::string& getProgramName() const { return program_name; }
     int getPlayerId() const { return player_id; }
 
     playerstream& playerStream() { return *player_stream; }
+    const playerstream& playerStream() const { return *player_stream; }
     std::ostream& errorStream() { return *error_stream; }
 
+    // The player's CPU time budget; unlimited unless the judge runs with
+    // time control.
+    TimeBudget& timeBudget() { return time_budget; }
+    const TimeBudget& timeBudget() const { return time_budget; }
+    void setTimeBudget(const TimeBudget& budget) { time_budget = budget; }
+
     PlayerData& operator=(const PlayerData&) = delete;
     PlayerData& operator=(PlayerData&&) = default;
     PlayerData(const PlayerData&) = delete;
@@ -33,6 +46,7 @@ class PlayerData {
     int player_id;
     std::unique_ptr<playerstream> player_stream;
     std::unique_ptr<std::ostream> error_stream;
+    TimeBudget time_budget;
 };
 
 struct GameResult {
@@ -40,6 +54,9 @@ struct GameResult {
 
     ResultType type;
     std::vector<double> player_scores;
+    // How long every player took to answer the engine's requests, filled
+    // in from the players' streams by the create functions.
+    std::vector<latency_histogram> player_latencies;
 
     std::string pretty_result;
 
@@ -53,8 +70,15 @@ struct GameResult {
     static GameResult createError(const std::vector<PlayerData>& players,
                                   std::string error_details);
 
+    // A result the judge kept from an earlier run, e.g. in its result
+    // cache. It has no latencies, since nobody answered this time.
+    static GameResult createRecorded(ResultType type,
+                                     std::vector<double> player_scores,
+                                     std::string pretty_result);
+
    private:
     GameResult();
+    void setLatencies(const std::vector<PlayerData>& players);
 };
 
 GameResult play_game(std::vector<PlayerData>& players) noexcept;
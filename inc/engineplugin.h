@@ -0,0 +1,81 @@
+#ifndef ENGINEPLUGIN_H
+#define ENGINEPLUGIN_H
+
+// Game engines built as shared objects, so that one judge can host several
+// games. An engine plugin is compiled from the same source as an engine
+// linked into the judge, with -fPIC, and names itself once:
+//
+//     BOTS_JUDGE_ENGINE("my_game")
+//
+// or BOTS_JUDGE_ASYNC_ENGINE("my_game") if it also has a play_game_async()
+// (see coengine.h). Either exports the C entry point the judge looks up
+// with dlsym(). The descriptor it returns carries the judge's own
+// PlayerData and GameResult types, so a plugin has to be built against the
+// judge's headers; `abi_version` is how the judge notices one that was
+// not. Plugins use the judge's engine library (exchange(),
+// GameResult::createWin(), ...) from the judge that loads them, which is
+// linked with -rdynamic for that.
+
+#include "coengine.h"
+#include "engine.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Version 2 added play_game_async; the judge still loads version 1.
+#define BOTS_JUDGE_ENGINE_ABI_VERSION 2
+#define BOTS_JUDGE_ENGINE_SYMBOL "bots_judge_engine_v1"
+
+extern "C" {
+
+struct bots_judge_engine {
+    uint32_t abi_version;
+    const char* name;
+    Engine::GameResult (*play_game)(
+        std::vector<Engine::PlayerData>& players) noexcept;
+    // Null if the engine has no coroutine form.
+    Engine::Task<Engine::GameResult> (*play_game_async)(
+        std::vector<Engine::PlayerData>& players);
+};
+
+typedef const bots_judge_engine* (*bots_judge_engine_fn)();
+}
+
+#define BOTS_JUDGE_ENGINE_WITH(engine_name, async_fun)                 \
+    extern "C" __attribute__((visibility("default"))) const            \
+        bots_judge_engine* bots_judge_engine_v1() {                    \
+        static const bots_judge_engine engine = {                      \
+            BOTS_JUDGE_ENGINE_ABI_VERSION, engine_name,                \
+            &Engine::play_game, async_fun};                            \
+        return &engine;                                                \
+    }
+#define BOTS_JUDGE_ENGINE(engine_name) \
+    BOTS_JUDGE_ENGINE_WITH(engine_name, nullptr)
+#define BOTS_JUDGE_ASYNC_ENGINE(engine_name) \
+    BOTS_JUDGE_ENGINE_WITH(engine_name, &Engine::play_game_async)
+
+namespace Judge {
+
+// A game the judge plays matches of: the engine linked into it, or one
+// loaded from a plugin.
+struct Game {
+    std::string name;
+    // The file the engine's code was loaded from.
+    std::string binary;
+    Engine::GameResult (*play_game)(
+        std::vector<Engine::PlayerData>& players) noexcept;
+    // Null if the engine has no coroutine form.
+    Engine::Task<Engine::GameResult> (*play_game_async)(
+        std::vector<Engine::PlayerData>& players) = nullptr;
+};
+
+// Loads the engine plugin at `path`, which stays loaded for the rest of the
+// run. Exits with an error if it cannot be loaded or was built for an ABI
+// version the judge does not know. A path without a slash is looked up like
+// a library.
+Game load_engine_plugin(const std::string& path);
+
+}  // namespace Judge
+
+#endif  // !ENGINEPLUGIN_H
@@ -0,0 +1,95 @@
+#ifndef EXCHANGE_H
+#define EXCHANGE_H
+
+#include "engine.h"
+
+#include <poll.h>
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+namespace Engine {
+
+struct Reply {
+    enum Status { Ok, Timeout, Eof, Error };
+
+    Status status;
+    // The reply line without its trailing newline; for failed replies,
+    // whatever part of the line had arrived.
+    std::string line;
+    // errno-style cause of a failed reply (ETIME for timeouts).
+    int errnum;
+    // How long the player took to answer, from sending the message to
+    // reading the end of the reply; 0 if no reply line arrived.
+    long long think_us = 0;
+
+    bool ok() const { return status == Ok; }
+
+    // "EOF" or "EOF: <strerror>", in the style of get_last_strerror().
+    std::string describe() const;
+};
+
+// Longest reply line accepted by exchange(); longer lines fail with EMSGSIZE.
+constexpr size_t MAX_REPLY_LINE = 1 << 20;
+
+// Sends `message` followed by a newline to every player and waits for one
+// reply line from each of them. The replies are gathered concurrently under
+// a single deadline `timeout_ms` after the call, so a round of simultaneous
+// moves takes as long as the slowest player rather than the sum of all.
+// The deadline is absolute, so a player cannot extend it by sending its
+// reply a few bytes at a time. Replies are returned in the order of
+// `players`.
+//
+// Players with a limited TimeBudget have their clock started when the
+// message is sent and stopped when their reply arrives; a reply that
+// exhausts the budget is reported as a Timeout.
+std::vector<Reply> exchange(const std::vector<PlayerData*>& players,
+                            const std::string& message,
+                            int timeout_ms);
+
+std::vector<Reply> exchange(std::vector<PlayerData>& players,
+                            const std::string& message,
+                            int timeout_ms);
+
+// One round of exchange(), for callers that wait for the players' fds
+// themselves, like the coroutine exchange of coengine.h. The message goes
+// out on construction as far as each player's output takes it without
+// blocking; after that, getWaitFor() tells what to wait for before ready()
+// sends the rest of the message or reads the reply, and finish() gives the
+// replies once none is pending or the deadline passed. A message that is
+// not sent whole by the deadline counts as a timeout.
+class ExchangeRound {
+   public:
+    ExchangeRound(const std::vector<PlayerData*>& players,
+                  const std::string& message,
+                  int timeout_ms);
+
+    const timespec& getDeadline() const { return deadline; }
+    // Indices of the players whose message or reply is still due.
+    const std::vector<size_t>& getPending() const { return pending; }
+    // The fd of a pending player, with POLLOUT while its message is being
+    // sent and POLLIN afterwards (a transport's poll fd is always POLLIN).
+    pollfd getWaitFor(size_t i) const;
+
+    void ready(size_t i);
+    // Fails every pending reply with `errnum`.
+    void fail(int errnum);
+    // The replies, where those still pending have timed out.
+    std::vector<Reply> finish();
+
+   private:
+    bool isSending(size_t i) const { return sent[i] < request.size(); }
+    bool advance(size_t i, bool may_read);
+
+    std::vector<PlayerData*> players;
+    std::string request;
+    std::vector<size_t> sent;  // bytes of `request` each player was sent
+    std::vector<Reply> replies;
+    std::vector<size_t> pending;
+    timespec deadline;
+};
+
+}  // namespace Engine
+
+#endif  // !EXCHANGE_H
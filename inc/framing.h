@@ -0,0 +1,33 @@
+#ifndef FRAMING_H
+#define FRAMING_H
+
+// Binary framing shared by playerbuf and the bot SDK: a frame is its length
+// as a 4-byte little-endian integer followed by that many bytes. Frames and
+// newline-terminated lines may be mixed on one stream.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Frame {
+
+constexpr size_t HEADER_SIZE = 4;
+
+// Frames larger than this are rejected unless a side raises its limit.
+constexpr size_t DEFAULT_MAX_SIZE = 1 << 20;
+
+inline void encode_length(uint32_t length, char* header) {
+    for (size_t i = 0; i < HEADER_SIZE; i++)
+        header[i] = static_cast<char>(length >> (8 * i));
+}
+
+inline uint32_t decode_length(const char* header) {
+    uint32_t length = 0;
+    for (size_t i = 0; i < HEADER_SIZE; i++)
+        length |= static_cast<uint32_t>(static_cast<unsigned char>(header[i]))
+                  << (8 * i);
+    return length;
+}
+
+}  // namespace Frame
+
+#endif  // !FRAMING_H
@@ -0,0 +1,50 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Response times in microseconds, kept in a fixed log-linear histogram: the
+// values below 8 exactly, larger ones in 8 buckets per power of two, so
+// that any percentile is off by at most 1/16 of its value. Recording is a
+// few arithmetic operations, and histograms of many matches merge by
+// adding up their buckets.
+class latency_histogram {
+   public:
+    void record(long long us);
+    void record_timeout() { timeouts_++; }
+    void merge(const latency_histogram& other);
+
+    // Responses recorded, not counting timeouts.
+    uint64_t count() const { return count_; }
+    uint64_t timeouts() const { return timeouts_; }
+    long long total_us() const { return total_us_; }
+    long long max_us() const { return max_us_; }
+    long long mean_us() const;
+    // The response time `fraction` of the responses did not exceed, e.g.
+    // 0.99 for the 99th percentile; 0 without responses.
+    long long percentile_us(double fraction) const;
+
+    // "responses=N mean_us=... p50_us=... p99_us=... max_us=... timeouts=N"
+    std::string summary() const;
+
+   private:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // Up to 2^40 us, about 12 days; longer times land in the last bucket.
+    static constexpr int MAX_EXPONENT = 40;
+    static constexpr int BUCKETS =
+        SUB_BUCKETS * (MAX_EXPONENT - SUB_BUCKET_BITS + 2);
+
+    static int bucket_of(long long us);
+    static long long bucket_value(int bucket);
+
+    std::array<uint32_t, BUCKETS> counts_{};
+    uint64_t count_ = 0;
+    uint64_t timeouts_ = 0;
+    long long total_us_ = 0;
+    long long max_us_ = 0;
+};
+
+#endif  // !LATENCY_H
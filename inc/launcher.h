@@ -0,0 +1,54 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include "common.h"
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace Judge {
+
+// `parent_fd` of the judge becomes `child_fd` in the launched program. All
+// other descriptors of the judge are expected to be close-on-exec.
+struct FdMapping {
+    filedesc_t parent_fd;
+    filedesc_t child_fd;
+};
+
+// A launched program, supervised through a pidfd when the kernel has them.
+struct ChildProcess {
+    pid_t pid = -1;
+    filedesc_t pidfd = -1;
+};
+
+// Creates a pipe with both ends close-on-exec.
+void make_cloexec_pipe(filedesc_t fds[2]);
+
+// Starts `program` (searched on $PATH) with `args` using posix_spawn, which
+// glibc implements with clone(CLONE_VM | CLONE_VFORK): no page tables are
+// copied however large the judge's heap is. The child gets default signal
+// dispositions, an empty signal mask and the judge's environment plus `env`
+// ("NAME=value" entries). Returns 0, or the errno-style reason why the
+// program could not be started.
+int launch(const std::string& program,
+           const std::vector<std::string>& args,
+           const std::vector<FdMapping>& fds,
+           ChildProcess& child,
+           const std::vector<std::string>& env = {});
+
+// Whether the child has not exited yet.
+bool is_running(const ChildProcess& child);
+
+// Sends SIGKILL unless the child has already been reaped.
+void kill_child(const ChildProcess& child);
+
+// Waits for the child to exit and releases its pidfd. Returns its exit
+// status, or 128 plus the signal that killed it, as shells report it; 0 if
+// it was reaped already.
+int reap_child(ChildProcess& child);
+
+}  // namespace Judge
+
+#endif  // !LAUNCHER_H
@@ -0,0 +1,103 @@
+#ifndef MATCHLOG_H
+#define MATCHLOG_H
+
+#include "common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Judge {
+
+// One record of a match log archive. The index file (`<archive>.idx`)
+// is a 16-byte header followed by these entries; `offset` points at the
+// record's payload in the archive. Entries of concurrently finished
+// matches interleave.
+struct MatchLogEntry {
+    enum Kind : uint32_t { Metadata = 0, Stderr = 1, Transcript = 2 };
+
+    uint32_t match_id;
+    int32_t player_id;  // -1 for records about the whole match
+    uint32_t kind;
+    uint32_t written;  // 0 while the slot is reserved but not filled yet
+    uint64_t offset;
+    uint64_t length;
+};
+
+// Append-only archive of everything a run logs: one file with the payloads
+// and one fixed-size index entry per record, instead of a directory and a
+// file per player per match. Each record in the archive is preceded by a
+// copy of its index entry, so the archive can be scanned without its index.
+// Appends reserve their space with atomic counters and are safe to call
+// from several threads at once.
+class MatchLog {
+   public:
+    // Creates (or truncates) `path` and `path.idx`.
+    explicit MatchLog(const std::string& path);
+    ~MatchLog();
+
+    void append(int match_id,
+                int player_id,
+                MatchLogEntry::Kind kind,
+                const void* data,
+                size_t length);
+
+    // Appends what `fd` holds from offset `begin` to `end`, or to its size
+    // if `end` is -1.
+    void appendFile(int match_id,
+                    int player_id,
+                    MatchLogEntry::Kind kind,
+                    filedesc_t fd,
+                    off_t begin = 0,
+                    off_t end = -1);
+
+    MatchLog(const MatchLog&) = delete;
+    MatchLog& operator=(const MatchLog&) = delete;
+
+   private:
+    uint64_t reserve(size_t length, MatchLogEntry& entry, uint64_t& slot);
+    void commit(const MatchLogEntry& entry, uint64_t slot);
+
+    filedesc_t archive_fd;
+    filedesc_t index_fd;
+    std::atomic<uint64_t> next_offset;
+    std::atomic<uint64_t> next_slot;
+};
+
+// Read-only view of an archive written by MatchLog; both files are mapped
+// into memory.
+class MatchLogReader {
+   public:
+    explicit MatchLogReader(const std::string& path);
+    ~MatchLogReader();
+
+    const MatchLogEntry* begin() const { return entries; }
+    const MatchLogEntry* end() const { return entries + entry_count; }
+
+    // All written records of a match, in the order they were appended.
+    std::vector<MatchLogEntry> find(int match_id) const;
+
+    std::string read(const MatchLogEntry& entry) const;
+    // The payload in place, valid as long as the reader.
+    std::string_view view(const MatchLogEntry& entry) const;
+
+    MatchLogReader(const MatchLogReader&) = delete;
+    MatchLogReader& operator=(const MatchLogReader&) = delete;
+
+   private:
+    const char* archive;
+    size_t archive_size;
+    const char* index;
+    size_t index_size;
+    const MatchLogEntry* entries;
+    size_t entry_count;
+};
+
+// Name of a record kind for listings ("meta", "stderr", "transcript").
+const char* match_log_kind_name(uint32_t kind);
+
+}  // namespace Judge
+
+#endif  // !MATCHLOG_H
@@ -0,0 +1,29 @@
+#ifndef MATCHPOOL_H
+#define MATCHPOOL_H
+
+#include <functional>
+
+namespace Judge {
+
+// Runs independent jobs (usually matches) on a fixed number of worker
+// threads. Jobs are handed out in increasing id order; each job is executed
+// exactly once.
+class MatchPool {
+   public:
+    using job_fun_t = std::function<void(int job_id, int worker_id)>;
+
+    explicit MatchPool(int workers);
+
+    int getWorkers() const { return workers; }
+
+    // Blocks until all `job_count` jobs have finished. With a single worker
+    // the jobs are run on the calling thread.
+    void run(int job_count, const job_fun_t& job);
+
+   private:
+    int workers;
+};
+
+}  // namespace Judge
+
+#endif  // !MATCHPOOL_H
@@ -0,0 +1,137 @@
+#ifndef MATRIXGAME_H
+#define MATRIXGAME_H
+
+// Two-player games of simultaneous moves given as a table: the names of the
+// moves, and for every pair of moves what each player scores. The table is
+// built at compile time together with a perfect hash of the move names, so
+// reading a move costs one hash and one comparison, and scoring a round is
+// a lookup; nothing is allocated:
+//
+//     constexpr Engine::MatrixGame<2> PENNIES(
+//         {"HEADS", "TAILS"},
+//         {{{{{1, 0}, {0, 1}}},
+//           {{{0, 1}, {1, 0}}}}});
+//
+//     int first = PENNIES.parse(word);  // -1 if it is no move
+//     int points = PENNIES.payoff(first, second).second;
+
+#include "engine.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Engine {
+
+// What one round is worth to each player.
+struct Payoff {
+    int first;
+    int second;
+};
+
+template <size_t MOVES>
+class MatrixGame {
+   public:
+    using Names = std::array<std::string_view, MOVES>;
+    // payoffs[a][b]: the first player moved `a` and the second `b`.
+    using Payoffs = std::array<std::array<Payoff, MOVES>, MOVES>;
+
+    // Does not compile if the names repeat, or if no hash seed tells them
+    // apart.
+    consteval MatrixGame(const Names& p_names, const Payoffs& p_payoffs)
+        : names(p_names), payoffs(p_payoffs) {
+        for (size_t i = 0; i < MOVES; i++) {
+            for (size_t j = 0; j < i; j++) {
+                if (names[i] == names[j])
+                    throw "two moves have the same name";
+            }
+        }
+        for (seed = 0; seed < MAX_SEED; seed++) {
+            if (placeNames())
+                return;
+        }
+        throw "no perfect hash for these move names";
+    }
+
+    // The move called `name`, or -1 if there is none.
+    constexpr int parse(std::string_view name) const {
+        int move = slots[slotOf(name, seed)];
+        return move != -1 && names[move] == name ? move : -1;
+    }
+
+    constexpr std::string_view name(int move) const { return names[move]; }
+
+    constexpr const Payoff& payoff(int first, int second) const {
+        return payoffs[first][second];
+    }
+
+    static constexpr size_t size() { return MOVES; }
+
+   private:
+    // With the square of the number of moves as slots, a seed that spreads
+    // the moves out is found after a try or two. Games have few moves.
+    static constexpr size_t SLOTS = std::bit_ceil(MOVES * MOVES);
+    static constexpr uint32_t MAX_SEED = 1 << 10;
+
+    // FNV-1a from a seeded start, with the high bits folded in.
+    static constexpr size_t slotOf(std::string_view name, uint32_t start) {
+        uint32_t hash = (2166136261u ^ start) * 16777619u;
+        for (char c : name)
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        return (hash ^ (hash >> 16)) & (SLOTS - 1);
+    }
+
+    constexpr bool placeNames() {
+        slots.fill(-1);
+        for (size_t move = 0; move < MOVES; move++) {
+            int& slot = slots[slotOf(names[move], seed)];
+            if (slot != -1)
+                return false;
+            slot = static_cast<int>(move);
+        }
+        return true;
+    }
+
+    Names names;
+    Payoffs payoffs;
+    std::array<int, SLOTS> slots = {};
+    uint32_t seed = 0;
+};
+
+// The next word of a reply, where words are separated by whitespace, and
+// `text` moves past it. Empty at the end.
+inline std::string_view next_word(std::string_view& text) {
+    const std::string_view SPACES = " \t\r\f\v";
+    size_t begin = text.find_first_not_of(SPACES);
+    if (begin == std::string_view::npos)
+        begin = text.size();
+    size_t end = text.find_first_of(SPACES, begin);
+    if (end == std::string_view::npos)
+        end = text.size();
+    std::string_view word = text.substr(begin, end - begin);
+    text.remove_prefix(end);
+    return word;
+}
+
+// The result of a game won on points, e.g. "Player #0 (a) won [6-4]"; a
+// draw if the players scored the same.
+inline GameResult matrix_game_result(const std::vector<PlayerData>& players,
+                                     long long first_total,
+                                     long long second_total) {
+    int winner = first_total > second_total ? 0 : 1;
+    std::string details =
+        std::to_string(std::max(first_total, second_total)) + "-" +
+        std::to_string(std::min(first_total, second_total));
+    if (first_total == second_total)
+        return GameResult::createDraw(players, details);
+    return GameResult::createWin(players, players[winner], details);
+}
+
+}  // namespace Engine
+
+#endif  // !MATRIXGAME_H
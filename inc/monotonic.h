@@ -0,0 +1,50 @@
+#ifndef MONOTONIC_H
+#define MONOTONIC_H
+
+// Absolute deadlines on CLOCK_MONOTONIC, in the timespec form ppoll()
+// takes, so that a wait interrupted or woken early can resume with exactly
+// the time that is left.
+
+#include <ctime>
+
+namespace Monotonic {
+
+inline timespec now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts;
+}
+
+inline timespec after_ms(int timeout_ms, timespec from = now()) {
+    timespec deadline = from;
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += 1000000L * (timeout_ms % 1000);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return deadline;
+}
+
+inline long long elapsed_us(const timespec& from, const timespec& to) {
+    return (to.tv_sec - from.tv_sec) * 1000000LL +
+           (to.tv_nsec - from.tv_nsec) / 1000;
+}
+
+// The time left until `deadline`, or zero once it has passed.
+inline timespec time_left(const timespec& deadline) {
+    timespec left = now();
+    left.tv_sec = deadline.tv_sec - left.tv_sec;
+    left.tv_nsec = deadline.tv_nsec - left.tv_nsec;
+    if (left.tv_nsec < 0) {
+        left.tv_sec--;
+        left.tv_nsec += 1000000000L;
+    }
+    if (left.tv_sec < 0)
+        left = {0, 0};
+    return left;
+}
+
+}  // namespace Monotonic
+
+#endif  // !MONOTONIC_H
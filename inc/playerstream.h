@@ -1,19 +1,111 @@
 #ifndef PLAYERSTREAM_H
 #define PLAYERSTREAM_H()
 
+#include <ctime>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <streambuf>
+#include <string>
+#include <string_view>
 #include <system_error>
+#include <vector>
+
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "latency.h"
+
+// Moves the bytes of a playerbuf when it does not talk to plain file
+// descriptors. read() and write() behave like their POSIX counterparts on
+// non-blocking descriptors: they fail with EAGAIN instead of waiting, and
+// the caller then waits for get_poll_fd() to become readable before trying
+// again. Unlike a pipe, the poll fd may not be waited on before read() has
+// failed with EAGAIN.
+class player_transport {
+   public:
+    virtual ~player_transport() = default;
+    virtual ssize_t read(char* buf, size_t len) = 0;
+    virtual ssize_t write(const char* buf, size_t len) = 0;
+    virtual int get_poll_fd() const = 0;
+};
+
+// Sees every byte a playerbuf moves, e.g. to keep a transcript of a game.
+// on_input() gets what each read returned, with `len` 0 at the end of the
+// input; on_output() the first `len` bytes of what each write was given;
+// on_output_error() the errno of a write that failed for good.
+class player_recorder {
+   public:
+    virtual ~player_recorder() = default;
+    virtual void on_input(const char* buf, size_t len) = 0;
+    virtual void on_output(const iovec* iov, int iovcnt, size_t len) = 0;
+    virtual void on_output_error(int errnum) = 0;
+};
+
+// How large the buffers of a playerbuf are. Both start at `initial_size`
+// bytes. The read buffer doubles, up to `max_size`, whenever a single read
+// fills it, so that long messages take a few read() calls instead of one
+// per kilobyte. Writes that do not fit in the write buffer bypass it.
+struct playerbuf_policy {
+    static constexpr size_t DEFAULT_SIZE = 1024;
+    static constexpr size_t DEFAULT_GROWABLE_MAX_SIZE = 16 << 20;
+
+    size_t initial_size = DEFAULT_SIZE;
+    size_t max_size = DEFAULT_SIZE;
+
+    static playerbuf_policy fixed(size_t size) { return {size, size}; }
+    static playerbuf_policy growable(
+        size_t max_size = DEFAULT_GROWABLE_MAX_SIZE) {
+        return {DEFAULT_SIZE, max_size};
+    }
+};
 
 class playerbuf : public std::streambuf {
    public:
-    playerbuf(int input_fd, int output_fd);
-    ~playerbuf();
-    static constexpr int BUF_SIZE = 1024;
+    // Buffers of up to BUF_SIZE bytes are stored in the playerbuf itself.
+    static constexpr int BUF_SIZE = playerbuf_policy::DEFAULT_SIZE;
 
+    playerbuf(int input_fd,
+              int output_fd,
+              playerbuf_policy policy = playerbuf_policy());
+    explicit playerbuf(std::shared_ptr<player_transport> transport,
+                       playerbuf_policy policy = playerbuf_policy());
+
+    // Reads wait until an absolute deadline on CLOCK_MONOTONIC, which
+    // holds for all of them however the data trickles in. With a timeout
+    // the deadline is set `timeout_ms` ahead right away and again by every
+    // flush that sends a request, so that each reply has to arrive whole
+    // within `timeout_ms` of its request. set_deadline() sets one
+    // directly, until the next flush if a timeout is set.
     void set_timeout_ms(int timeout_ms);
+    void set_deadline(const timespec& deadline);
+    void clear_deadline();
+    // Wall-clock time from the last flush that sent a request to the last
+    // read that received input: once the reply has been read, how long
+    // the player took to answer. 0 before the first request.
+    long long get_think_time_us() const;
+
+    // The think times of all requests that were answered so far, and the
+    // number that timed out. A request counts as answered once input was
+    // read after it; its time is taken when the next request is sent, or
+    // here for the last one.
+    latency_histogram get_response_times() const;
+    // Counts a timeout for the current request, for callers that enforce
+    // deadlines of their own; reads that hit the deadline count it
+    // themselves.
+    void record_timeout();
+    // Bounds the time a single flush may wait for the reader to drain the
+    // (non-blocking) output fd. Without it a flush may block indefinitely.
+    void set_write_timeout_ms(int timeout_ms);
+    // Takes effect for the read buffer on its next refill and for the
+    // write buffer on the next flush.
+    void set_buffer_policy(playerbuf_policy policy);
+    // Passes everything read and written from now on to `recorder`, or
+    // stops recording if it is null.
+    void set_recorder(std::shared_ptr<player_recorder> recorder) {
+        recorder_ = std::move(recorder);
+    }
 
     using error_fun_t =
         std::function<void(const playerbuf& sender, int errnum)>;
@@ -23,6 +115,42 @@ class playerbuf : public std::streambuf {
     inline int get_last_error() const;
     std::string get_last_strerror() const;
 
+    // The descriptor to poll() for input; with a transport it is its poll
+    // fd, which becomes readable (POLLIN) for output as well.
+    int get_input_fd() const { return input_fd_; }
+
+    // Line reading for callers that multiplex several playerbufs with
+    // poll(). Appends the buffered part of the current line to `line` and,
+    // if `may_read`, performs at most one read() from the input fd, so it
+    // does not block once poll() reported the fd readable. Transports never
+    // block and are always read from.
+    enum class line_status { complete, pending, eof, error };
+    line_status read_line_nonblocking(std::string& line, bool may_read);
+
+    // The writing counterpart: sends the buffered output followed by `len`
+    // bytes of `data` for as long as the output fd takes them, and tells
+    // in `data_written` how much of `data` went out. When it returns
+    // pending, the rest is to be sent once get_output_pollfd() is ready.
+    enum class write_status { complete, pending, error };
+    write_status write_nonblocking(const char* data,
+                                   size_t len,
+                                   size_t& data_written);
+    // What to poll() for before a write that would block is retried.
+    pollfd get_output_pollfd() const {
+        return {output_fd_, static_cast<short>(transport_ ? POLLIN : POLLOUT),
+                0};
+    }
+
+    // Binary framing (see framing.h), for messages that are not worth
+    // formatting as text. write_frame() queues a whole frame for the next
+    // flush. read_frame() waits for a whole frame with the read timeout and
+    // returns it as one contiguous buffer that stays valid until the next
+    // read. Both return false after reporting the error; frames over the
+    // maximum size fail with EMSGSIZE and leave the stream out of sync.
+    void set_max_frame_size(size_t max_size) { max_frame_size_ = max_size; }
+    bool write_frame(std::string_view frame);
+    bool read_frame(std::string_view& frame);
+
     playerbuf(const playerbuf&) = delete;
     playerbuf& operator=(const playerbuf&) = delete;
 
@@ -30,15 +158,46 @@ class playerbuf : public std::streambuf {
     int underflow() override;
     int overflow(int c) override;
     int sync() override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
 
    private:
     static void throw_last_error(const playerbuf& sender, int errnum);
     void call_on_error() const;
+    bool wait_for(pollfd& pfd, const timespec* deadline);
+    bool wait_writable(const timespec* deadline);
+    ssize_t fill_readbuf();
+    void resize_writebuf();
+    bool flush_with(const char* data,
+                    size_t len,
+                    size_t& data_written,
+                    bool may_wait = true);
+    ssize_t read_input(char* buf, size_t len);
+    ssize_t write_output(const iovec* iov, int iovcnt);
+    std::shared_ptr<player_transport> transport_;
+    std::shared_ptr<player_recorder> recorder_;
     int input_fd_;
     int output_fd_;
+    playerbuf_policy policy_;
     char* readbuf_;
+    size_t readbuf_size_;
+    bool readbuf_filled_;
+    std::unique_ptr<char[]> readbuf_heap_;
+    char readbuf_inline_[BUF_SIZE];
     char* writebuf_;
-    std::unique_ptr<timeval> timeout_;
+    size_t writebuf_size_;
+    std::unique_ptr<char[]> writebuf_heap_;
+    char writebuf_inline_[BUF_SIZE];
+    int timeout_ms_;
+    bool deadline_set_;
+    timespec read_deadline_;
+    timespec request_sent_;
+    timespec last_read_;
+    bool request_pending_;
+    bool request_answered_;
+    latency_histogram response_times_;
+    int write_timeout_ms_;
+    size_t max_frame_size_;
+    std::vector<char> frame_;
     error_fun_t on_error_;
     int last_error_;
 };
@@ -47,6 +206,18 @@ class playerstream_base {
    public:
     inline void set_timeout_ms(int timeout_ms);
 
+    inline void set_deadline(const timespec& deadline);
+
+    inline void clear_deadline();
+
+    inline long long get_think_time_us() const;
+
+    inline latency_histogram get_response_times() const;
+
+    inline void set_write_timeout_ms(int timeout_ms);
+
+    inline void set_buffer_policy(playerbuf_policy policy);
+
     inline void on_error_call(playerbuf::error_fun_t error_fun);
 
     inline void on_error_throw();
@@ -57,26 +228,39 @@ class playerstream_base {
 
     inline std::string get_last_strerror() const;
 
+    inline void set_max_frame_size(size_t max_size);
+
+    inline bool write_frame(std::string_view frame);
+
+    inline bool read_frame(std::string_view& frame);
+
+    playerbuf& get_playerbuf() { return pbuf_; }
+
     static void ignore_sigpipe();
 
    protected:
     playerbuf pbuf_;
-    playerstream_base(int input_fd, int output_fd)
-        : pbuf_(input_fd, output_fd) {}
+    playerstream_base(int input_fd, int output_fd, playerbuf_policy policy)
+        : pbuf_(input_fd, output_fd, policy) {}
+    playerstream_base(std::shared_ptr<player_transport> transport,
+                      playerbuf_policy policy)
+        : pbuf_(std::move(transport), policy) {}
 };
 
 class iplayerstream : public virtual playerstream_base, public std::istream {
    public:
-    explicit iplayerstream(int input_fd)
-        : playerstream_base(input_fd, -1),
+    explicit iplayerstream(int input_fd,
+                           playerbuf_policy policy = playerbuf_policy())
+        : playerstream_base(input_fd, -1, policy),
           std::ios(&pbuf_),
           std::istream(&pbuf_) {}
 };
 
 class oplayerstream : public virtual playerstream_base, public std::ostream {
    public:
-    explicit oplayerstream(int output_fd)
-        : playerstream_base(-1, output_fd),
+    explicit oplayerstream(int output_fd,
+                           playerbuf_policy policy = playerbuf_policy())
+        : playerstream_base(-1, output_fd, policy),
           std::ios(&pbuf_),
           std::ostream(&pbuf_) {}
 };
@@ -85,8 +269,16 @@ class playerstream : public virtual playerstream_base,
                      public std::istream,
                      public std::ostream {
    public:
-    explicit playerstream(int input_fd, int output_fd)
-        : playerstream_base(input_fd, output_fd),
+    explicit playerstream(int input_fd,
+                          int output_fd,
+                          playerbuf_policy policy = playerbuf_policy())
+        : playerstream_base(input_fd, output_fd, policy),
+          std::ios(&pbuf_),
+          std::istream(&pbuf_),
+          std::ostream(&pbuf_) {}
+    explicit playerstream(std::shared_ptr<player_transport> transport,
+                          playerbuf_policy policy = playerbuf_policy())
+        : playerstream_base(std::move(transport), policy),
           std::ios(&pbuf_),
           std::istream(&pbuf_),
           std::ostream(&pbuf_) {}
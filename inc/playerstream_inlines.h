@@ -23,6 +23,30 @@ void playerstream_base::set_timeout_ms(int timeout_ms) {
     pbuf_.set_timeout_ms(timeout_ms);
 }
 
+void playerstream_base::set_deadline(const timespec& deadline) {
+    pbuf_.set_deadline(deadline);
+}
+
+void playerstream_base::clear_deadline() {
+    pbuf_.clear_deadline();
+}
+
+long long playerstream_base::get_think_time_us() const {
+    return pbuf_.get_think_time_us();
+}
+
+latency_histogram playerstream_base::get_response_times() const {
+    return pbuf_.get_response_times();
+}
+
+void playerstream_base::set_write_timeout_ms(int timeout_ms) {
+    pbuf_.set_write_timeout_ms(timeout_ms);
+}
+
+void playerstream_base::set_buffer_policy(playerbuf_policy policy) {
+    pbuf_.set_buffer_policy(policy);
+}
+
 void playerstream_base::on_error_call(playerbuf::error_fun_t error_fun) {
     pbuf_.on_error_call(error_fun);
 }
@@ -43,4 +67,16 @@ inline std::string playerstream_base::get_last_strerror() const {
     return pbuf_.get_last_strerror();
 }
 
+void playerstream_base::set_max_frame_size(size_t max_size) {
+    pbuf_.set_max_frame_size(max_size);
+}
+
+bool playerstream_base::write_frame(std::string_view frame) {
+    return pbuf_.write_frame(frame);
+}
+
+bool playerstream_base::read_frame(std::string_view& frame) {
+    return pbuf_.read_frame(frame);
+}
+
 #endif  // !PLAYERSTREAM_INLINES_H
@@ -0,0 +1,117 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include "common.h"
+#include "engine.h"
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace Judge {
+
+// A 128-bit content hash.
+struct ContentHash {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    bool operator==(const ContentHash& other) const = default;
+    // 32 hex digits.
+    std::string hex() const;
+};
+
+// MurmurHash3 (x64, 128 bits) of everything passed to update(), in order.
+// Strings are hashed with their length, so that consecutive ones cannot run
+// into each other. Not cryptographic: it tells files and settings apart,
+// it does not withstand someone crafting collisions.
+class ContentHasher {
+   public:
+    void update(const void* data, size_t length);
+    void update(std::string_view text);
+    void update(uint64_t value);
+    ContentHash digest() const;
+
+   private:
+    void mixBlock(const unsigned char* block);
+
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    unsigned char tail[16];
+    size_t tail_length = 0;
+    uint64_t total_length = 0;
+};
+
+// The hash of the file's contents; exits with an error if it cannot be
+// read.
+ContentHash hash_file(const std::string& path);
+
+// The file posix_spawnp() would run for `program`: itself if it has a
+// slash, otherwise the first executable of that name on $PATH. Empty if
+// there is none.
+std::string find_program(const std::string& program);
+
+// A result kept by ResultCache, with how long its game took.
+struct CachedResult {
+    Engine::GameResult result;
+    long long game_us;
+};
+
+// Persistent results of matches, keyed by a hash of everything that
+// decides them. Two files: `<path>` holds the records, appended one after
+// another, each the key followed by the result; `<path>.idx` is a hash
+// table of 24-byte slots, mapped into memory, that points at them. The
+// table is at most half full, so a lookup reads a slot or two and then
+// one record, however many there are, and it doubles when it fills up.
+// The index header remembers how far into the records file it reaches, so
+// records appended by a judge that died before indexing them are indexed
+// when the cache is opened again, and a torn record at the end is dropped.
+// A lost or damaged index is rebuilt from the records.
+//
+// A cache is used by one judge at a time, which holds a lock on it; its
+// worker threads may share it.
+class ResultCache {
+   public:
+    explicit ResultCache(const std::string& path);
+    ~ResultCache();
+
+    std::optional<CachedResult> find(const ContentHash& key);
+    // Does nothing if the key is already there.
+    void insert(const ContentHash& key,
+                const Engine::GameResult& result,
+                long long game_us);
+
+    uint64_t size();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+   private:
+    struct IndexHeader;
+    struct Slot;
+
+    IndexHeader& header();
+    Slot* slots();
+    void openIndex();
+    void createIndex(const std::string& path, uint64_t capacity);
+    void mapIndex(filedesc_t fd);
+    void unmapIndex();
+    void indexRecords(uint64_t from);
+    void grow();
+    // The slot of `key`, or the empty slot where it belongs.
+    Slot& slotFor(const ContentHash& key);
+    void addSlot(const ContentHash& key, uint64_t offset);
+
+    std::string records_path;
+    std::string index_path;
+    filedesc_t records_fd;
+    uint64_t records_end;
+    char* index = nullptr;
+    size_t index_size = 0;
+    std::mutex mutex;
+};
+
+}  // namespace Judge
+
+#endif  // !RESULTCACHE_H
@@ -0,0 +1,90 @@
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+
+#include "common.h"
+
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Judge {
+
+// What the results file says about one finished match.
+struct MatchRecord {
+    int match_id = 0;
+    std::string game;
+    std::vector<std::string> bots;
+    std::vector<unsigned> seeds;
+    std::vector<double> scores;
+    std::string result;  // "win", "draw" or "error"
+    long long duration_us = 0;
+    std::string details;
+};
+
+// Machine-readable results of a run, one record per match as matches
+// finish: JSON lines, or CSV with a header line. Every worker of a
+// MatchPool collects its records in a buffer of its own, so workers never
+// wait for each other, and writes the buffer with a single write() once it
+// holds FLUSH_BYTES. A flusher thread writes out any buffer whose oldest
+// record is FLUSH_INTERVAL_MS old, so records of a worker that has nothing
+// more to append do not wait for the end of the run. The file is opened
+// with O_APPEND and only whole records are written, so it can be tailed
+// while the run is in progress.
+class ResultSink {
+   public:
+    enum class Format { Jsonl, Csv };
+
+    static constexpr size_t FLUSH_BYTES = 1 << 14;
+    static constexpr int FLUSH_INTERVAL_MS = 1000;
+
+    // CSV for paths ending in ".csv", JSON lines otherwise.
+    static Format formatFor(const std::string& path);
+
+    // Appends to `path`, creating it if needed. A CSV header is written if
+    // the file is empty.
+    ResultSink(const std::string& path, Format format, int workers,
+               int flush_interval_ms = FLUSH_INTERVAL_MS);
+    // Stops the flusher and writes what is still buffered.
+    ~ResultSink();
+
+    // Called only by worker `worker_id`, or by anyone while no worker runs.
+    void append(int worker_id, const MatchRecord& record);
+
+    // Writes every worker's buffer.
+    void flush();
+
+    // The record as one line of the format, newline included.
+    static std::string formatRecord(Format format, const MatchRecord& record);
+
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+
+   private:
+    // The mutex is shared only with the flusher, which takes it once per
+    // interval.
+    struct alignas(64) WorkerBuffer {
+        std::mutex mutex;
+        std::string data;
+        timespec oldest{};  // when the first buffered record was added
+    };
+
+    void flushIdle();
+    void writeOut(WorkerBuffer& buffer);
+
+    filedesc_t fd;
+    Format format;
+    std::vector<WorkerBuffer> buffers;
+    long long flush_interval_us;
+
+    std::mutex stop_mutex;
+    std::condition_variable stop_cv;
+    bool stopping = false;
+    std::thread flusher;
+};
+
+}  // namespace Judge
+
+#endif  // !RESULTSINK_H
@@ -0,0 +1,164 @@
+#ifndef SHMBOT_H
+#define SHMBOT_H
+
+// Bot side of the shared-memory transport (see shmring.h): raw bytes in and
+// out of the rings. Bots normally use it through Bot::Connection (see
+// botsdk.h), which picks it up when the judge set one up.
+//
+// Header-only, so that bots do not need to link against the judge.
+
+#include "shmring.h"
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+namespace Bot {
+
+class ShmChannel {
+   public:
+    // Busy-polls the ring this long before sleeping on the doorbell, on
+    // machines where the judge can run at the same time.
+    static constexpr long DEFAULT_SPIN_US = 50;
+
+    // The channel described by the environment, or nullptr if there is none
+    // or it cannot be mapped.
+    static std::unique_ptr<ShmChannel> fromEnvironment() {
+        const char* value = getenv(Shm::ENV_VAR);
+        int shm_fd, doorbell_fd, judge_doorbell_fd;
+        if (value == nullptr ||
+            sscanf(value, "%d,%d,%d", &shm_fd, &doorbell_fd,
+                   &judge_doorbell_fd) != 3)
+            return nullptr;
+        std::unique_ptr<ShmChannel> channel(
+            new ShmChannel(shm_fd, doorbell_fd, judge_doorbell_fd));
+        if (channel->header == nullptr)
+            return nullptr;
+        return channel;
+    }
+
+    // `hangup_fd` reports POLLHUP once the judge is gone; the judge keeps
+    // the bot's stdin open for as long as it runs.
+    ShmChannel(int shm_fd,
+               int p_doorbell_fd,
+               int p_judge_doorbell_fd,
+               int p_hangup_fd = 0)
+        : doorbell_fd(p_doorbell_fd),
+          judge_doorbell_fd(p_judge_doorbell_fd),
+          hangup_fd(p_hangup_fd),
+          spin_us(sysconf(_SC_NPROCESSORS_ONLN) > 1 ? DEFAULT_SPIN_US : 0) {
+        Shm::Header probe;
+        if (pread(shm_fd, &probe, sizeof(probe), 0) != sizeof(probe) ||
+            memcmp(probe.magic, Shm::MAGIC, sizeof(Shm::MAGIC)) != 0 ||
+            probe.version != Shm::VERSION)
+            return;
+        map_size = Shm::mapping_size(probe.ring_size);
+        void* data = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, shm_fd, 0);
+        if (data == MAP_FAILED)
+            return;
+        header = static_cast<Shm::Header*>(data);
+        in = Shm::Ring(header, Shm::TO_BOT);
+        out = Shm::Ring(header, Shm::TO_JUDGE);
+    }
+
+    ~ShmChannel() {
+        if (header != nullptr)
+            munmap(header, map_size);
+    }
+
+    void setSpinUs(long p_spin_us) { spin_us = p_spin_us; }
+
+    // Reads at least one and up to `len` bytes, waiting for the judge if
+    // there are none yet. Returns 0 once the judge is gone.
+    size_t read(char* buf, size_t len) {
+        while (true) {
+            bool wake_judge;
+            size_t n = in.read(buf, len, wake_judge);
+            if (wake_judge)
+                Shm::ring_doorbell(judge_doorbell_fd);
+            if (n > 0)
+                return n;
+            if (spin() || !in.isEmpty())
+                continue;
+            if (!sleep())
+                return 0;
+        }
+    }
+
+    // Writes all of `data`. Returns false once the judge is gone.
+    bool write(const char* data, size_t len) {
+        while (len > 0) {
+            bool wake_judge;
+            size_t n = out.write(data, len, wake_judge);
+            if (wake_judge)
+                Shm::ring_doorbell(judge_doorbell_fd);
+            data += n;
+            len -= n;
+            if (n == 0 && out.waitForSpace() && !sleep())
+                return false;
+        }
+        return true;
+    }
+
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+   private:
+    // Busy-polls the incoming ring for up to `spin_us`. Returns true if
+    // data arrived.
+    bool spin() {
+        if (spin_us <= 0)
+            return false;
+        in.setSpinning(true);
+        long long deadline = nowUs() + spin_us;
+        bool arrived = false;
+        for (int i = 0; !arrived; i++) {
+            arrived = !in.isEmpty();
+            if (i % 64 == 63 && nowUs() >= deadline)
+                break;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        in.setSpinning(false);
+        return arrived;
+    }
+
+    // Waits for the doorbell. Returns false if the judge is gone.
+    bool sleep() {
+        pollfd fds[2] = {{doorbell_fd, POLLIN, 0}, {hangup_fd, 0, 0}};
+        while (poll(fds, 2, -1) == -1) {
+            if (errno != EINTR)
+                return false;
+        }
+        if (fds[1].revents != 0)
+            return false;
+        Shm::clear_doorbell(doorbell_fd);
+        return true;
+    }
+
+    static long long nowUs() {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+    }
+
+    Shm::Header* header = nullptr;
+    size_t map_size = 0;
+    Shm::Ring in;
+    Shm::Ring out;
+    int doorbell_fd;
+    int judge_doorbell_fd;
+    int hangup_fd;
+    long spin_us;
+};
+
+}  // namespace Bot
+
+#endif  // !SHMBOT_H
@@ -0,0 +1,163 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+// Layout of the shared-memory transport between the judge and a bot, used
+// by both sides. The judge creates a memfd holding a header and two
+// single-producer single-consumer byte rings, one per direction, and an
+// eventfd "doorbell" per side. A side that publishes data or frees space
+// rings the other side's doorbell, unless the other side is busy-polling
+// the ring anyway. The rings carry the same line-based text as the pipes.
+//
+// This header has no dependencies on the rest of the judge so that bots can
+// include it on its own.
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Shm {
+
+constexpr char MAGIC[8] = {'B', 'J', 'S', 'H', 'M', 'R', 'N', 'G'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t DEFAULT_RING_SIZE = 1 << 16;
+
+// Set in the bot's environment to "<shm fd>,<bot doorbell>,<judge doorbell>"
+// when the judge talks to it over shared memory.
+constexpr const char* ENV_VAR = "BOTS_JUDGE_SHM";
+
+// The descriptors the judge passes them as.
+constexpr int BOT_SHM_FD = 3;
+constexpr int BOT_DOORBELL_FD = 4;
+constexpr int BOT_JUDGE_DOORBELL_FD = 5;
+
+enum Direction { TO_BOT = 0, TO_JUDGE = 1 };
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "shared atomics must be lock-free to work across processes");
+
+// Positions run freely and wrap around at 2^32; the ring size is a power
+// of two, so they index the data modulo its size.
+struct RingControl {
+    alignas(64) std::atomic<uint32_t> tail;  // advanced by the producer
+    alignas(64) std::atomic<uint32_t> head;  // advanced by the consumer
+    alignas(64) std::atomic<uint32_t> reader_spinning;
+    std::atomic<uint32_t> writer_waiting;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t ring_size;
+    RingControl rings[2];
+};
+
+inline size_t mapping_size(uint32_t ring_size) {
+    return sizeof(Header) + 2 * static_cast<size_t>(ring_size);
+}
+
+inline void ring_doorbell(int doorbell_fd) {
+    uint64_t one = 1;
+    // Fails only if the counter would overflow, and then it is set anyway.
+    [[maybe_unused]] ssize_t rv = write(doorbell_fd, &one, sizeof(one));
+}
+
+// Doorbells are non-blocking; this just resets the counter.
+inline void clear_doorbell(int doorbell_fd) {
+    uint64_t count;
+    [[maybe_unused]] ssize_t rv = read(doorbell_fd, &count, sizeof(count));
+}
+
+// One direction of the transport, seen from either end. Exactly one
+// process may call the producer methods and one the consumer methods.
+class Ring {
+   public:
+    Ring() = default;
+    Ring(Header* header, Direction direction)
+        : control(&header->rings[direction]),
+          data(reinterpret_cast<char*>(header) + sizeof(Header) +
+               direction * static_cast<size_t>(header->ring_size)),
+          size(header->ring_size) {}
+
+    // Producer: copies as much of `buf` as fits and returns how much. Sets
+    // `wake_reader` if the consumer has to be woken up through its doorbell.
+    size_t write(const char* buf, size_t len, bool& wake_reader) {
+        uint32_t tail = control->tail.load(std::memory_order_relaxed);
+        uint32_t head = control->head.load(std::memory_order_acquire);
+        size_t n = std::min<size_t>(len, size - (tail - head));
+        copyIn(tail, buf, n);
+        control->tail.store(tail + n, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake_reader = n > 0 && !control->reader_spinning.load(
+                                   std::memory_order_relaxed);
+        return n;
+    }
+
+    // Producer: announces that it is about to sleep until there is space.
+    // Returns false if space appeared in the meantime.
+    bool waitForSpace() {
+        control->writer_waiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return isFull();
+    }
+
+    bool isFull() const {
+        return control->tail.load(std::memory_order_relaxed) -
+                   control->head.load(std::memory_order_acquire) ==
+               size;
+    }
+
+    // Consumer: copies up to `len` bytes into `buf`. Sets `wake_writer` if
+    // the producer waits for the space this freed.
+    size_t read(char* buf, size_t len, bool& wake_writer) {
+        uint32_t head = control->head.load(std::memory_order_relaxed);
+        uint32_t tail = control->tail.load(std::memory_order_acquire);
+        size_t n = std::min<size_t>(len, tail - head);
+        copyOut(head, buf, n);
+        control->head.store(head + n, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake_writer =
+            n > 0 &&
+            control->writer_waiting.load(std::memory_order_relaxed) &&
+            control->writer_waiting.exchange(0);
+        return n;
+    }
+
+    bool isEmpty() const {
+        return control->head.load(std::memory_order_relaxed) ==
+               control->tail.load(std::memory_order_acquire);
+    }
+
+    // Consumer: while spinning, the producer does not ring the doorbell.
+    void setSpinning(bool spinning) {
+        control->reader_spinning.store(spinning, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+   private:
+    void copyIn(uint32_t pos, const char* buf, size_t n) {
+        size_t offset = pos & (size - 1);
+        size_t first = std::min(n, size - offset);
+        memcpy(data + offset, buf, first);
+        memcpy(data, buf + first, n - first);
+    }
+
+    void copyOut(uint32_t pos, char* buf, size_t n) const {
+        size_t offset = pos & (size - 1);
+        size_t first = std::min(n, size - offset);
+        memcpy(buf, data + offset, first);
+        memcpy(buf + first, data, n - first);
+    }
+
+    RingControl* control = nullptr;
+    char* data = nullptr;
+    size_t size = 0;
+};
+
+}  // namespace Shm
+
+#endif  // !SHMRING_H
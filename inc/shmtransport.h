@@ -0,0 +1,55 @@
+#ifndef SHMTRANSPORT_H
+#define SHMTRANSPORT_H
+
+#include "common.h"
+#include "launcher.h"
+#include "playerstream.h"
+#include "shmring.h"
+
+#include <string>
+#include <vector>
+
+namespace Judge {
+
+// The judge's end of the shared-memory transport to one bot (see
+// shmring.h). The bot is told about it through the descriptors and the
+// environment entry below; its stdin and stdout stay connected to pipes,
+// which only serve to notice when either side is gone.
+class ShmTransport : public player_transport {
+   public:
+    // `hangup_fd` is the read end of the bot's stdout pipe. Anything the
+    // bot writes there is discarded.
+    explicit ShmTransport(filedesc_t hangup_fd,
+                          uint32_t ring_size = Shm::DEFAULT_RING_SIZE);
+    ~ShmTransport() override;
+
+    // What to pass to launch() for the bot.
+    std::vector<FdMapping> getChildFds() const;
+    static std::string getChildEnv();
+
+    ssize_t read(char* buf, size_t len) override;
+    ssize_t write(const char* buf, size_t len) override;
+
+    // Readable when the bot rang the judge's doorbell or exited.
+    int get_poll_fd() const override { return epoll_fd; }
+
+    ShmTransport(const ShmTransport&) = delete;
+    ShmTransport& operator=(const ShmTransport&) = delete;
+
+   private:
+    bool isBotGone();
+
+    filedesc_t hangup_fd;
+    filedesc_t shm_fd;
+    filedesc_t bot_doorbell;
+    filedesc_t judge_doorbell;
+    filedesc_t epoll_fd;
+    Shm::Header* header;
+    size_t map_size;
+    Shm::Ring to_bot;
+    Shm::Ring to_judge;
+};
+
+}  // namespace Judge
+
+#endif  // !SHMTRANSPORT_H
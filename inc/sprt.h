@@ -0,0 +1,66 @@
+#ifndef SPRT_H
+#define SPRT_H
+
+// Deciding when a head-to-head run has played enough matches. Scores are
+// those of the first bot: 1 for a win, 0.5 for a draw and 0 for a loss, or
+// its share of the points for engines that score otherwise. Elo differences
+// are logistic: a bot that scores s against another is
+// -400 * log10(1 / s - 1) Elo stronger.
+
+namespace Judge {
+
+double score_to_elo(double score);
+double elo_to_score(double elo);
+
+// Running mean and variance of the first bot's match scores. A virtual win
+// and a virtual loss are counted in both, so that the variance stays
+// positive and the estimates finite when every match so far ended the same
+// way.
+class ScoreStats {
+   public:
+    void add(double score);
+
+    // Matches added, not counting the virtual ones.
+    int getMatches() const { return matches; }
+    double mean() const;
+    double variance() const;
+    // Half the width of the confidence interval of the mean score, for the
+    // standard normal quantile `z` (1.96 for 95%).
+    double halfWidth(double z = 1.96) const;
+
+   private:
+    int matches = 0;
+    double sum = 1;
+    double sum_squares = 1;
+};
+
+// The sequential probability ratio test of H0: the Elo difference is
+// `elo0` against H1: it is `elo1`, with the normal approximation of the
+// generalized SPRT: the log-likelihood ratio after N matches of mean score
+// s and variance v is N * (s1 - s0) * (2 * s - s0 - s1) / (2 * v). The test
+// accepts H0 once it falls to log(beta / (1 - alpha)) and H1 once it rises
+// to log((1 - beta) / alpha), so that alpha and beta bound the chances of
+// accepting the wrong hypothesis.
+class Sprt {
+   public:
+    enum class Decision { Continue, AcceptH0, AcceptH1 };
+
+    Sprt(double elo0, double elo1, double alpha = 0.05, double beta = 0.05);
+
+    double llr(const ScoreStats& stats) const;
+    Decision decide(const ScoreStats& stats) const;
+
+    double getElo0() const { return elo0; }
+    double getElo1() const { return elo1; }
+    double getLowerBound() const { return lower_bound; }
+    double getUpperBound() const { return upper_bound; }
+
+   private:
+    double elo0, elo1;
+    double score0, score1;
+    double lower_bound, upper_bound;
+};
+
+}  // namespace Judge
+
+#endif  // !SPRT_H
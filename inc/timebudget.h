@@ -0,0 +1,55 @@
+#ifndef TIMEBUDGET_H
+#define TIMEBUDGET_H
+
+#include <sys/types.h>
+#include <ctime>
+
+namespace Engine {
+
+// A chess clock running on the CPU time a bot actually consumes, rather than
+// on wall-clock time: a bot that is descheduled on a busy machine does not
+// lose time. Every move is charged the CPU time the bot used between
+// startMove() and stopMove(); the increment is added after each move.
+class TimeBudget {
+   public:
+    // An unlimited budget; startMove() and stopMove() do nothing.
+    TimeBudget();
+    TimeBudget(pid_t pid, int initial_ms, int increment_ms);
+
+    bool isLimited() const { return limited; }
+    bool isExpired() const { return limited && remaining_us < 0; }
+
+    long long getRemainingMs() const { return remaining_us / 1000; }
+    long long getLastMoveUs() const { return last_move_us; }
+    long long getUsedUs() const { return used_us; }
+    int getMoves() const { return moves; }
+
+    // How long to wait for a reply in wall-clock time: the remaining CPU
+    // budget stretched to tolerate a loaded machine.
+    int getWallTimeoutMs() const;
+
+    // Starts the bot's clock; call right after sending it a request.
+    void startMove();
+
+    // Stops the clock and charges the move. Returns false if the move
+    // exhausted the budget.
+    bool stopMove();
+
+   private:
+    long long cpuTimeUs() const;
+
+    bool limited;
+    pid_t pid;
+    clockid_t clock;
+    bool has_clock;
+    long long remaining_us;
+    long long increment_us;
+    long long move_start_us;
+    long long last_move_us;
+    long long used_us;
+    int moves;
+};
+
+}  // namespace Engine
+
+#endif  // !TIMEBUDGET_H
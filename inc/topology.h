@@ -0,0 +1,46 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace Judge {
+
+// A physical core and its hardware threads (more than one with SMT).
+struct CpuCore {
+    int package;
+    int core_id;
+    std::vector<int> cpus;
+};
+
+// Parses a cpulist such as "0-3,8,10-11" as found in sysfs.
+std::vector<int> parse_cpu_list(const std::string& list);
+
+// The physical cores available to the judge, ordered by package and core
+// id. Only online CPUs in the judge's affinity mask are included.
+std::vector<CpuCore> detect_cpu_cores(
+    const std::string& sysfs_cpu_root = "/sys/devices/system/cpu");
+
+// Where one concurrently running match is placed.
+struct MatchSlot {
+    std::vector<int> bot_cpus;    // a dedicated physical core per player
+    std::vector<int> judge_cpus;  // the worker thread driving the match
+};
+
+// Cuts the cores into as many slots for `players` bots as can be isolated.
+// All bots of a slot sit on cores of the same package, each on a whole
+// physical core, so opponents never share a core or its hyperthreads. With
+// SMT the judge thread runs on the idle sibling threads of the slot's
+// cores; without it, one core per package is set aside for judge threads.
+std::vector<MatchSlot> plan_match_slots(const std::vector<CpuCore>& cores,
+                                        int players);
+
+// Restricts the calling thread (pid 0), or every thread of process `pid`,
+// to `cpus`. Processes started by a pinned thread inherit its mask.
+void pin_to_cpus(pid_t pid, const std::vector<int>& cpus);
+
+}  // namespace Judge
+
+#endif  // !TOPOLOGY_H
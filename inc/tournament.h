@@ -0,0 +1,76 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Judge {
+
+// A match between two bots; `first` plays as player #0.
+struct Pairing {
+    int first;
+    int second;
+};
+
+// Every unordered pair of bots exactly once, ordered in circle-method rounds
+// so that consecutive pairings involve different bots and a concurrent
+// scheduler does not pile up one bot's matches at the same time.
+std::vector<Pairing> round_robin_pairings(int bots);
+
+// Pairwise scores and game counts for a tournament. Results may be added
+// from several worker threads at once.
+class Crosstable {
+   public:
+    explicit Crosstable(int bots);
+
+    int getBots() const { return bots; }
+
+    void addResult(const Pairing& pairing, const std::vector<double>& scores);
+    void addBye(int bot, double score);
+
+    double getScore(int bot) const;
+    double getScore(int bot, int opponent) const;
+    int getGames(int bot) const;
+    int getGames(int bot, int opponent) const;
+
+    // Prints the standings ordered by total score, then the full matrix of
+    // pairwise scores.
+    void print(std::ostream& out, const std::vector<std::string>& names) const;
+
+   private:
+    int bots;
+    mutable std::mutex mutex;
+    std::vector<double> pair_scores;  // bots x bots, row scored against column
+    std::vector<int> pair_games;      // bots x bots
+    std::vector<double> total_scores;
+    std::vector<int> total_games;
+};
+
+// Generates Swiss-system rounds: bots are ranked by their current score and
+// paired top-down with the best-ranked opponent they have not met yet.
+class SwissPairer {
+   public:
+    explicit SwissPairer(int bots);
+
+    // Pairings for the next round. With an odd number of bots the
+    // lowest-ranked bot that has not had a bye yet sits out; see getBye().
+    std::vector<Pairing> nextRound(const Crosstable& table);
+
+    // The bot sitting out the last generated round, or -1.
+    int getBye() const { return bye; }
+
+   private:
+    bool haveMet(int bot1, int bot2) const { return met[bot1 * bots + bot2]; }
+
+    int bots;
+    int bye;
+    std::vector<char> met;  // bots x bots
+    std::vector<char> had_bye;
+    std::vector<int> first_seats;
+};
+
+}  // namespace Judge
+
+#endif  // !TOURNAMENT_H
@@ -0,0 +1,112 @@
+#ifndef TRANSCRIPT_H
+#define TRANSCRIPT_H
+
+// Transcripts of what passed between the judge and one player, and the
+// transport that plays a transcript back to an engine without the bot.
+//
+// A transcript is a sequence of events, each a kind byte followed by a
+// LEB128 number: the length of the bytes that follow for Output and Input,
+// the errno for OutputError and 0 for Eof. Events appear in the order the
+// playerbuf saw them, so the position of an Input among the Outputs tells
+// which of the judge's requests it answered.
+
+#include "playerstream.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Judge {
+
+struct TranscriptEvent {
+    enum Kind : char {
+        Output = 'o',       // judge to player
+        Input = 'i',        // player to judge
+        Eof = 'e',          // the player closed its output
+        OutputError = 'x',  // a write to the player failed
+    };
+
+    Kind kind;
+    std::string_view data;  // Output and Input
+    int errnum = 0;         // OutputError
+};
+
+// Splits `transcript` into its events, which point into it. Returns false
+// if it is malformed.
+bool parse_transcript(std::string_view transcript,
+                      std::vector<TranscriptEvent>& events);
+
+// Human-readable form of a transcript: one line per event, "> " before what
+// the judge sent and "< " before what the player answered.
+std::string describe_transcript(std::string_view transcript);
+
+// Records a transcript; attach it with playerbuf::set_recorder().
+class TranscriptRecorder : public player_recorder {
+   public:
+    void on_input(const char* buf, size_t len) override;
+    void on_output(const iovec* iov, int iovcnt, size_t len) override;
+    void on_output_error(int errnum) override;
+
+    const std::string& data() const { return transcript; }
+
+   private:
+    void appendEvent(TranscriptEvent::Kind kind, uint64_t number);
+
+    std::string transcript;
+};
+
+// Plays the player's side of a transcript. Input becomes readable once the
+// engine has written as many bytes as the judge had sent when the input
+// was read, so replies answer the same requests as in the recording and a
+// request that went unanswered times out again, after the engine's real
+// timeout. What the engine writes is compared with the recorded output.
+class ReplayTransport : public player_transport {
+   public:
+    // Exits with an error if `transcript` is malformed. It has to outlive
+    // the transport.
+    explicit ReplayTransport(std::string_view transcript);
+    ~ReplayTransport() override;
+
+    ssize_t read(char* buf, size_t len) override;
+    ssize_t write(const char* buf, size_t len) override;
+    int get_poll_fd() const override { return event_fd; }
+
+    // Whether the engine has written exactly what the judge sent in the
+    // recording, so far.
+    bool outputMatches() const { return !diverged; }
+    // Whether it has also written all of it.
+    bool outputComplete() const {
+        return !diverged && written == expected_output.size();
+    }
+
+    ReplayTransport(const ReplayTransport&) = delete;
+    ReplayTransport& operator=(const ReplayTransport&) = delete;
+
+   private:
+    // Input, or the end of it, available once `written` reaches `after`.
+    struct Chunk {
+        size_t after;
+        std::string_view data;
+        bool eof;
+    };
+
+    bool inputReady() const;
+    void updatePollFd();
+
+    std::vector<Chunk> input;
+    size_t next_chunk = 0;
+    size_t chunk_offset = 0;
+    std::string expected_output;
+    size_t written = 0;
+    bool diverged = false;
+    // Writes fail with `error_errnum` once `written` reaches `error_after`.
+    size_t error_after;
+    int error_errnum = 0;
+    int event_fd;
+    bool signalled = false;
+};
+
+}  // namespace Judge
+
+#endif  // !TRANSCRIPT_H
@@ -0,0 +1,168 @@
+#include "botpool.h"
+#include "err.h"
+#include "playerstream.h"
+#include "shmtransport.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace Judge {
+
+// Replies longer than this cannot be a "READY" line.
+constexpr size_t MAX_STALE_LINE = 1 << 16;
+
+std::unique_ptr<BotProcess> spawn_bot(const std::string& program,
+                                      unsigned seed,
+                                      filedesc_t err_fd,
+                                      bool shm_transport) {
+    int read_pipe[2];
+    int write_pipe[2];
+    make_cloexec_pipe(read_pipe);
+    make_cloexec_pipe(write_pipe);
+
+    std::unique_ptr<BotProcess> bot(
+        new BotProcess{program, {}, read_pipe[PIPE_READ_END],
+                       write_pipe[PIPE_WRITE_END], err_fd, 0});
+    std::vector<FdMapping> fds = {{write_pipe[PIPE_READ_END], fileno(stdin)},
+                                  {read_pipe[PIPE_WRITE_END], fileno(stdout)},
+                                  {err_fd, fileno(stderr)}};
+    std::vector<std::string> env;
+    if (shm_transport) {
+        auto transport =
+            std::make_shared<ShmTransport>(read_pipe[PIPE_READ_END]);
+        for (const FdMapping& fd : transport->getChildFds())
+            fds.push_back(fd);
+        env.push_back(ShmTransport::getChildEnv());
+        bot->transport = transport;
+    }
+    int rv = launch(program, {std::to_string(seed)}, fds, bot->process, env);
+    if (rv != 0)
+        dprintf(err_fd,
+                "ERROR: Cannot use/find the program binary on $PATH: %s "
+                "(%d; %s)\n",
+                program.c_str(), rv, strerror(rv));
+
+    SYSCALL_WITH_CHECK(close(write_pipe[PIPE_READ_END]));
+    SYSCALL_WITH_CHECK(close(read_pipe[PIPE_WRITE_END]));
+    return bot;
+}
+
+void terminate_bot(BotProcess& bot) {
+    kill_child(bot.process);
+    reap_child(bot.process);
+    bot.transport.reset();
+    SYSCALL_WITH_CHECK(close(bot.read_fd));
+    SYSCALL_WITH_CHECK(close(bot.write_fd));
+    SYSCALL_WITH_CHECK(close(bot.err_fd));
+}
+
+static long long now_ms() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+BotPool::BotPool(int p_reset_timeout_ms)
+    : reset_timeout_ms(p_reset_timeout_ms) {}
+
+BotPool::~BotPool() {
+    for (auto& [program, bots] : idle)
+        for (auto& bot : bots)
+            terminate_bot(*bot);
+}
+
+bool BotPool::reset(BotProcess& bot, unsigned seed) {
+    std::unique_ptr<playerbuf> pbuf_owner(
+        bot.transport ? new playerbuf(bot.transport)
+                      : new playerbuf(bot.read_fd, bot.write_fd));
+    playerbuf& pbuf = *pbuf_owner;
+    pbuf.set_write_timeout_ms(reset_timeout_ms);
+    std::ostream out(&pbuf);
+    out << "NEWGAME " << seed << '\n' << std::flush;
+    if (!out.good())
+        return false;
+
+    const long long deadline = now_ms() + reset_timeout_ms;
+    std::string line;
+    bool may_read = false;
+    while (true) {
+        switch (pbuf.read_line_nonblocking(line, may_read)) {
+            case playerbuf::line_status::complete:
+                if (line == "READY")
+                    return true;
+                line.clear();
+                may_read = false;
+                continue;
+            case playerbuf::line_status::eof:
+            case playerbuf::line_status::error:
+                return false;
+            case playerbuf::line_status::pending:
+                break;
+        }
+        if (line.size() > MAX_STALE_LINE)
+            return false;
+
+        pollfd pfd = {pbuf.get_input_fd(), POLLIN, 0};
+        long long remaining_ms = deadline - now_ms();
+        if (remaining_ms <= 0)
+            return false;
+        int rv = poll(&pfd, 1, static_cast<int>(remaining_ms));
+        if (rv == 0 || (rv == -1 && errno != EINTR))
+            return false;
+        may_read = (rv > 0);
+    }
+}
+
+std::unique_ptr<BotProcess> BotPool::acquire(const std::string& program,
+                                             unsigned seed) {
+    while (true) {
+        std::unique_ptr<BotProcess> bot;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& bots = idle[program];
+            if (support[program] == Support::No || bots.empty())
+                return nullptr;
+            bot = std::move(bots.back());
+            bots.pop_back();
+        }
+
+        // A bot that died in its last game says nothing about its program.
+        if (!is_running(bot->process)) {
+            terminate_bot(*bot);
+            continue;
+        }
+        bool ok = reset(*bot, seed);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Support& supported = support[program];
+            if (ok)
+                supported = Support::Yes;
+            else if (supported == Support::Unknown)
+                supported = Support::No;
+        }
+        if (ok) {
+            bot->matches_played++;
+            return bot;
+        }
+        // Hung or never supported resets: replace it.
+        terminate_bot(*bot);
+    }
+}
+
+void BotPool::release(std::unique_ptr<BotProcess> bot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (support[bot->program] != Support::No) {
+            idle[bot->program].push_back(std::move(bot));
+            return;
+        }
+    }
+    terminate_bot(*bot);
+}
+
+}  // namespace Judge
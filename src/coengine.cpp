@@ -0,0 +1,181 @@
+#include "coengine.h"
+#include "err.h"
+#include "monotonic.h"
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace Engine {
+
+static thread_local Reactor* current_reactor = nullptr;
+
+Reactor::Running::Running(Reactor* reactor) : previous(current_reactor) {
+    current_reactor = reactor;
+}
+
+Reactor::Running::~Running() {
+    current_reactor = previous;
+}
+
+bool Reactor::Deadline::operator>(const Deadline& other) const {
+    if (when.tv_sec != other.when.tv_sec)
+        return when.tv_sec > other.when.tv_sec;
+    return when.tv_nsec > other.when.tv_nsec;
+}
+
+Reactor::Reactor() {
+    SYSCALL_WITH_CHECK(epoll_fd = epoll_create1(EPOLL_CLOEXEC));
+}
+
+Reactor::~Reactor() {
+    close(epoll_fd);
+}
+
+Reactor& Reactor::current() {
+    if (current_reactor == nullptr)
+        fatal("co_await on players outside of a reactor");
+    return *current_reactor;
+}
+
+uint64_t Reactor::watch(int fd,
+                        short events,
+                        const timespec& deadline,
+                        callback_t callback) {
+    uint64_t id = next_id++;
+    epoll_event event = {};
+    event.events = 0;
+    if (events & POLLIN)
+        event.events |= EPOLLIN;
+    if (events & POLLOUT)
+        event.events |= EPOLLOUT;
+    event.data.u64 = id;
+    SYSCALL_WITH_CHECK(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event));
+    watches.emplace(id, Watch{fd, std::move(callback)});
+    deadlines.push({deadline, id});
+    return id;
+}
+
+void Reactor::cancel(uint64_t id) {
+    auto it = watches.find(id);
+    if (it == watches.end())
+        return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    watches.erase(it);
+}
+
+// Callbacks may watch and cancel descriptors, even their own again.
+void Reactor::fire(uint64_t id, bool ready) {
+    auto it = watches.find(id);
+    if (it == watches.end())
+        return;
+    callback_t callback = std::move(it->second.callback);
+    cancel(id);
+    callback(ready);
+}
+
+bool Reactor::runOnce() {
+    // Deadlines of watches that fired or were cancelled go stale.
+    while (!deadlines.empty() && watches.count(deadlines.top().id) == 0)
+        deadlines.pop();
+    if (watches.empty())
+        return false;
+
+    // Rounded up, so that the deadline has passed when epoll_wait returns.
+    timespec left = Monotonic::time_left(deadlines.top().when);
+    int timeout_ms = left.tv_sec * 1000 + (left.tv_nsec + 999999) / 1000000;
+    epoll_event events[64];
+    int n = epoll_wait(epoll_fd, events, 64, timeout_ms);
+    if (n == -1 && errno != EINTR)
+        syserr("epoll_wait");
+
+    Running running(this);
+    for (int k = 0; k < n; k++)
+        fire(events[k].data.u64, true);
+    const Deadline now = {Monotonic::now(), 0};
+    while (!deadlines.empty() && !(deadlines.top() > now)) {
+        uint64_t id = deadlines.top().id;
+        deadlines.pop();
+        fire(id, false);
+    }
+    return true;
+}
+
+ExchangeAwaitable::ExchangeAwaitable(std::vector<PlayerData*> p_players,
+                                     std::string p_message,
+                                     int p_timeout_ms)
+    : players(std::move(p_players)),
+      message(std::move(p_message)),
+      timeout_ms(p_timeout_ms) {}
+
+bool ExchangeAwaitable::await_ready() {
+    round.emplace(players, message, timeout_ms);
+    return round->getPending().empty();
+}
+
+void ExchangeAwaitable::await_suspend(std::coroutine_handle<> awaiter) {
+    handle = awaiter;
+    reactor = &Reactor::current();
+    watches.assign(players.size(), 0);
+    for (size_t i : round->getPending())
+        watch(i);
+}
+
+void ExchangeAwaitable::watch(size_t i) {
+    pollfd wait_for = round->getWaitFor(i);
+    watches[i] = reactor->watch(wait_for.fd, wait_for.events,
+                                round->getDeadline(), [this, i](bool ready) {
+                                    onEvent(i, ready);
+                                });
+}
+
+void ExchangeAwaitable::onEvent(size_t i, bool ready) {
+    watches[i] = 0;
+    if (ready) {
+        round->ready(i);
+        const std::vector<size_t>& pending = round->getPending();
+        if (std::find(pending.begin(), pending.end(), i) != pending.end())
+            watch(i);
+        if (!pending.empty())
+            return;
+    }
+    // All replies are in, or the deadline passed for all that are not.
+    for (uint64_t id : watches) {
+        if (id != 0)
+            reactor->cancel(id);
+    }
+    // The coroutine may finish and free this awaitable.
+    handle.resume();
+}
+
+ExchangeAwaitable exchange_async(const std::vector<PlayerData*>& players,
+                                 const std::string& message,
+                                 int timeout_ms) {
+    return ExchangeAwaitable(players, message, timeout_ms);
+}
+
+ExchangeAwaitable exchange_async(std::vector<PlayerData>& players,
+                                 const std::string& message,
+                                 int timeout_ms) {
+    std::vector<PlayerData*> player_ptrs;
+    player_ptrs.reserve(players.size());
+    for (auto& player : players)
+        player_ptrs.push_back(&player);
+    return ExchangeAwaitable(std::move(player_ptrs), message, timeout_ms);
+}
+
+GameResult run_blocking(Task<GameResult> task) {
+    Reactor reactor;
+    std::optional<GameResult> result;
+    reactor.spawn<GameResult>(std::move(task), [&](GameResult game_result) {
+        result.emplace(std::move(game_result));
+    });
+    reactor.run();
+    if (!result)
+        fatal("a match was left waiting for nothing");
+    return std::move(*result);
+}
+
+}  // namespace Engine
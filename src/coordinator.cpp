@@ -0,0 +1,701 @@
+#include "coordinator.h"
+#include "err.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace Judge {
+
+static const char PROTOCOL_VERSION[] = "3";
+
+static std::vector<std::string> split(const std::string& line, char sep) {
+    std::vector<std::string> fields;
+    size_t begin = 0;
+    while (true) {
+        size_t end = line.find(sep, begin);
+        fields.push_back(line.substr(begin, end - begin));
+        if (end == std::string::npos)
+            return fields;
+        begin = end + 1;
+    }
+}
+
+// Tabs and line breaks would split the field.
+static std::string field(const std::string& text) {
+    std::string cleaned = text;
+    std::replace_if(
+        cleaned.begin(), cleaned.end(),
+        [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+    return cleaned;
+}
+
+static bool parse_number(const std::string& text, long long& value) {
+    auto [end, ec] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc() && end == text.data() + text.size();
+}
+
+// Splits "unix:PATH" and "HOST:PORT"; HOST may be an IPv6 address in
+// brackets.
+static bool split_address(const std::string& address,
+                          std::string& unix_path,
+                          std::string& host,
+                          std::string& port) {
+    if (address.rfind("unix:", 0) == 0) {
+        unix_path = address.substr(5);
+        return !unix_path.empty() &&
+               unix_path.size() < sizeof(sockaddr_un::sun_path);
+    }
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size())
+        return false;
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+        host = host.substr(1, host.size() - 2);
+    return true;
+}
+
+static sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+}
+
+static addrinfo* resolve(const std::string& address,
+                         const std::string& host,
+                         const std::string& port,
+                         bool passive) {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* list;
+    int rv = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(),
+                         &hints, &list);
+    if (rv != 0)
+        fatal("Cannot resolve %s: %s", address.c_str(), gai_strerror(rv));
+    return list;
+}
+
+// Takes as long whatever the first difference, so that guesses learn
+// nothing from the time it takes to refuse them.
+static bool same_token(const std::string& given, const std::string& token) {
+    unsigned char difference = given.size() != token.size();
+    for (size_t i = 0; i < given.size(); i++)
+        difference |= given[i] ^ token[i % std::max<size_t>(token.size(), 1)];
+    return difference == 0;
+}
+
+static bool is_loopback(const sockaddr* addr) {
+    if (addr->sa_family == AF_INET) {
+        const auto* in = reinterpret_cast<const sockaddr_in*>(addr);
+        return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (addr->sa_family == AF_INET6) {
+        const auto* in6 = reinterpret_cast<const sockaddr_in6*>(addr);
+        return IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr);
+    }
+    return false;
+}
+
+static std::string describe_peer(const sockaddr* addr, socklen_t length) {
+    char host[NI_MAXHOST], port[NI_MAXSERV];
+    if (getnameinfo(addr, length, host, sizeof(host), port, sizeof(port),
+                    NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+        return "?";
+    if (addr->sa_family == AF_INET6)
+        return std::string("[") + host + "]:" + port;
+    return std::string(host) + ":" + port;
+}
+
+// Matches and results are small and latency matters more than packing.
+static void tune_tcp(filedesc_t fd) {
+    int one = 1;
+    SYSCALL_WITH_CHECK(
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)));
+    SYSCALL_WITH_CHECK(
+        setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one)));
+}
+
+Coordinator::Coordinator(const std::string& address,
+                         uint64_t p_run_seed,
+                         std::vector<std::string> p_games,
+                         int match_timeout_ms,
+                         std::string p_token)
+    : run_seed(p_run_seed),
+      games(std::move(p_games)),
+      match_timeout(std::chrono::milliseconds(match_timeout_ms)),
+      token(std::move(p_token)) {
+    std::string path, host, port;
+    if (!split_address(address, path, host, port))
+        fatal("Bad coordinator address %s; expected unix:PATH or HOST:PORT",
+              address.c_str());
+    if (!path.empty()) {
+        SYSCALL_WITH_CHECK(listen_fd =
+                               socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        sockaddr_un addr = unix_address(path);
+        // A socket left behind by an earlier coordinator refuses
+        // connections; one that takes them is still in use.
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            int probe;
+            SYSCALL_WITH_CHECK(
+                probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+            int rv = connect(probe, reinterpret_cast<sockaddr*>(&addr),
+                             sizeof(addr));
+            int error = errno;
+            SYSCALL_WITH_CHECK(close(probe));
+            if (rv == 0)
+                fatal("Cannot listen on %s: another coordinator does",
+                      address.c_str());
+            if (error == ECONNREFUSED)
+                unlink(path.c_str());
+        }
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr),
+                 sizeof(addr)) == -1)
+            syserr("Cannot listen on %s", address.c_str());
+        unix_path = path;
+        bound_address = address;
+    } else {
+        // Without a host, only workers on this one may connect.
+        addrinfo* list = resolve(address, host, port, false);
+        listen_fd = -1;
+        for (addrinfo* ai = list; ai != nullptr; ai = ai->ai_next) {
+            int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                            ai->ai_protocol);
+            if (fd == -1)
+                continue;
+            int one = 1;
+            SYSCALL_WITH_CHECK(
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                listen_fd = fd;
+                break;
+            }
+            SYSCALL_WITH_CHECK(close(fd));
+        }
+        freeaddrinfo(list);
+        if (listen_fd == -1)
+            syserr("Cannot listen on %s", address.c_str());
+        sockaddr_storage addr;
+        socklen_t length = sizeof(addr);
+        SYSCALL_WITH_CHECK(getsockname(
+            listen_fd, reinterpret_cast<sockaddr*>(&addr), &length));
+        bound_address =
+            describe_peer(reinterpret_cast<sockaddr*>(&addr), length);
+        // Anyone who reaches the port could send made-up results.
+        if (!is_loopback(reinterpret_cast<sockaddr*>(&addr)) &&
+            token.empty())
+            fatal("Listening on %s needs a token that workers must know, "
+                  "in BOTS_JUDGE_TOKEN",
+                  bound_address.c_str());
+    }
+    SYSCALL_WITH_CHECK(listen(listen_fd, SOMAXCONN));
+}
+
+Coordinator::~Coordinator() {
+    finish();
+}
+
+void Coordinator::finish() {
+    if (finished)
+        return;
+    finished = true;
+    for (std::unique_ptr<Connection>& connection : connections) {
+        connection->output += "END\n";
+        // Give every worker a moment to take it, however busy it is.
+        int flags;
+        SYSCALL_WITH_CHECK(flags = fcntl(connection->fd, F_GETFL));
+        SYSCALL_WITH_CHECK(
+            fcntl(connection->fd, F_SETFL, flags & ~O_NONBLOCK));
+        timeval timeout = {1, 0};
+        SYSCALL_WITH_CHECK(setsockopt(connection->fd, SOL_SOCKET, SO_SNDTIMEO,
+                                      &timeout, sizeof(timeout)));
+        flush(*connection);
+        SYSCALL_WITH_CHECK(close(connection->fd));
+    }
+    connections.clear();
+    SYSCALL_WITH_CHECK(close(listen_fd));
+    if (!unix_path.empty())
+        unlink(unix_path.c_str());
+}
+
+void Coordinator::accept() {
+    sockaddr_storage addr;
+    socklen_t length = sizeof(addr);
+    int fd = accept4(listen_fd, reinterpret_cast<sockaddr*>(&addr), &length,
+                     SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd == -1) {
+        // The worker may have given up already.
+        if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED)
+            return;
+        syserr("Cannot accept a worker");
+    }
+    auto connection = std::make_unique<Connection>();
+    connection->fd = fd;
+    if (addr.ss_family == AF_UNIX) {
+        connection->name = "local#" + std::to_string(next_worker++);
+    } else {
+        tune_tcp(fd);
+        connection->name =
+            describe_peer(reinterpret_cast<sockaddr*>(&addr), length);
+    }
+    connections.push_back(std::move(connection));
+}
+
+// Answers every GET it can: all of it, or as much as is queued.
+void Coordinator::handOut(Run& run) {
+    for (std::unique_ptr<Connection>& connection : connections) {
+        if (connection->wanted == 0 || run.queue.empty() ||
+            connection->closing)
+            continue;
+        size_t count =
+            std::min(static_cast<size_t>(connection->wanted), run.queue.size());
+        connection->wanted = 0;
+        connection->output += "MATCHES\t" + std::to_string(count) + "\n";
+        // The worker may be busy with as many matches as it asked for.
+        clock::time_point deadline = clock::now() + 2 * match_timeout;
+        for (size_t i = 0; i < count; i++) {
+            size_t index = run.queue.front();
+            run.queue.pop_front();
+            const RemoteMatch& match = run.matches[index];
+            uint64_t ticket = next_ticket++;
+            connection->out[ticket] = {index, deadline};
+            std::string line = "MATCH\t" + std::to_string(ticket) + "\t" +
+                               std::to_string(match.battle_id) + "\t" +
+                               std::to_string(match.round) + "\t" +
+                               field(match.game);
+            for (const std::string& program : match.programs)
+                line += "\t" + field(program);
+            connection->output += line + "\n";
+        }
+    }
+}
+
+void Coordinator::run(const std::vector<RemoteMatch>& matches,
+                      const result_fun_t& on_result) {
+    Run run{matches, on_result, {}, matches.size()};
+    for (size_t i = 0; i < matches.size(); i++)
+        run.queue.push_back(i);
+    while (run.left > 0 && !run.stopped) {
+        handOut(run);
+        // Flushing may have stopped at a full socket buffer.
+        for (std::unique_ptr<Connection>& connection : connections) {
+            if (!flush(*connection)) {
+                drop(*connection, run, "cannot send to it");
+            } else if (connection->closing && connection->output.empty()) {
+                SYSCALL_WITH_CHECK(close(connection->fd));
+                connection->fd = -1;
+            }
+        }
+        removeClosed();
+        if (run.stopped || run.left == 0)
+            break;
+        std::vector<pollfd> fds = {{listen_fd, POLLIN, 0}};
+        for (const std::unique_ptr<Connection>& connection : connections) {
+            short events = POLLIN;
+            if (!connection->output.empty())
+                events |= POLLOUT;
+            fds.push_back({connection->fd, events, 0});
+        }
+        if (poll(fds.data(), fds.size(), pollTimeoutMs()) == -1) {
+            if (errno == EINTR)
+                continue;
+            syserr("poll");
+        }
+        // New connections are appended, after those polled.
+        size_t polled = connections.size();
+        for (size_t i = 0; i < polled && !run.stopped; i++) {
+            Connection& connection = *connections[i];
+            if (fds[i + 1].revents == 0 || connection.fd == -1)
+                continue;
+            receive(connection, run);
+        }
+        if (fds[0].revents & POLLIN)
+            accept();
+        expire(run);
+        removeClosed();
+    }
+    // Whatever is still out belongs to this run only.
+    for (std::unique_ptr<Connection>& connection : connections)
+        connection->out.clear();
+}
+
+void Coordinator::removeClosed() {
+    connections.erase(
+        std::remove_if(connections.begin(), connections.end(),
+                       [](const std::unique_ptr<Connection>& connection) {
+                           return connection->fd == -1;
+                       }),
+        connections.end());
+}
+
+// Drops the workers that keep a match past its deadline.
+void Coordinator::expire(Run& run) {
+    clock::time_point now = clock::now();
+    for (std::unique_ptr<Connection>& connection : connections) {
+        for (const auto& [ticket, out] : connection->out) {
+            if (out.deadline <= now && connection->fd != -1) {
+                drop(*connection, run,
+                     "match " + std::to_string(run.matches[out.index].job_id) +
+                         " took too long");
+                break;
+            }
+        }
+    }
+}
+
+// Until the nearest deadline, or -1 if no match is out.
+int Coordinator::pollTimeoutMs() const {
+    std::optional<clock::time_point> nearest;
+    for (const std::unique_ptr<Connection>& connection : connections) {
+        for (const auto& [ticket, out] : connection->out) {
+            if (!nearest || out.deadline < *nearest)
+                nearest = out.deadline;
+        }
+    }
+    if (!nearest)
+        return -1;
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(*nearest -
+                                                             clock::now());
+    return static_cast<int>(std::clamp<long long>(
+        left.count(), 0, std::numeric_limits<int>::max()));
+}
+
+// Reads what the worker sent and handles its complete lines. Returns false
+// if the worker was dropped.
+bool Coordinator::receive(Connection& connection, Run& run) {
+    char buf[1 << 16];
+    while (true) {
+        ssize_t rv = recv(connection.fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (rv <= 0) {
+            drop(connection, run,
+                 rv == 0 ? "it disconnected" : strerror(errno));
+            return false;
+        }
+        connection.input.append(buf, rv);
+        if (static_cast<size_t>(rv) < sizeof(buf))
+            break;
+    }
+    size_t begin = 0, end;
+    while ((end = connection.input.find('\n', begin)) != std::string::npos) {
+        std::string line = connection.input.substr(begin, end - begin);
+        begin = end + 1;
+        if (!handle(connection, line, run))
+            return false;
+    }
+    connection.input.erase(0, begin);
+    if (!flush(connection)) {
+        drop(connection, run, "cannot send to it");
+        return false;
+    }
+    return true;
+}
+
+bool Coordinator::handle(Connection& connection,
+                         const std::string& line,
+                         Run& run) {
+    std::vector<std::string> fields = split(line, '\t');
+    const std::string& command = fields[0];
+    if (command == "HELLO" && !connection.greeted && fields.size() >= 2 &&
+        (fields[1] != PROTOCOL_VERSION || fields.size() == 4)) {
+        if (fields[1] != PROTOCOL_VERSION) {
+            connection.output += "ERROR\tprotocol version " +
+                                 std::string(PROTOCOL_VERSION) +
+                                 " is needed\n";
+            connection.closing = true;
+            return true;
+        }
+        if (!same_token(fields[3], token)) {
+            fprintf(stderr, "WARNING: Refused worker %s: wrong token\n",
+                    connection.name.c_str());
+            connection.output += "ERROR\twrong token\n";
+            connection.closing = true;
+            return true;
+        }
+        std::vector<std::string> worker_games = split(fields[2], ',');
+        for (const std::string& game : games) {
+            if (std::find(worker_games.begin(), worker_games.end(),
+                          field(game)) == worker_games.end()) {
+                connection.output += "ERROR\tthe run needs game " +
+                                     field(game) + "\n";
+                connection.closing = true;
+                return true;
+            }
+        }
+        connection.greeted = true;
+        connection.output += "RUN\t" + std::to_string(run_seed) + "\n";
+        return true;
+    }
+    long long number;
+    if (command == "GET" && connection.greeted && fields.size() == 2 &&
+        parse_number(fields[1], number) && number > 0) {
+        connection.wanted = static_cast<int>(std::min(number, 1LL << 20));
+        return true;
+    }
+    long long ticket, type, game_us;
+    if (command == "RESULT" && connection.greeted && fields.size() == 6 &&
+        parse_number(fields[1], ticket) && parse_number(fields[2], type) &&
+        type >= Engine::GameResult::Win &&
+        type <= Engine::GameResult::EngineError &&
+        parse_number(fields[3], game_us)) {
+        RemoteResult result;
+        result.ticket = ticket;
+        result.type = static_cast<Engine::GameResult::ResultType>(type);
+        result.game_us = game_us;
+        if (!fields[4].empty()) {
+            for (const std::string& score : split(fields[4], ';'))
+                result.scores.push_back(strtod(score.c_str(), nullptr));
+        }
+        result.details = fields[5];
+        auto it = connection.out.find(ticket);
+        // A match of an earlier run, or one taken back from this worker.
+        if (it == connection.out.end())
+            return true;
+        const RemoteMatch& match = run.matches[it->second.index];
+        connection.out.erase(it);
+        run.left--;
+        if (!run.stopped && !run.on_result(match, result, connection.name))
+            run.stopped = true;
+        return true;
+    }
+    drop(connection, run, "it broke the protocol: " + line.substr(0, 80));
+    return false;
+}
+
+// Sends as much output as the socket takes. Returns false on errors.
+bool Coordinator::flush(Connection& connection) {
+    while (!connection.output.empty()) {
+        ssize_t rv = ::send(connection.fd, connection.output.data(),
+                            connection.output.size(), MSG_NOSIGNAL);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (rv == -1)
+            return false;
+        connection.output.erase(0, rv);
+    }
+    return true;
+}
+
+void Coordinator::drop(Connection& connection,
+                       Run& run,
+                       const std::string& why) {
+    // Lost matches are played next, in their order.
+    std::vector<size_t> lost;
+    for (const auto& [ticket, out] : connection.out)
+        lost.push_back(out.index);
+    std::sort(lost.begin(), lost.end());
+    run.queue.insert(run.queue.begin(), lost.begin(), lost.end());
+    requeued += lost.size();
+    if (connection.greeted)
+        fprintf(stderr, "WARNING: Lost worker %s (%s); %zu matches re-queued\n",
+                connection.name.c_str(), why.c_str(), lost.size());
+    connection.out.clear();
+    SYSCALL_WITH_CHECK(close(connection.fd));
+    connection.fd = -1;
+}
+
+WorkerClient::WorkerClient(const std::string& p_address,
+                           const std::vector<std::string>& games,
+                           const std::string& token)
+    : address(p_address) {
+    std::string path, host, port;
+    if (!split_address(address, path, host, port))
+        fatal("Bad coordinator address %s; expected unix:PATH or HOST:PORT",
+              address.c_str());
+    if (!path.empty()) {
+        SYSCALL_WITH_CHECK(fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        sockaddr_un addr = unix_address(path);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ==
+            -1)
+            syserr("Cannot connect to the coordinator at %s", address.c_str());
+    } else {
+        addrinfo* list = resolve(address, host, port, false);
+        fd = -1;
+        for (addrinfo* ai = list; ai != nullptr && fd == -1;
+             ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                        ai->ai_protocol);
+            if (fd != -1 && connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+                SYSCALL_WITH_CHECK(close(fd));
+                fd = -1;
+            }
+        }
+        freeaddrinfo(list);
+        if (fd == -1)
+            syserr("Cannot connect to the coordinator at %s", address.c_str());
+        tune_tcp(fd);
+    }
+
+    std::string hello = "HELLO\t" + std::string(PROTOCOL_VERSION) + "\t";
+    for (size_t i = 0; i < games.size(); i++)
+        hello += (i > 0 ? "," : "") + field(games[i]);
+    send(hello + "\t" + field(token) + "\n");
+    std::vector<std::string> fields = split(readLine(), '\t');
+    long long seed;
+    if (fields[0] == "ERROR" && fields.size() == 2)
+        fatal("The coordinator at %s refused this worker: %s",
+              address.c_str(), fields[1].c_str());
+    if (fields[0] != "RUN" || fields.size() != 2 ||
+        !parse_number(fields[1], seed))
+        fatal("%s does not speak the coordinator protocol", address.c_str());
+    run_seed = seed;
+}
+
+WorkerClient::~WorkerClient() {
+    SYSCALL_WITH_CHECK(close(fd));
+}
+
+std::string WorkerClient::readLine() {
+    size_t end;
+    while ((end = input.find('\n')) == std::string::npos) {
+        if (disconnected)
+            fatal("Lost the coordinator at %s", address.c_str());
+        char buf[1 << 16];
+        ssize_t rv = recv(fd, buf, sizeof(buf), 0);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv == -1)
+            syserr("Lost the coordinator at %s", address.c_str());
+        if (rv == 0)
+            fatal("Lost the coordinator at %s", address.c_str());
+        input.append(buf, rv);
+    }
+    std::string line = input.substr(0, end);
+    input.erase(0, end + 1);
+    return line;
+}
+
+void WorkerClient::send(const std::string& data) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t rv = ::send(fd, data.data() + sent, data.size() - sent,
+                            MSG_NOSIGNAL);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv == -1)
+            return;
+        sent += rv;
+    }
+}
+
+// Reads whatever the coordinator has sent so far, without waiting.
+void WorkerClient::readAvailable() {
+    while (true) {
+        char buf[1 << 16];
+        ssize_t rv = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (rv == -1)
+            syserr("Lost the coordinator at %s", address.c_str());
+        // It may have ended the run and left; what it sent first counts.
+        if (rv == 0) {
+            disconnected = true;
+            return;
+        }
+        input.append(buf, rv);
+    }
+}
+
+// Whether the whole answer to a GET is in `input`. Anything but one counts
+// as complete, for next() to report.
+bool WorkerClient::answerBuffered() const {
+    size_t end = input.find('\n');
+    if (end == std::string::npos)
+        return false;
+    std::vector<std::string> fields = split(input.substr(0, end), '\t');
+    long long count;
+    if (fields[0] != "MATCHES" || fields.size() != 2 ||
+        !parse_number(fields[1], count) || count <= 0)
+        return true;
+    return std::count(input.begin(), input.end(), '\n') > count;
+}
+
+std::optional<RemoteMatch> WorkerClient::next(int batch, bool wait) {
+    std::unique_lock<std::mutex> lock(read_mutex, std::defer_lock);
+    if (wait)
+        lock.lock();
+    else if (!lock.try_lock())
+        return std::nullopt;
+    if (fetched.empty() && !ended) {
+        if (!asked) {
+            send("GET\t" + std::to_string(batch) + "\n");
+            asked = true;
+        }
+        if (!wait) {
+            if (!disconnected)
+                readAvailable();
+            if (!answerBuffered() && !disconnected)
+                return std::nullopt;
+        }
+        asked = false;
+        std::vector<std::string> fields = split(readLine(), '\t');
+        long long count = 0;
+        if (fields[0] == "END" && fields.size() == 1) {
+            ended = true;
+        } else if (fields[0] != "MATCHES" || fields.size() != 2 ||
+                   !parse_number(fields[1], count) || count <= 0) {
+            fatal("Unexpected message from the coordinator at %s",
+                  address.c_str());
+        }
+        for (long long i = 0; i < count; i++) {
+            fields = split(readLine(), '\t');
+            long long ticket, battle_id, round;
+            if (fields[0] != "MATCH" || fields.size() < 5 ||
+                !parse_number(fields[1], ticket) ||
+                !parse_number(fields[2], battle_id) ||
+                !parse_number(fields[3], round))
+                fatal("Unexpected message from the coordinator at %s",
+                      address.c_str());
+            fetched.push_back(
+                {static_cast<int>(ticket), static_cast<int>(battle_id),
+                 static_cast<int>(round), fields[4],
+                 {fields.begin() + 5, fields.end()}});
+        }
+    }
+    if (fetched.empty())
+        return std::nullopt;
+    RemoteMatch match = std::move(fetched.front());
+    fetched.pop_front();
+    return match;
+}
+
+void WorkerClient::sendResult(const RemoteResult& result) {
+    std::string line = "RESULT\t" + std::to_string(result.ticket) + "\t" +
+                       std::to_string(static_cast<int>(result.type)) + "\t" +
+                       std::to_string(result.game_us) + "\t";
+    for (size_t i = 0; i < result.scores.size(); i++) {
+        char digits[32];
+        auto [end, ec] =
+            std::to_chars(digits, digits + sizeof(digits), result.scores[i]);
+        line += (i > 0 ? ";" : "") + std::string(digits, end);
+    }
+    send(line + "\t" + field(result.details) + "\n");
+}
+
+}  // namespace Judge
@@ -6,6 +6,12 @@ namespace Engine {
 GameResult::GameResult()
     : type(EngineError), pretty_result("undefined error") {}
 
+void GameResult::setLatencies(const std::vector<PlayerData>& players) {
+    for (const PlayerData& player : players)
+        player_latencies.push_back(
+            player.playerStream().get_response_times());
+}
+
 GameResult GameResult::createWin(const std::vector<PlayerData>& players,
                                  const PlayerData& winner,
                                  std::string result_details) {
@@ -18,6 +24,7 @@ GameResult GameResult::createWin(const std::vector<PlayerData>& players,
     pretty << "Player #" << winner.getPlayerId() << " ("
            << winner.getProgramName() << ") won [" << result_details << "]";
     result.pretty_result = pretty.str();
+    result.setLatencies(players);
     return result;
 }
 
@@ -29,6 +36,7 @@ GameResult GameResult::createDraw(const std::vector<PlayerData>& players,
     std::ostringstream pretty;
     pretty << "Draw [" << result_details << "]";
     result.pretty_result = pretty.str();
+    result.setLatencies(players);
     return result;
 }
 
@@ -40,6 +48,17 @@ GameResult GameResult::createError(const std::vector<PlayerData>& players,
     std::ostringstream pretty;
     pretty << "Match aborted due to engine error: " << error_details;
     result.pretty_result = pretty.str();
+    result.setLatencies(players);
+    return result;
+}
+
+GameResult GameResult::createRecorded(ResultType type,
+                                      std::vector<double> player_scores,
+                                      std::string pretty_result) {
+    GameResult result;
+    result.type = type;
+    result.player_scores = std::move(player_scores);
+    result.pretty_result = std::move(pretty_result);
     return result;
 }
 
@@ -53,4 +72,13 @@ PlayerData::PlayerData(filedesc_t read_fd,
     error_stream.reset(new oplayerstream(error_fd));
 }
 
+PlayerData::PlayerData(std::shared_ptr<player_transport> transport,
+                       filedesc_t error_fd,
+                       std::string p_name,
+                       int p_id)
+    : program_name(std::move(p_name)), player_id(p_id) {
+    player_stream.reset(new playerstream(std::move(transport)));
+    error_stream.reset(new oplayerstream(error_fd));
+}
+
 }  // namespace Engine
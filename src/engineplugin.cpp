@@ -0,0 +1,34 @@
+#include "engineplugin.h"
+#include "err.h"
+
+#include <dlfcn.h>
+
+namespace Judge {
+
+Game load_engine_plugin(const std::string& path) {
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+        fatal("Cannot load engine plugin %s: %s", path.c_str(), dlerror());
+    auto entry = reinterpret_cast<bots_judge_engine_fn>(
+        dlsym(handle, BOTS_JUDGE_ENGINE_SYMBOL));
+    if (entry == nullptr)
+        fatal("%s is not an engine plugin: %s", path.c_str(), dlerror());
+    const bots_judge_engine* engine = entry();
+    if (engine == nullptr || engine->abi_version < 1 ||
+        engine->abi_version > BOTS_JUDGE_ENGINE_ABI_VERSION)
+        fatal("%s was built for engine ABI %u, the judge knows 1 to %u",
+              path.c_str(), engine ? engine->abi_version : 0,
+              BOTS_JUDGE_ENGINE_ABI_VERSION);
+    // dlopen() may have found the plugin anywhere on the library path.
+    Dl_info info;
+    if (dladdr(engine, &info) == 0 || info.dli_fname == nullptr)
+        fatal("Cannot tell where engine plugin %s was loaded from",
+              path.c_str());
+    Game game = {engine->name, info.dli_fname, engine->play_game};
+    // Version 1 descriptors end before play_game_async.
+    if (engine->abi_version >= 2)
+        game.play_game_async = engine->play_game_async;
+    return game;
+}
+
+}  // namespace Judge
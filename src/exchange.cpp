@@ -0,0 +1,169 @@
+#include "exchange.h"
+#include "monotonic.h"
+
+#include <poll.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace Engine {
+
+std::string Reply::describe() const {
+    std::string result = "EOF";
+    if (errnum != 0) {
+        result += ": ";
+        result += strerror(errnum);
+    }
+    return result;
+}
+
+// Moves a pending reply on after `status` was returned for it. Returns true
+// if the reply is final.
+static bool settle(Reply& reply,
+                   playerbuf::line_status status,
+                   PlayerData& player) {
+    const playerbuf& pbuf = player.playerStream().get_playerbuf();
+    switch (status) {
+        case playerbuf::line_status::complete:
+            reply.think_us = pbuf.get_think_time_us();
+            if (!player.timeBudget().stopMove()) {
+                player.playerStream().get_playerbuf().record_timeout();
+                reply.status = Reply::Timeout;
+                reply.errnum = ETIME;
+                return true;
+            }
+            reply.status = Reply::Ok;
+            reply.errnum = 0;
+            return true;
+        case playerbuf::line_status::eof:
+            reply.status = Reply::Eof;
+            reply.errnum = 0;
+            return true;
+        case playerbuf::line_status::error:
+            reply.status = Reply::Error;
+            reply.errnum = pbuf.get_last_error();
+            return true;
+        case playerbuf::line_status::pending:
+            break;
+    }
+    if (reply.line.size() > MAX_REPLY_LINE) {
+        reply.status = Reply::Error;
+        reply.errnum = EMSGSIZE;
+        return true;
+    }
+    return false;
+}
+
+ExchangeRound::ExchangeRound(const std::vector<PlayerData*>& p_players,
+                             const std::string& message,
+                             int timeout_ms)
+    : players(p_players),
+      request(message + '\n'),
+      sent(players.size(), 0),
+      replies(players.size(), {Reply::Timeout, "", ETIME}),
+      deadline(Monotonic::after_ms(timeout_ms)) {
+    for (size_t i = 0; i < players.size(); i++) {
+        if (!advance(i, false))
+            pending.push_back(i);
+    }
+}
+
+// Sends what the output of player `i` takes of the rest of its message,
+// then reads what has arrived of its reply, from the input fd only if
+// `may_read`. Returns true if the reply is final.
+bool ExchangeRound::advance(size_t i, bool may_read) {
+    PlayerData& player = *players[i];
+    playerbuf& pbuf = player.playerStream().get_playerbuf();
+    if (isSending(i)) {
+        size_t written;
+        playerbuf::write_status status = pbuf.write_nonblocking(
+            request.data() + sent[i], request.size() - sent[i], written);
+        sent[i] += written;
+        if (status == playerbuf::write_status::error) {
+            int errnum = pbuf.get_last_error();
+            replies[i] = {errnum == EPIPE ? Reply::Eof : Reply::Error, "",
+                          errnum};
+            return true;
+        }
+        if (status == playerbuf::write_status::pending)
+            return false;
+        player.timeBudget().startMove();
+    }
+    return settle(replies[i], pbuf.read_line_nonblocking(replies[i].line,
+                                                         may_read),
+                  player);
+}
+
+pollfd ExchangeRound::getWaitFor(size_t i) const {
+    const playerbuf& pbuf = players[i]->playerStream().get_playerbuf();
+    if (isSending(i))
+        return pbuf.get_output_pollfd();
+    return {pbuf.get_input_fd(), POLLIN, 0};
+}
+
+void ExchangeRound::ready(size_t i) {
+    // The input fd may block; it is known readable only if it was waited
+    // for.
+    if (advance(i, !isSending(i)))
+        pending.erase(std::find(pending.begin(), pending.end(), i));
+}
+
+void ExchangeRound::fail(int errnum) {
+    for (size_t i : pending)
+        replies[i] = {Reply::Error, replies[i].line, errnum};
+    pending.clear();
+}
+
+std::vector<Reply> ExchangeRound::finish() {
+    for (size_t i : pending) {
+        if (replies[i].status == Reply::Timeout)
+            players[i]->playerStream().get_playerbuf().record_timeout();
+    }
+    pending.clear();
+    return std::move(replies);
+}
+
+std::vector<Reply> exchange(const std::vector<PlayerData*>& players,
+                            const std::string& message,
+                            int timeout_ms) {
+    ExchangeRound round(players, message, timeout_ms);
+    std::vector<pollfd> fds;
+    std::vector<size_t> ready;
+    while (!round.getPending().empty()) {
+        fds.clear();
+        for (size_t i : round.getPending())
+            fds.push_back(round.getWaitFor(i));
+        timespec left = Monotonic::time_left(round.getDeadline());
+        int rv = ppoll(fds.data(), fds.size(), &left, nullptr);
+        if (rv == 0)
+            break;
+        if (rv == -1) {
+            if (errno == EINTR)
+                continue;
+            round.fail(errno);
+            break;
+        }
+
+        ready.clear();
+        for (size_t k = 0; k < fds.size(); k++) {
+            if (fds[k].revents != 0)
+                ready.push_back(round.getPending()[k]);
+        }
+        for (size_t i : ready)
+            round.ready(i);
+    }
+    return round.finish();
+}
+
+std::vector<Reply> exchange(std::vector<PlayerData>& players,
+                            const std::string& message,
+                            int timeout_ms) {
+    std::vector<PlayerData*> player_ptrs;
+    player_ptrs.reserve(players.size());
+    for (auto& player : players)
+        player_ptrs.push_back(&player);
+    return exchange(player_ptrs, message, timeout_ms);
+}
+
+}  // namespace Engine
@@ -5,64 +5,97 @@
  *
  */
 
+#include "botpool.h"
+#include "coengine.h"
 #include "common.h"
+#include "coordinator.h"
 #include "engine.h"
+#include "engineplugin.h"
 #include "err.h"
+#include "latency.h"
+#include "launcher.h"
+#include "matchlog.h"
+#include "matchpool.h"
+#include "monotonic.h"
+#include "resultcache.h"
+#include "resultsink.h"
+#include "sprt.h"
+#include "topology.h"
+#include "tournament.h"
+#include "transcript.h"
 
 #include <fcntl.h>
+#include <getopt.h>
 #include <memory.h>
-#include <signal.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <cstdint>
 #include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using Engine::GameResult;
-using Engine::play_game;
 using Engine::PlayerData;
-using std::cerr;
+using Judge::BotPool;
+using Judge::BotProcess;
+using Judge::Crosstable;
+using Judge::MatchLog;
+using Judge::MatchLogEntry;
+using Judge::MatchLogReader;
+using Judge::MatchPool;
+using Judge::Pairing;
+using Judge::ResultSink;
+using Judge::TranscriptRecorder;
 using std::cout;
 using std::endl;
 using std::ostringstream;
 using std::string;
 using std::vector;
 
+namespace Engine {
+// The engine linked into the judge, if any; judges without one play the
+// games of engine plugins (--engine).
+GameResult play_game(std::vector<PlayerData>& players) noexcept
+    __attribute__((weak));
+Task<GameResult> play_game_async(std::vector<PlayerData>& players)
+    __attribute__((weak));
+}  // namespace Engine
+
 constexpr int NUM_PROGRAMS = 2;
 
 const char* LOG_FOLDER = "logs/";
+const char* DEFAULT_MATCH_LOG = "logs/matches.log";
 
-static void command(const char* cmd) {
-    int retcode = system(cmd);
-    if (retcode != 0) {
-        fprintf(stderr, "command '%s' failed", cmd);
-        exit(retcode);
-    }
-}
-
-static void remove_folder(const char* path) {
-    ostringstream cmd;
-    cmd << "rm -r " << path;
-    command(cmd.str().c_str());
-}
-
-static void make_folder(const char* path) {
-    ostringstream cmd;
-    cmd << "mkdir -p " << path;
-    command(cmd.str().c_str());
-}
+// Serializes console output of concurrently running matches.
+static std::mutex output_mutex;
 
-static string get_battle_folder_path(int battle_id) {
-    ostringstream folder;
-    folder << LOG_FOLDER << battle_id << '/';
-    return folder.str();
-}
+// How long every program took to answer over the whole run, and how long
+// the games took in wall-clock time.
+struct RunStats {
+    std::mutex mutex;
+    std::map<string, latency_histogram> response_times;
+    long long game_us = 0;
+    int games = 0;
+    int cached_games = 0;
+};
+static RunStats run_stats;
 
 static string get_filename(const string& path) {
     size_t startPos = path.find_last_of('/');
@@ -73,94 +106,579 @@ static string get_filename(const string& path) {
     return path.substr(startPos);
 }
 
-static string get_battle_stderr_path(int battle_id,
-                                     int program_id,
-                                     const string& process_name) {
-    ostringstream path;
-    path << get_battle_folder_path(battle_id) << program_id << "."
-         << get_filename(process_name) << ".err";
-    return path.str();
+// The most a bot's stderr file holds; it takes no memory until written.
+constexpr off_t MAX_STDERR_BYTES = 1 << 20;
+
+// Bot stderr is collected in an anonymous in-memory file and moved into the
+// match log when the match is over. The file is sealed at its full size, so
+// however much a bot writes it keeps at most MAX_STDERR_BYTES: the bot and
+// the engine write from its start, and writes past its end fail. What was
+// written ends at the file offset they share with the judge.
+static int make_stderr_file(const string& program) {
+    int err_file;
+    string name = "stderr:" + get_filename(program);
+    SYSCALL_WITH_CHECK(err_file = memfd_create(
+                           name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    SYSCALL_WITH_CHECK(ftruncate(err_file, MAX_STDERR_BYTES));
+    SYSCALL_WITH_CHECK(fcntl(err_file, F_ADD_SEALS,
+                             F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL));
+    return err_file;
 }
 
-static void make_battle_folder(int battle_id) {
-    make_folder(get_battle_folder_path(battle_id).c_str());
+enum class TournamentType { None, RoundRobin, Swiss };
+
+struct Options {
+    int jobs = 1;
+    size_t concurrency = 1;  // matches in flight per job
+    int matches = 10;  // the most matches with --sprt or --ci-width
+    bool matches_given = false;
+    std::optional<Judge::Sprt> sprt;
+    double ci_width = 0;  // 0 unless stopping at a confidence interval
+    TournamentType tournament = TournamentType::None;
+    int rounds = 0;
+    int write_timeout_ms = 1000;
+    bool reuse_bots = false;
+    int reset_timeout_ms = 1000;
+    string match_log_path = DEFAULT_MATCH_LOG;
+    int time_budget_ms = 0;  // 0 if bots are not on a clock
+    int time_increment_ms = 0;
+    bool pin = false;
+    bool shm_transport = false;
+    string results_path;  // empty if no results file is written
+    uint64_t seed = 0;
+    bool seed_given = false;
+    bool record_transcripts = false;
+    string replay_path;  // empty unless replaying a match log
+    vector<string> engine_paths;
+    string cache_path;  // empty unless results are cached
+    string coordinator_address;  // empty unless handing matches out
+    int match_timeout_ms = 0;  // 0 if derived from the time budget
+    string worker_address;  // empty unless playing a coordinator's matches
+    vector<string> programs;
+};
+
+// Not null when bots are kept alive between matches (--reuse-bots).
+static std::unique_ptr<BotPool> bot_pool;
+
+static std::unique_ptr<MatchLog> match_log;
+
+// The games matches are played of: the engine linked into the judge, or
+// the plugins given with --engine.
+static vector<Judge::Game> engines;
+
+// Not null when results are written (--results).
+static std::unique_ptr<ResultSink> result_sink;
+
+// Not null when results are cached between runs (--cache).
+static std::unique_ptr<Judge::ResultCache> result_cache;
+
+// Not null when workers play the matches (--coordinator).
+static std::unique_ptr<Judge::Coordinator> coordinator;
+
+// Hashes of the bot and engine files, computed once per run: the files
+// are not expected to change while the judge runs.
+static std::map<string, Judge::ContentHash> file_hashes;
+static std::mutex file_hashes_mutex;
+
+// One slot per worker when bots are pinned to dedicated cores (--pin).
+static vector<Judge::MatchSlot> match_slots;
+
+// The seed of the bot in `seat` of the `round`th match of `programs` at
+// `game`, whatever their seats, derived from the run seed so that a run can
+// be repeated with --seed. Matches keep their seeds, and so their cached
+// results, when bots are added to a run or the order of the bots changes.
+static unsigned bot_seed(uint64_t run_seed,
+                         const string& game,
+                         vector<string> programs,
+                         int round,
+                         int seat) {
+    std::sort(programs.begin(), programs.end());
+    Judge::ContentHasher hasher;
+    hasher.update(run_seed);
+    for (const string& name : programs) {
+        hasher.update(static_cast<uint64_t>(name.size()));
+        hasher.update(name);
+    }
+    hasher.update(static_cast<uint64_t>(game.size()));
+    hasher.update(game);
+    hasher.update(static_cast<uint64_t>(round));
+    hasher.update(static_cast<uint64_t>(seat));
+    return static_cast<unsigned>(hasher.digest().low);
+}
+
+static const char* result_type_name(GameResult::ResultType type) {
+    switch (type) {
+        case GameResult::Win:
+            return "win";
+        case GameResult::Draw:
+            return "draw";
+        case GameResult::EngineError:
+            return "error";
+    }
+    return "error";
+}
+
+// A match from the start of its bots until its result is archived.
+struct Match {
+    const Judge::Game* game;
+    vector<string> programs;
+    int battle_id;
+    int worker_id;
+    vector<unsigned> seeds;
+    vector<std::unique_ptr<BotProcess>> bots;
+    vector<PlayerData> players;
+    vector<std::shared_ptr<TranscriptRecorder>> transcripts;
+    timespec game_start;
+    // Set if the result cache is used and the match can be cached.
+    std::optional<Judge::ContentHash> cache_key;
+    // Set if the result came from the cache, and no bot was started.
+    std::optional<Judge::CachedResult> cached;
+    // Set if a worker of the coordinator played the match.
+    string worker;
+    long long remote_game_us = 0;
+};
+
+static Judge::ContentHash file_hash(const string& path) {
+    std::lock_guard<std::mutex> lock(file_hashes_mutex);
+    auto it = file_hashes.find(path);
+    if (it == file_hashes.end())
+        it = file_hashes.emplace(path, Judge::hash_file(path)).first;
+    return it->second;
+}
+
+// Everything that decides the result of a match: the game and the file of
+// its engine, the files of the bots and their seeds in seat order, and the
+// settings that reach the game. Empty if a bot's program cannot be found,
+// which leaves the match out of the cache.
+static std::optional<Judge::ContentHash> match_cache_key(
+    const Options& options,
+    const Judge::Game& game,
+    const vector<string>& programs,
+    const vector<unsigned>& seeds) {
+    Judge::ContentHasher hasher;
+    hasher.update(std::string_view("bots-judge match 1"));
+    hasher.update(std::string_view(game.name));
+    Judge::ContentHash engine = file_hash(game.binary);
+    hasher.update(engine.high);
+    hasher.update(engine.low);
+    for (size_t i = 0; i < programs.size(); i++) {
+        string binary = Judge::find_program(programs[i]);
+        if (binary.empty())
+            return std::nullopt;
+        Judge::ContentHash bot = file_hash(binary);
+        hasher.update(bot.high);
+        hasher.update(bot.low);
+        hasher.update(static_cast<uint64_t>(seeds[i]));
+    }
+    for (int setting :
+         {options.write_timeout_ms, options.time_budget_ms,
+          options.time_increment_ms, static_cast<int>(options.shm_transport),
+          static_cast<int>(options.reuse_bots)})
+        hasher.update(static_cast<uint64_t>(setting));
+    return hasher.digest();
 }
 
-static vector<double> play_match(vector<string> programs, int battle_id) {
+// Starts the bots of a match and connects them to its players, unless the
+// result cache has the match's result.
+static std::shared_ptr<Match> start_match(const Options& options,
+                                          const Judge::Game& game,
+                                          vector<string> programs,
+                                          int battle_id,
+                                          int round,
+                                          int worker_id) {
     assert(programs.size() == NUM_PROGRAMS);
-    make_battle_folder(battle_id);
-    int read_pipes[NUM_PROGRAMS][2];
-    int write_pipes[NUM_PROGRAMS][2];
-    int err_files[NUM_PROGRAMS];
-    vector<pid_t> children_pids;
+    auto match = std::make_shared<Match>();
+    match->game = &game;
+    match->battle_id = battle_id;
+    match->worker_id = worker_id;
+    for (int i = 0; i < NUM_PROGRAMS; i++)
+        match->seeds.push_back(
+            bot_seed(options.seed, game.name, programs, round, i));
+    if (result_cache) {
+        match->cache_key =
+            match_cache_key(options, game, programs, match->seeds);
+        if (match->cache_key)
+            match->cached = result_cache->find(*match->cache_key);
+        if (match->cached) {
+            match->programs = std::move(programs);
+            return match;
+        }
+    }
+    vector<std::unique_ptr<BotProcess>>& bots = match->bots;
+    const Judge::MatchSlot* slot =
+        match_slots.empty() ? nullptr : &match_slots[worker_id];
 
     for (int i = 0; i < NUM_PROGRAMS; i++) {
-        SYSCALL_WITH_CHECK(pipe(read_pipes[i]));
-        SYSCALL_WITH_CHECK(pipe(write_pipes[i]));
-        string err_file_path =
-            get_battle_stderr_path(battle_id, i, programs[i]);
-        cerr << "Creating error file " << err_file_path << endl;
-        SYSCALL_WITH_CHECK(err_files[i] =
-                               open(err_file_path.c_str(),
-                                    O_WRONLY | O_CREAT | O_APPEND, 0640));
-
-        pid_t child_pid;
-        unsigned int seed_local = time(NULL);
-        unsigned seed = rand_r(&seed_local);
-        switch ((child_pid = fork())) {
-            case -1:
-                syserr("Error in fork\n");
-                exit(1);
-            case 0:
-                for (int j = 0; j <= i; j++) {
-                    SYSCALL_WITH_CHECK(close(read_pipes[j][PIPE_READ_END]));
-                    SYSCALL_WITH_CHECK(close(write_pipes[j][PIPE_WRITE_END]));
-                }
-                for (int j = 0; j <= i - 1; j++) {
-                    SYSCALL_WITH_CHECK(close(err_files[j]));
-                }
+        unsigned seed = match->seeds[i];
+        std::unique_ptr<BotProcess> bot;
+        if (bot_pool)
+            bot = bot_pool->acquire(programs[i], seed);
+        if (bot && slot) {
+            // A pooled bot may have played in another slot or seat.
+            Judge::pin_to_cpus(bot->process.pid, {slot->bot_cpus[i]});
+        } else if (!bot) {
+            // The bot inherits the mask of the thread that starts it.
+            if (slot)
+                Judge::pin_to_cpus(0, {slot->bot_cpus[i]});
+            bot = Judge::spawn_bot(programs[i], seed,
+                                   make_stderr_file(programs[i]),
+                                   options.shm_transport);
+        }
+        bots.push_back(std::move(bot));
+    }
+    if (slot)
+        Judge::pin_to_cpus(0, slot->judge_cpus);
 
-                SYSCALL_WITH_CHECK(close(fileno(stdin)));
-                SYSCALL_WITH_CHECK(dup(write_pipes[i][PIPE_READ_END]));
+    vector<PlayerData>& players = match->players;
+    for (int i = 0; i < NUM_PROGRAMS; i++) {
+        if (bots[i]->transport)
+            players.emplace_back(bots[i]->transport, bots[i]->err_fd,
+                                 programs[i], i);
+        else
+            players.emplace_back(bots[i]->read_fd, bots[i]->write_fd,
+                                 bots[i]->err_fd, programs[i], i);
+        players.back().playerStream().set_write_timeout_ms(
+            options.write_timeout_ms);
+        if (options.time_budget_ms > 0)
+            players.back().setTimeBudget(
+                Engine::TimeBudget(bots[i]->process.pid, options.time_budget_ms,
+                                   options.time_increment_ms));
+        if (options.record_transcripts) {
+            match->transcripts.push_back(
+                std::make_shared<TranscriptRecorder>());
+            players.back().playerStream().get_playerbuf().set_recorder(
+                match->transcripts.back());
+        }
+    }
+    match->programs = std::move(programs);
+    match->game_start = Monotonic::now();
+    return match;
+}
 
-                SYSCALL_WITH_CHECK(close(fileno(stdout)));
-                SYSCALL_WITH_CHECK(dup(read_pipes[i][PIPE_WRITE_END]));
+// Moves what the bot wrote to stderr since the last time into the match
+// log. A pooled bot may be writing still; the rest goes with its next
+// match.
+static void archive_stderr(int battle_id, int player, BotProcess& bot) {
+    off_t end;
+    SYSCALL_WITH_CHECK(end = lseek(bot.err_fd, 0, SEEK_CUR));
+    match_log->appendFile(battle_id, player, MatchLogEntry::Stderr,
+                          bot.err_fd, bot.err_logged, end);
+    bot.err_logged = end;
+}
 
-                SYSCALL_WITH_CHECK(close(fileno(stderr)));
-                SYSCALL_WITH_CHECK(dup(err_files[i]));
+// Archives the result of a match once its game is over and stops or
+// releases its bots. Returns how long the game took.
+static long long finish_match(Match& match, const GameResult& result) {
+    long long game_us =
+        match.cached ? match.cached->game_us
+        : !match.worker.empty()
+            ? match.remote_game_us
+            : Monotonic::elapsed_us(match.game_start, Monotonic::now());
+    const Judge::Game& game = *match.game;
+    const vector<string>& programs = match.programs;
+    const int battle_id = match.battle_id;
+    {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        if (engines.size() > 1)
+            cout << "[" << game.name << "] ";
+        cout << result.pretty_result << endl;
+    }
+    match.players.clear();
+
+    ostringstream metadata;
+    metadata << "battle " << battle_id << endl;
+    metadata << "game: " << game.name << endl;
+    for (int i = 0; i < NUM_PROGRAMS; i++)
+        metadata << "player " << i << ": " << programs[i] << endl;
+    metadata << "result: " << result.pretty_result << endl;
+    metadata << "game_us: " << game_us << endl;
+    if (match.cached)
+        metadata << "cached: " << match.cache_key->hex() << endl;
+    if (!match.worker.empty())
+        metadata << "worker: " << match.worker << endl;
+    for (size_t i = 0; i < result.player_latencies.size(); i++)
+        metadata << "player " << i << " response times: "
+                 << result.player_latencies[i].summary() << endl;
+    match_log->append(battle_id, -1, MatchLogEntry::Metadata,
+                      metadata.str().data(), metadata.str().size());
+    for (size_t i = 0; i < match.transcripts.size(); i++)
+        match_log->append(battle_id, i, MatchLogEntry::Transcript,
+                          match.transcripts[i]->data().data(),
+                          match.transcripts[i]->data().size());
+    {
+        std::lock_guard<std::mutex> lock(run_stats.mutex);
+        for (size_t i = 0; i < result.player_latencies.size(); i++)
+            run_stats.response_times[programs[i]].merge(
+                result.player_latencies[i]);
+        if (match.cached) {
+            run_stats.cached_games++;
+        } else {
+            run_stats.game_us += game_us;
+            run_stats.games++;
+        }
+    }
+    // Engine errors may come from the machine rather than the bots, so
+    // they are played again next time.
+    if (result_cache && match.cache_key && !match.cached &&
+        result.type != GameResult::EngineError)
+        result_cache->insert(*match.cache_key, result, game_us);
+    if (result_sink) {
+        Judge::MatchRecord record;
+        record.match_id = battle_id;
+        record.game = game.name;
+        record.bots = programs;
+        record.seeds = match.seeds;
+        record.scores = result.player_scores;
+        record.result = result_type_name(result.type);
+        record.duration_us = game_us;
+        record.details = result.pretty_result;
+        result_sink->append(match.worker_id, record);
+    }
 
-                execlp(programs[i].c_str(), programs[i].c_str(),
-                       std::to_string(seed).c_str(), nullptr);
+    for (size_t i = 0; i < match.bots.size(); i++) {
+        BotProcess& bot = *match.bots[i];
+        if (bot_pool) {
+            archive_stderr(battle_id, i, bot);
+            // Its stderr file fills up over its matches; replaced, the
+            // bot starts over with a fresh one.
+            if (bot.err_logged <= MAX_STDERR_BYTES / 2)
+                bot_pool->release(std::move(match.bots[i]));
+            else
+                terminate_bot(bot);
+        } else {
+            // Let the bot finish writing before its stderr is archived.
+            Judge::kill_child(bot.process);
+            Judge::reap_child(bot.process);
+            archive_stderr(battle_id, i, bot);
+            terminate_bot(bot);
+        }
+    }
 
-                syserr("Cannot use/find the program binary on $PATH: %s\n",
-                       programs[i].c_str());
+    return game_us;
+}
 
-                exit(1);
+// Stops the bots of a match that was cancelled before its game was over and
+// archives their stderr. The match has no result.
+static void cancel_match(Match& match) {
+    match.players.clear();
+    const string metadata = "battle " + std::to_string(match.battle_id) +
+                            "\ngame: " + match.game->name +
+                            "\nresult: cancelled\n";
+    match_log->append(match.battle_id, -1, MatchLogEntry::Metadata,
+                      metadata.data(), metadata.size());
+    for (size_t i = 0; i < match.bots.size(); i++) {
+        BotProcess& bot = *match.bots[i];
+        Judge::kill_child(bot.process);
+        Judge::reap_child(bot.process);
+        archive_stderr(match.battle_id, i, bot);
+        terminate_bot(bot);
+    }
+}
 
-            default:
-                children_pids.push_back(child_pid);
-                SYSCALL_WITH_CHECK(close(write_pipes[i][PIPE_READ_END]));
-                SYSCALL_WITH_CHECK(close(read_pipes[i][PIPE_WRITE_END]));
+// The matches of a play_matches() call that are being played. Once it is
+// stopped no more matches start, and the bots of those in flight are
+// killed, so that their games end at once and can be cancelled.
+class InFlightMatches {
+   public:
+    // Returns false, having killed the match's bots, if play has stopped.
+    bool add(Match* match) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (is_stopped) {
+            kill_bots(*match);
+            return false;
         }
+        matches.insert(match);
+        return true;
     }
 
-    vector<Engine::PlayerData> players;
-    for (int i = 0; i < NUM_PROGRAMS; i++) {
-        players.emplace_back(read_pipes[i][PIPE_READ_END],
-                             write_pipes[i][PIPE_WRITE_END], err_files[i],
-                             programs[i], i);
+    // Returns false if the match was cancelled while it was played.
+    bool remove(Match* match) {
+        std::lock_guard<std::mutex> lock(mutex);
+        matches.erase(match);
+        return !is_stopped;
+    }
+
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (is_stopped)
+            return;
+        is_stopped = true;
+        for (Match* match : matches)
+            kill_bots(*match);
     }
 
-    GameResult result = play_game(players);
-    cout << result.pretty_result << endl;
+    bool stopped() const { return is_stopped; }
+
+   private:
+    static void kill_bots(Match& match) {
+        for (const std::unique_ptr<BotProcess>& bot : match.bots)
+            Judge::kill_child(bot->process);
+    }
+
+    std::mutex mutex;
+    std::set<Match*> matches;
+    std::atomic<bool> is_stopped = false;
+};
+
+// What job `job_id` of play_matches() plays.
+struct MatchSpec {
+    const Judge::Game* game;
+    vector<string> programs;
+    int battle_id;
+    int round;  // among the matches of its bots at its game
+    int job_id = 0;  // set by play_matches()
+};
+using match_spec_fun_t = std::function<MatchSpec(int job_id)>;
+// The next match to play. Nothing if there is none, for good if `wait`
+// and maybe only for now otherwise. Called from every worker.
+using match_source_fun_t = std::function<std::optional<MatchSpec>(bool wait)>;
+// Returns false once no more matches are needed.
+using match_done_fun_t = std::function<
+    bool(int job_id, const GameResult& result, long long game_us)>;
 
-    for (pid_t child_pid : children_pids)
-        SYSCALL_WITH_CHECK(kill(child_pid, SIGKILL));
+// Plays the matches `next` gives on `options.jobs` worker threads and
+// reports their results to `done`, from the worker that played them. Once
+// `done` returns false the remaining matches are skipped and those in
+// flight cancelled. With --concurrency every worker runs a reactor that
+// keeps that many coroutine matches in flight at once.
+static void play_matches_from(const Options& options,
+                              const match_source_fun_t& next,
+                              const match_done_fun_t& done) {
+    MatchPool pool(options.jobs);
+    InFlightMatches in_flight;
+    auto report = [&](int job_id, Match& match, const GameResult& result) {
+        if (!in_flight.remove(&match))
+            cancel_match(match);
+        else if (!done(job_id, result, finish_match(match, result)))
+            in_flight.stop();
+    };
+    if (options.concurrency == 1) {
+        pool.run(pool.getWorkers(), [&](int, int worker_id) {
+            while (!in_flight.stopped()) {
+                std::optional<MatchSpec> match_spec = next(true);
+                if (!match_spec)
+                    break;
+                std::shared_ptr<Match> match =
+                    start_match(options, *match_spec->game,
+                                std::move(match_spec->programs),
+                                match_spec->battle_id, match_spec->round,
+                                worker_id);
+                if (match->cached) {
+                    report(match_spec->job_id, *match, match->cached->result);
+                    continue;
+                }
+                if (!in_flight.add(match.get())) {
+                    cancel_match(*match);
+                    continue;
+                }
+                report(match_spec->job_id, *match,
+                       match_spec->game->play_game(match->players));
+            }
+        });
+    } else {
+        // Every job of the pool is a reactor, which takes matches until
+        // none are left.
+        pool.run(pool.getWorkers(), [&](int, int worker_id) {
+            Engine::Reactor reactor;
+            while (true) {
+                while (reactor.tasks() < options.concurrency &&
+                       !in_flight.stopped()) {
+                    // With no match in flight there is nothing to do but
+                    // wait for the next one.
+                    std::optional<MatchSpec> match_spec =
+                        next(reactor.tasks() == 0);
+                    if (!match_spec)
+                        break;
+                    int job_id = match_spec->job_id;
+                    std::shared_ptr<Match> match =
+                        start_match(options, *match_spec->game,
+                                    std::move(match_spec->programs),
+                                    match_spec->battle_id, match_spec->round,
+                                    worker_id);
+                    if (match->cached) {
+                        report(job_id, *match, match->cached->result);
+                        continue;
+                    }
+                    if (!in_flight.add(match.get())) {
+                        cancel_match(*match);
+                        continue;
+                    }
+                    reactor.spawn<GameResult>(
+                        match_spec->game->play_game_async(match->players),
+                        [&report, match, job_id](GameResult result) {
+                            report(job_id, *match, result);
+                        });
+                }
+                if (reactor.tasks() == 0)
+                    break;
+                reactor.runOnce();
+            }
+        });
+    }
+    if (result_sink)
+        result_sink->flush();
+}
 
-    for (size_t i = 0; i < children_pids.size(); i++)
-        wait(nullptr);
+// Hands the matches out to the coordinator's workers and archives the
+// results they send back as if they had been played here.
+static void coordinate_matches(const Options& options,
+                               int count,
+                               const match_spec_fun_t& spec,
+                               const match_done_fun_t& done) {
+    vector<MatchSpec> specs;
+    vector<Judge::RemoteMatch> remote_matches;
+    for (int job_id = 0; job_id < count; job_id++) {
+        specs.push_back(spec(job_id));
+        remote_matches.push_back({job_id, specs.back().battle_id,
+                                  specs.back().round,
+                                  specs.back().game->name,
+                                  specs.back().programs});
+    }
+    coordinator->run(remote_matches, [&](const Judge::RemoteMatch& remote,
+                                         const Judge::RemoteResult& reported,
+                                         const string& worker) {
+        const MatchSpec& match_spec = specs[remote.job_id];
+        Match match;
+        match.game = match_spec.game;
+        match.programs = match_spec.programs;
+        match.battle_id = match_spec.battle_id;
+        match.worker_id = 0;
+        for (int i = 0; i < NUM_PROGRAMS; i++)
+            match.seeds.push_back(
+                bot_seed(options.seed, match_spec.game->name,
+                         match_spec.programs, match_spec.round, i));
+        match.worker = worker;
+        match.remote_game_us = reported.game_us;
+        GameResult result = GameResult::createRecorded(
+            reported.type, reported.scores, reported.details);
+        return done(remote.job_id, result, finish_match(match, result));
+    });
+    if (result_sink)
+        result_sink->flush();
+}
 
-    return result.player_scores;
+// Plays `count` matches, `spec` telling what job `job_id` plays: here, or
+// on the workers of the coordinator (--coordinator).
+static void play_matches(const Options& options,
+                         int count,
+                         const match_spec_fun_t& spec,
+                         const match_done_fun_t& done) {
+    if (coordinator) {
+        coordinate_matches(options, count, spec, done);
+        return;
+    }
+    std::atomic<int> next_job = 0;
+    play_matches_from(
+        options,
+        [&](bool) -> std::optional<MatchSpec> {
+            int job_id = next_job++;
+            if (job_id >= count)
+                return std::nullopt;
+            MatchSpec match_spec = spec(job_id);
+            match_spec.job_id = job_id;
+            return match_spec;
+        },
+        done);
 }
 
 template <class T>
@@ -171,21 +689,743 @@ vector<T> operator+=(vector<T>& v1, const vector<T>& v2) {
     return v1;
 }
 
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "USAGE: %s [OPTIONS] <program1> <program2>\n"
+            "       %s --tournament round-robin|swiss [--rounds N] "
+            "[OPTIONS] <program1> <program2> ...\n"
+            "OPTIONS:\n"
+            "  --jobs N              matches played concurrently\n"
+            "  --matches N           matches per pairing (default 10), the "
+            "most with\n"
+            "                        --sprt or --ci-width (default 1000)\n"
+            "  --write-timeout MS    max time a bot may stall a write "
+            "(default 1000)\n"
+            "  --reuse-bots          keep bots alive between matches if "
+            "they answer NEWGAME\n"
+            "  --reset-timeout MS    max time for a NEWGAME/READY handshake "
+            "(default 1000)\n"
+            "  --log PATH            match log archive, indexed in PATH.idx "
+            "(default %s)\n"
+            "  --time-budget MS[+INC]\n"
+            "                        CPU time per bot and game, plus INC ms "
+            "per move\n"
+            "  --pin                 pin bots and judge threads to dedicated "
+            "cores\n"
+            "  --transport pipe|shm  talk to bots over pipes (default) or "
+            "shared memory\n"
+            "  --results PATH        append one record per match to PATH, "
+            "CSV if it\n"
+            "                        ends in .csv and JSON lines otherwise\n"
+            "  --seed N              run seed the bots' seeds are derived "
+            "from\n"
+            "  --transcripts         keep everything sent to and received "
+            "from the bots\n"
+            "                        in the match log\n"
+            "  --replay PATH         play the transcripts in the match log "
+            "PATH again\n"
+            "                        instead of running bots, and report "
+            "differences\n"
+            "  --engine PATH         play the game of the engine plugin PATH; "
+            "with several\n"
+            "                        plugins every pairing plays --matches "
+            "of each game\n"
+            "  --concurrency N       matches every job keeps in flight, for "
+            "engines with a\n"
+            "                        coroutine play_game_async (default 1); "
+            "not with --pin\n"
+            "  --sprt ELO0,ELO1[,ALPHA,BETA]\n"
+            "                        stop a head-to-head run once an SPRT "
+            "decides whether\n"
+            "                        Bot #0 is ELO0 or ELO1 Elo stronger, "
+            "wrongly\n"
+            "                        with chances ALPHA and BETA "
+            "(default 0.05)\n"
+            "  --ci-width W          stop a head-to-head run once the 95%% "
+            "confidence\n"
+            "                        interval of Bot #0's score is at most W "
+            "wide\n"
+            "  --cache PATH          reuse the results of matches played "
+            "before with the same\n"
+            "                        bots, engine, seeds and settings, "
+            "kept in PATH\n"
+            "  --coordinator ADDR    hand the matches out to workers that "
+            "connect to ADDR,\n"
+            "                        unix:PATH or [HOST]:PORT, instead of "
+            "playing them\n"
+            "  --match-timeout MS    give a worker's match to another worker "
+            "if it is not\n"
+            "                        reported within twice MS (default 10 "
+            "minutes, or\n"
+            "                        10 times both bots' --time-budget, at "
+            "least a minute)\n"
+            "  --worker ADDR         play the matches of the coordinator at "
+            "ADDR, with\n"
+            "                        the programs given as the only ones "
+            "it may run\n",
+            argv0, argv0, DEFAULT_MATCH_LOG);
+    exit(1);
+}
+
+static int parse_int_at_least(const char* str, long min, const char* argv0) {
+    char* end;
+    long value = strtol(str, &end, 10);
+    if (*str == '\0' || *end != '\0' || value < min || value > 1 << 20)
+        usage(argv0);
+    return static_cast<int>(value);
+}
+
+static int parse_positive_int(const char* str, const char* argv0) {
+    return parse_int_at_least(str, 1, argv0);
+}
+
+// A comma-separated list of numbers.
+static vector<double> parse_doubles(const char* str, const char* argv0) {
+    vector<double> values;
+    while (true) {
+        char* end;
+        values.push_back(strtod(str, &end));
+        if (end == str || !std::isfinite(values.back()))
+            usage(argv0);
+        if (*end == '\0')
+            return values;
+        if (*end != ',')
+            usage(argv0);
+        str = end + 1;
+    }
+}
+
+static Options parse_options(int argc, char* argv[]) {
+    Options options;
+    static const option long_options[] = {
+        {"jobs", required_argument, nullptr, 'j'},
+        {"matches", required_argument, nullptr, 'n'},
+        {"tournament", required_argument, nullptr, 't'},
+        {"rounds", required_argument, nullptr, 'r'},
+        {"write-timeout", required_argument, nullptr, 'w'},
+        {"reuse-bots", no_argument, nullptr, 'R'},
+        {"reset-timeout", required_argument, nullptr, 'T'},
+        {"log", required_argument, nullptr, 'l'},
+        {"time-budget", required_argument, nullptr, 'B'},
+        {"pin", no_argument, nullptr, 'P'},
+        {"transport", required_argument, nullptr, 'x'},
+        {"results", required_argument, nullptr, 'o'},
+        {"seed", required_argument, nullptr, 's'},
+        {"transcripts", no_argument, nullptr, 'X'},
+        {"replay", required_argument, nullptr, 'p'},
+        {"engine", required_argument, nullptr, 'e'},
+        {"concurrency", required_argument, nullptr, 'c'},
+        {"sprt", required_argument, nullptr, 'S'},
+        {"ci-width", required_argument, nullptr, 'W'},
+        {"cache", required_argument, nullptr, 'C'},
+        {"coordinator", required_argument, nullptr, 'D'},
+        {"worker", required_argument, nullptr, 'k'},
+        {"match-timeout", required_argument, nullptr, 'M'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv,
+                              "+j:n:t:r:w:RT:l:B:Px:o:s:Xp:e:c:S:W:C:D:k:M:",
+                              long_options, nullptr)) != -1) {
+        switch (opt) {
+            case 'j':
+                options.jobs = parse_positive_int(optarg, argv[0]);
+                break;
+            case 'n':
+                options.matches = parse_positive_int(optarg, argv[0]);
+                options.matches_given = true;
+                break;
+            case 't':
+                if (strcmp(optarg, "round-robin") == 0)
+                    options.tournament = TournamentType::RoundRobin;
+                else if (strcmp(optarg, "swiss") == 0)
+                    options.tournament = TournamentType::Swiss;
+                else
+                    usage(argv[0]);
+                break;
+            case 'r':
+                options.rounds = parse_positive_int(optarg, argv[0]);
+                break;
+            case 'w':
+                options.write_timeout_ms = parse_positive_int(optarg, argv[0]);
+                break;
+            case 'R':
+                options.reuse_bots = true;
+                break;
+            case 'T':
+                options.reset_timeout_ms = parse_positive_int(optarg, argv[0]);
+                break;
+            case 'l':
+                options.match_log_path = optarg;
+                break;
+            case 'B': {
+                string budget = optarg;
+                size_t plus = budget.find('+');
+                options.time_budget_ms =
+                    parse_positive_int(budget.substr(0, plus).c_str(), argv[0]);
+                if (plus != string::npos)
+                    options.time_increment_ms = parse_int_at_least(
+                        budget.substr(plus + 1).c_str(), 0, argv[0]);
+                break;
+            }
+            case 'P':
+                options.pin = true;
+                break;
+            case 'x':
+                if (strcmp(optarg, "shm") == 0)
+                    options.shm_transport = true;
+                else if (strcmp(optarg, "pipe") != 0)
+                    usage(argv[0]);
+                break;
+            case 'o':
+                options.results_path = optarg;
+                break;
+            case 's': {
+                char* end;
+                errno = 0;
+                options.seed = strtoull(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || errno != 0)
+                    usage(argv[0]);
+                options.seed_given = true;
+                break;
+            }
+            case 'X':
+                options.record_transcripts = true;
+                break;
+            case 'p':
+                options.replay_path = optarg;
+                break;
+            case 'e':
+                options.engine_paths.push_back(optarg);
+                break;
+            case 'c':
+                options.concurrency = parse_positive_int(optarg, argv[0]);
+                break;
+            case 'S': {
+                vector<double> values = parse_doubles(optarg, argv[0]);
+                if (values.size() == 2)
+                    values.insert(values.end(), {0.05, 0.05});
+                if (values.size() != 4 || values[0] >= values[1])
+                    usage(argv[0]);
+                for (double error : {values[2], values[3]}) {
+                    if (!(error > 0 && error < 0.5))
+                        usage(argv[0]);
+                }
+                options.sprt.emplace(values[0], values[1], values[2],
+                                     values[3]);
+                break;
+            }
+            case 'C':
+                options.cache_path = optarg;
+                break;
+            case 'D':
+                options.coordinator_address = optarg;
+                break;
+            case 'k':
+                options.worker_address = optarg;
+                break;
+            case 'M':
+                options.match_timeout_ms = parse_positive_int(optarg, argv[0]);
+                break;
+            case 'W': {
+                vector<double> values = parse_doubles(optarg, argv[0]);
+                if (values.size() != 1 || !(values[0] > 0))
+                    usage(argv[0]);
+                options.ci_width = values[0];
+                break;
+            }
+            default:
+                usage(argv[0]);
+        }
+    }
+    options.programs.assign(argv + optind, argv + argc);
+    // A slot isolates one match, and all matches of a job would share it.
+    if (options.pin && options.concurrency > 1)
+        usage(argv[0]);
+    bool adaptive = options.sprt || options.ci_width > 0;
+    if (!options.worker_address.empty()) {
+        // The coordinator decides what a worker plays, of the programs
+        // given here.
+        if (options.programs.empty() || !options.replay_path.empty() ||
+            !options.coordinator_address.empty() ||
+            options.tournament != TournamentType::None || adaptive)
+            usage(argv[0]);
+        return options;
+    }
+    if (!options.replay_path.empty()) {
+        if (!options.programs.empty())
+            usage(argv[0]);
+        return options;
+    }
+    if (options.tournament == TournamentType::None
+            ? options.programs.size() != NUM_PROGRAMS
+            : options.programs.size() < NUM_PROGRAMS)
+        usage(argv[0]);
+    if (adaptive && options.tournament != TournamentType::None)
+        usage(argv[0]);
+    if (adaptive && !options.matches_given)
+        options.matches = 1000;
+    if (options.match_timeout_ms == 0 && options.time_budget_ms > 0)
+        options.match_timeout_ms =
+            std::max(60 * 1000, 10 * NUM_PROGRAMS * options.time_budget_ms);
+    else if (options.match_timeout_ms == 0)
+        options.match_timeout_ms = 10 * 60 * 1000;
+    return options;
+}
+
+// Prints where the run stopped with --sprt or --ci-width, and why.
+static void print_stopping_rule(const Options& options,
+                                const Judge::ScoreStats& stats) {
+    cout << "Played " << stats.getMatches() << " of at most "
+         << options.matches * engines.size() << " matches" << endl;
+    if (stats.getMatches() == 0)
+        return;
+    double low = std::max(stats.mean() - stats.halfWidth(), 1e-6);
+    double high = std::min(stats.mean() + stats.halfWidth(), 1 - 1e-6);
+    std::ios_base::fmtflags flags = cout.flags();
+    cout << std::fixed << std::setprecision(3) << "Score of Bot #0: "
+         << stats.mean() << " +- " << stats.halfWidth() << " (95%), Elo "
+         << std::setprecision(1) << Judge::score_to_elo(stats.mean()) << " ["
+         << Judge::score_to_elo(low) << ", " << Judge::score_to_elo(high)
+         << "]" << endl;
+    if (options.sprt) {
+        const Judge::Sprt& sprt = *options.sprt;
+        cout << std::setprecision(2) << "SPRT: LLR " << sprt.llr(stats)
+             << " (" << sprt.getLowerBound() << ", " << sprt.getUpperBound()
+             << ") ";
+        switch (sprt.decide(stats)) {
+            case Judge::Sprt::Decision::AcceptH0:
+                cout << "H0 accepted: Elo <= " << sprt.getElo0() << endl;
+                break;
+            case Judge::Sprt::Decision::AcceptH1:
+                cout << "H1 accepted: Elo >= " << sprt.getElo1() << endl;
+                break;
+            case Judge::Sprt::Decision::Continue:
+                cout << "no decision" << endl;
+                break;
+        }
+    }
+    cout.flags(flags);
+}
+
+// Whether a run with --sprt or --ci-width has played enough matches:
+// either test may end it.
+static bool stopping_rule_met(const Options& options,
+                              const Judge::ScoreStats& stats) {
+    if (options.sprt &&
+        options.sprt->decide(stats) != Judge::Sprt::Decision::Continue)
+        return true;
+    return options.ci_width > 0 && 2 * stats.halfWidth() <= options.ci_width;
+}
+
+static void run_head_to_head(const Options& options) {
+    vector<double> match_scores(NUM_PROGRAMS);
+    Judge::ScoreStats stats;
+    std::mutex scores_mutex;
+    const int matches = options.matches;
+    const bool adaptive = options.sprt || options.ci_width > 0;
+    play_matches(
+        options, matches * engines.size(),
+        [&](int battle_id) {
+            // Stopping early needs every game to have been played about
+            // as often, so then the games take turns.
+            int game = adaptive ? battle_id % engines.size()
+                                : battle_id / matches;
+            int round = adaptive ? battle_id / engines.size()
+                                 : battle_id % matches;
+            return MatchSpec{&engines[game], options.programs, battle_id,
+                             round};
+        },
+        [&](int, const GameResult& result, long long) {
+            const vector<double>& scores = result.player_scores;
+            std::lock_guard<std::mutex> lock(scores_mutex);
+            match_scores += scores;
+            // Matches nobody scored in, i.e. engine errors, tell nothing
+            // about the bots.
+            double total = scores[0] + scores[1];
+            if (adaptive && total > 0)
+                stats.add(scores[0] / total);
+            return !adaptive || !stopping_rule_met(options, stats);
+        });
+    cout << "Final scores:" << endl;
+    for (int i = 0; i < NUM_PROGRAMS; i++)
+        cout << "Bot #" << i << "(" << options.programs[i]
+             << ") has total score " << match_scores[i] << endl;
+    if (adaptive)
+        print_stopping_rule(options, stats);
+}
+
+// Plays every pairing `options.matches` times per game, alternating the
+// seats, and records the results in the crosstable. Battle ids continue
+// from `next_battle_id`; `times_paired` counts how often every pair of
+// bots has been paired before, which their matches' rounds continue from.
+// Like the bots' seeds, the seats go by the bots' names, so that a match
+// is the same whatever the order of the bots.
+static void play_pairings(const Options& options,
+                          const vector<Pairing>& pairings,
+                          Crosstable& table,
+                          int& next_battle_id,
+                          std::map<std::pair<int, int>, int>& times_paired) {
+    const int first_battle_id = next_battle_id;
+    const int matches = options.matches;
+    const int per_pairing = matches * static_cast<int>(engines.size());
+    next_battle_id += static_cast<int>(pairings.size()) * per_pairing;
+    vector<int> first_rounds;
+    for (const Pairing& pairing : pairings) {
+        int& times = times_paired[std::minmax(pairing.first, pairing.second)];
+        first_rounds.push_back(times++ * matches);
+    }
+    auto round_of = [&](int job_id) {
+        return first_rounds[job_id / per_pairing] + job_id % matches;
+    };
+    auto seated_pairing = [&](int job_id) {
+        Pairing pairing = pairings[job_id / per_pairing];
+        if (options.programs[pairing.second] <
+            options.programs[pairing.first])
+            std::swap(pairing.first, pairing.second);
+        if (round_of(job_id) % 2 == 1)
+            std::swap(pairing.first, pairing.second);
+        return pairing;
+    };
+    play_matches(
+        options, pairings.size() * per_pairing,
+        [&](int job_id) {
+            Pairing pairing = seated_pairing(job_id);
+            return MatchSpec{&engines[job_id % per_pairing / matches],
+                             {options.programs[pairing.first],
+                              options.programs[pairing.second]},
+                             first_battle_id + job_id, round_of(job_id)};
+        },
+        [&](int job_id, const GameResult& result, long long) {
+            table.addResult(seated_pairing(job_id), result.player_scores);
+            return true;
+        });
+}
+
+static void run_tournament(const Options& options) {
+    const int bots = options.programs.size();
+    Crosstable table(bots);
+    int next_battle_id = 0;
+    std::map<std::pair<int, int>, int> times_paired;
+    if (options.tournament == TournamentType::RoundRobin) {
+        play_pairings(options, Judge::round_robin_pairings(bots), table,
+                      next_battle_id, times_paired);
+    } else {
+        int rounds = options.rounds;
+        if (rounds == 0)
+            rounds = std::max(1, static_cast<int>(std::ceil(std::log2(bots))));
+        Judge::SwissPairer pairer(bots);
+        for (int round = 0; round < rounds; round++) {
+            vector<Pairing> pairings = pairer.nextRound(table);
+            // A bye is worth a won pairing.
+            if (pairer.getBye() != -1)
+                table.addBye(pairer.getBye(),
+                             options.matches * engines.size());
+            play_pairings(options, pairings, table, next_battle_id,
+                          times_paired);
+        }
+    }
+    table.print(cout, options.programs);
+}
+
+// The loaded game called `name`, or null.
+static const Judge::Game* find_game(const string& name) {
+    for (const Judge::Game& game : engines) {
+        if (game.name == name)
+            return &game;
+    }
+    return nullptr;
+}
+
+// Why the worker does not play `match`, or empty if it does: it runs only
+// the programs it was given itself, and only games it has loaded, which
+// are all the coordinator should hand out.
+static string refusal(const Options& options, const Judge::RemoteMatch& match) {
+    if (find_game(match.game) == nullptr)
+        return "this worker has no game " + match.game;
+    for (const string& program : match.programs) {
+        if (std::find(options.programs.begin(), options.programs.end(),
+                      program) == options.programs.end())
+            return "this worker does not run " + program;
+    }
+    return "";
+}
+
+// The secret a coordinator and its workers share.
+static string auth_token() {
+    const char* token = getenv("BOTS_JUDGE_TOKEN");
+    return token != nullptr ? token : "";
+}
+
+// Plays the matches the coordinator at `options.worker_address` hands out
+// until it ends the run, and sends it the results.
+static void run_worker(const Options& options, Judge::WorkerClient& client) {
+    const int batch = options.jobs * static_cast<int>(options.concurrency);
+    play_matches_from(
+        options,
+        [&](bool wait) -> std::optional<MatchSpec> {
+            std::optional<Judge::RemoteMatch> remote =
+                client.next(batch, wait);
+            while (remote) {
+                string why = refusal(options, *remote);
+                if (why.empty())
+                    break;
+                fprintf(stderr, "WARNING: Refused a match: %s\n", why.c_str());
+                client.sendResult(
+                    {static_cast<uint64_t>(remote->job_id),
+                     GameResult::EngineError, 0,
+                     vector<double>(remote->programs.size(), 0.0),
+                     "Match aborted due to engine error: " + why});
+                remote = client.next(batch, wait);
+            }
+            if (!remote)
+                return std::nullopt;
+            return MatchSpec{find_game(remote->game),
+                             std::move(remote->programs),
+                             remote->battle_id, remote->round,
+                             remote->job_id};
+        },
+        [&](int ticket, const GameResult& result, long long game_us) {
+            client.sendResult({static_cast<uint64_t>(ticket), result.type,
+                               game_us, result.player_scores,
+                               result.pretty_result});
+            return true;
+        });
+}
+
+static void print_run_stats(const Options& options) {
+    const vector<string>& programs = options.programs;
+    if (!run_stats.response_times.empty())
+        cout << "Response times:" << endl;
+    for (size_t i = 0; i < programs.size(); i++) {
+        const string& program = programs[i];
+        auto it = run_stats.response_times.find(program);
+        bool seen = std::find(programs.begin(), programs.begin() + i,
+                              program) != programs.begin() + i;
+        if (it != run_stats.response_times.end() && !seen)
+            cout << "  " << program << ": " << it->second.summary() << endl;
+    }
+    if (run_stats.games > 0)
+        cout << "Games took " << run_stats.game_us / run_stats.games / 1000.0
+             << " ms on average" << endl;
+    if (result_cache)
+        cout << "Result cache: " << run_stats.cached_games << " of "
+             << run_stats.cached_games + run_stats.games
+             << " matches served, " << result_cache->size()
+             << " results kept" << endl;
+    if (coordinator && coordinator->getRequeued() > 0)
+        cout << "Workers lost " << coordinator->getRequeued()
+             << " matches, which were played again" << endl;
+}
+
+// The value of the "<key>: <value>" line of a match's metadata.
+static string metadata_value(std::string_view metadata, const string& key) {
+    const string prefix = key + ": ";
+    size_t begin = 0;
+    while (begin < metadata.size()) {
+        size_t end = metadata.find('\n', begin);
+        if (end == std::string_view::npos)
+            end = metadata.size();
+        std::string_view line = metadata.substr(begin, end - begin);
+        if (line.substr(0, prefix.size()) == prefix)
+            return string(line.substr(prefix.size()));
+        begin = end + 1;
+    }
+    return "";
+}
+
+// Plays every match of the match log at `options.replay_path` that has
+// transcripts again, with this build's engine and the recorded replies in
+// place of the bots. Returns the number of matches whose result, or the
+// requests the engine sent, differ from the recording.
+static int run_replay(const Options& options) {
+    MatchLogReader reader(options.replay_path);
+    struct RecordedMatch {
+        std::string_view metadata;
+        vector<std::string_view> transcripts;
+    };
+    std::map<uint32_t, RecordedMatch> matches;
+    for (const MatchLogEntry& entry : reader) {
+        if (!entry.written)
+            continue;
+        if (entry.kind == MatchLogEntry::Metadata) {
+            matches[entry.match_id].metadata = reader.view(entry);
+        } else if (entry.kind == MatchLogEntry::Transcript &&
+                   entry.player_id >= 0) {
+            auto& transcripts = matches[entry.match_id].transcripts;
+            if (transcripts.size() <= static_cast<size_t>(entry.player_id))
+                transcripts.resize(entry.player_id + 1);
+            transcripts[entry.player_id] = reader.view(entry);
+        }
+    }
+    vector<std::pair<uint32_t, const RecordedMatch*>> replays;
+    for (const auto& [match_id, match] : matches) {
+        if (!match.transcripts.empty())
+            replays.emplace_back(match_id, &match);
+    }
+
+    // Engines may log to the players' stderr; nobody reads it here.
+    int devnull;
+    SYSCALL_WITH_CHECK(devnull = open("/dev/null", O_WRONLY | O_CLOEXEC));
+    std::atomic<int> differences = 0;
+    MatchPool pool(options.jobs);
+    pool.run(static_cast<int>(replays.size()), [&](int job_id, int) {
+        const auto& [match_id, match] = replays[job_id];
+        // Matches are replayed with the game they were played with, or
+        // with the only one there is.
+        string game_name = metadata_value(match->metadata, "game");
+        const Judge::Game* game = &engines.front();
+        for (const Judge::Game& engine : engines) {
+            if (engine.name == game_name)
+                game = &engine;
+        }
+        if (engines.size() > 1 && game->name != game_name) {
+            differences++;
+            std::lock_guard<std::mutex> lock(output_mutex);
+            cout << "Match " << match_id << " differs: game \"" << game_name
+                 << "\" is not loaded" << endl;
+            return;
+        }
+        vector<std::shared_ptr<Judge::ReplayTransport>> transports;
+        vector<PlayerData> players;
+        for (size_t i = 0; i < match->transcripts.size(); i++) {
+            transports.push_back(std::make_shared<Judge::ReplayTransport>(
+                match->transcripts[i]));
+            players.emplace_back(
+                transports.back(), devnull,
+                metadata_value(match->metadata, "player " + std::to_string(i)),
+                i);
+        }
+        GameResult result = game->play_game(players);
+        players.clear();
+
+        ostringstream report;
+        string recorded = metadata_value(match->metadata, "result");
+        if (result.pretty_result != recorded)
+            report << "Match " << match_id << " differs: recorded \""
+                   << recorded << "\", replayed \"" << result.pretty_result
+                   << "\"" << endl;
+        for (size_t i = 0; i < transports.size(); i++) {
+            if (!transports[i]->outputComplete())
+                report << "Match " << match_id
+                       << " differs: the engine sent player #" << i
+                       << " other requests than recorded" << endl;
+        }
+        if (!report.str().empty()) {
+            differences++;
+            std::lock_guard<std::mutex> lock(output_mutex);
+            cout << report.str();
+        }
+    });
+    SYSCALL_WITH_CHECK(close(devnull));
+    cout << "Replayed " << replays.size() << " matches, " << differences
+         << " differ" << endl;
+    return differences;
+}
+
+// Plans one isolated slot per worker, running fewer matches at once if the
+// machine cannot isolate `options.jobs` of them.
+static void plan_pinning(Options& options) {
+    vector<Judge::MatchSlot> slots =
+        Judge::plan_match_slots(Judge::detect_cpu_cores(), NUM_PROGRAMS);
+    if (slots.empty()) {
+        fprintf(stderr,
+                "WARNING: Not enough cores to isolate a match; "
+                "running without --pin\n");
+        return;
+    }
+    if (static_cast<int>(slots.size()) < options.jobs) {
+        fprintf(stderr,
+                "WARNING: Only %zu matches can be isolated; "
+                "running %zu at once\n",
+                slots.size(), slots.size());
+        options.jobs = slots.size();
+    }
+    slots.resize(options.jobs);
+    match_slots = std::move(slots);
+}
+
 int main(int argc, char* argv[]) {
     srand(time(NULL));
-    if (argc != NUM_PROGRAMS + 1) {
-        fprintf(stderr, "USAGE: %s <program1> <program2>\n", argv[0]);
+    Options options = parse_options(argc, argv);
+    if (options.pin)
+        plan_pinning(options);
+
+    for (const string& path : options.engine_paths)
+        engines.push_back(Judge::load_engine_plugin(path));
+    if (engines.empty() && Engine::play_game != nullptr)
+        engines.push_back(
+            {"builtin", "/proc/self/exe", Engine::play_game,
+             Engine::play_game_async});
+    if (engines.empty()) {
+        fprintf(stderr, "ERROR: No engine is linked in; load one with "
+                        "--engine PATH\n");
         return 1;
     }
+    for (const Judge::Game& game : engines) {
+        if (options.concurrency > 1 && game.play_game_async == nullptr) {
+            fprintf(stderr,
+                    "ERROR: --concurrency needs engines with "
+                    "play_game_async, which %s has not\n",
+                    game.name.c_str());
+            return 1;
+        }
+    }
+
     playerstream_base::ignore_sigpipe();
-    remove_folder(LOG_FOLDER);
-    vector<double> match_scores(NUM_PROGRAMS);
-    const int reps = 10;
-    for (int i = 0; i < reps; i++)
-        match_scores += play_match({argv[1], argv[2]}, i);
-    cout << "Final scores:" << endl;
-    for (int i = 0; i < NUM_PROGRAMS; i++)
-        cout << "Bot #" << i << "(" << argv[i + 1] << ") has total score "
-             << match_scores[i] << endl;
+    if (!options.replay_path.empty())
+        return run_replay(options) == 0 ? 0 : 1;
+    if (options.match_log_path == DEFAULT_MATCH_LOG &&
+        mkdir(LOG_FOLDER, 0750) == -1 && errno != EEXIST)
+        syserr("Cannot create %s", LOG_FOLDER);
+    match_log.reset(new MatchLog(options.match_log_path));
+    std::unique_ptr<Judge::WorkerClient> worker;
+    if (!options.worker_address.empty()) {
+        vector<string> games;
+        for (const Judge::Game& game : engines)
+            games.push_back(game.name);
+        worker.reset(new Judge::WorkerClient(options.worker_address, games,
+                                             auth_token()));
+        options.seed = worker->getRunSeed();
+    } else if (!options.seed_given && options.cache_path.empty()) {
+        // With --cache the run seed stays 0, so that runs meet the same
+        // matches in the cache.
+        options.seed = (static_cast<uint64_t>(time(NULL)) << 32) ^ getpid();
+    }
+    cout << "Run seed: " << options.seed << endl;
+    if (!options.results_path.empty())
+        result_sink.reset(new ResultSink(
+            options.results_path,
+            ResultSink::formatFor(options.results_path), options.jobs));
+    if (!options.cache_path.empty())
+        result_cache.reset(new Judge::ResultCache(options.cache_path));
+    if (options.reuse_bots)
+        bot_pool.reset(new BotPool(options.reset_timeout_ms));
+    if (!options.coordinator_address.empty()) {
+        vector<string> games;
+        for (const Judge::Game& game : engines)
+            games.push_back(game.name);
+        coordinator.reset(new Judge::Coordinator(options.coordinator_address,
+                                                 options.seed, games,
+                                                 options.match_timeout_ms,
+                                                 auth_token()));
+        cout << "Coordinating workers on " << coordinator->getAddress()
+             << endl;
+    }
+    if (worker)
+        run_worker(options, *worker);
+    else if (options.tournament == TournamentType::None)
+        run_head_to_head(options);
+    else
+        run_tournament(options);
+    if (coordinator)
+        coordinator->finish();
+    print_run_stats(options);
+    coordinator.reset();
+    worker.reset();
+    bot_pool.reset();
+    result_cache.reset();
+    result_sink.reset();
+    match_log.reset();
     return 0;
 }
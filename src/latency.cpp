@@ -0,0 +1,69 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <sstream>
+
+int latency_histogram::bucket_of(long long us) {
+    uint64_t value = std::clamp(us, 0LL, (2LL << MAX_EXPONENT) - 1);
+    if (value < SUB_BUCKETS)
+        return static_cast<int>(value);
+    int exponent = std::bit_width(value) - 1;
+    int sub_bucket = (value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return SUB_BUCKETS * (exponent - SUB_BUCKET_BITS + 1) + sub_bucket;
+}
+
+// The middle of the bucket.
+long long latency_histogram::bucket_value(int bucket) {
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    int shift = exponent - SUB_BUCKET_BITS;
+    long long low = static_cast<long long>(SUB_BUCKETS + bucket % SUB_BUCKETS)
+                    << shift;
+    return low + (1LL << shift) / 2;
+}
+
+void latency_histogram::record(long long us) {
+    us = std::max(0LL, us);
+    counts_[bucket_of(us)]++;
+    count_++;
+    total_us_ += us;
+    max_us_ = std::max(max_us_, us);
+}
+
+void latency_histogram::merge(const latency_histogram& other) {
+    for (int i = 0; i < BUCKETS; i++)
+        counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    timeouts_ += other.timeouts_;
+    total_us_ += other.total_us_;
+    max_us_ = std::max(max_us_, other.max_us_);
+}
+
+long long latency_histogram::mean_us() const {
+    return count_ == 0 ? 0 : total_us_ / static_cast<long long>(count_);
+}
+
+long long latency_histogram::percentile_us(double fraction) const {
+    if (count_ == 0)
+        return 0;
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(fraction * count_));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts_[i];
+        // The highest bucket holds the maximum, which is known exactly.
+        if (seen >= rank)
+            return seen == count_ ? max_us_ : bucket_value(i);
+    }
+    return max_us_;
+}
+
+std::string latency_histogram::summary() const {
+    std::ostringstream out;
+    out << "responses=" << count_ << " mean_us=" << mean_us()
+        << " p50_us=" << percentile_us(0.5) << " p99_us=" << percentile_us(0.99)
+        << " max_us=" << max_us_ << " timeouts=" << timeouts_;
+    return out.str();
+}
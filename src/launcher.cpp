@@ -0,0 +1,146 @@
+#include "launcher.h"
+#include "err.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+extern char** environ;
+
+namespace Judge {
+
+// Raw syscalls: older C libraries lack the wrappers and some ship
+// <sys/pidfd.h> without C linkage.
+static int pidfd_open(pid_t pid, unsigned flags) {
+    return syscall(SYS_pidfd_open, pid, flags);
+}
+
+static int pidfd_send_signal(int pidfd, int sig) {
+    return syscall(SYS_pidfd_send_signal, pidfd, sig, nullptr, 0);
+}
+
+void make_cloexec_pipe(filedesc_t fds[2]) {
+    SYSCALL_WITH_CHECK(pipe2(fds, O_CLOEXEC));
+}
+
+int launch(const std::string& program,
+           const std::vector<std::string>& args,
+           const std::vector<FdMapping>& fds,
+           ChildProcess& child,
+           const std::vector<std::string>& env) {
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for (const std::string& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    std::vector<char*> envp;
+    for (char** entry = environ; *entry != nullptr; entry++)
+        envp.push_back(*entry);
+    for (const std::string& entry : env)
+        envp.push_back(const_cast<char*>(entry.c_str()));
+    envp.push_back(nullptr);
+
+    // The mappings are applied in order, so a descriptor that is also the
+    // target of another mapping is moved out of the way first.
+    filedesc_t max_child_fd = -1;
+    for (const FdMapping& fd : fds)
+        max_child_fd = std::max(max_child_fd, fd.child_fd);
+    std::vector<filedesc_t> moved;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (const FdMapping& fd : fds) {
+        filedesc_t parent_fd = fd.parent_fd;
+        for (const FdMapping& other : fds) {
+            if (other.child_fd == parent_fd && parent_fd != fd.child_fd) {
+                SYSCALL_WITH_CHECK(parent_fd = fcntl(
+                                       fd.parent_fd, F_DUPFD_CLOEXEC,
+                                       max_child_fd + 1));
+                moved.push_back(parent_fd);
+                break;
+            }
+        }
+        // dup2() onto the same fd clears close-on-exec, so identity
+        // mappings work as well.
+        posix_spawn_file_actions_adddup2(&actions, parent_fd, fd.child_fd);
+    }
+
+    // The judge ignores SIGPIPE; bots get the default disposition back.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr,
+                             POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+    int rv = posix_spawnp(&pid, program.c_str(), &actions, &attr, argv.data(),
+                          envp.data());
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    for (filedesc_t fd : moved)
+        SYSCALL_WITH_CHECK(close(fd));
+    if (rv != 0)
+        return rv;
+
+    child.pid = pid;
+    // The pid cannot be reused before we reap it, so this is race-free.
+    // Kernels without pidfds fall back to plain pids. Pidfds are always
+    // close-on-exec.
+    child.pidfd = pidfd_open(pid, 0);
+    return 0;
+}
+
+bool is_running(const ChildProcess& child) {
+    if (child.pid <= 0)
+        return false;
+    if (child.pidfd != -1) {
+        pollfd pfd = {child.pidfd, POLLIN, 0};
+        return poll(&pfd, 1, 0) == 0;
+    }
+    siginfo_t info;
+    info.si_pid = 0;
+    return waitid(P_PID, child.pid, &info, WEXITED | WNOHANG | WNOWAIT) ==
+               0 &&
+           info.si_pid == 0;
+}
+
+void kill_child(const ChildProcess& child) {
+    if (child.pid <= 0)
+        return;
+    int rv = child.pidfd != -1
+                 ? pidfd_send_signal(child.pidfd, SIGKILL)
+                 : kill(child.pid, SIGKILL);
+    if (rv == -1 && errno != ESRCH)
+        syserr("Cannot kill child %d", child.pid);
+}
+
+int reap_child(ChildProcess& child) {
+    if (child.pid <= 0)
+        return 0;
+    siginfo_t info;
+    int rv;
+    do {
+        rv = child.pidfd != -1 ? waitid(P_PIDFD, child.pidfd, &info, WEXITED)
+                               : waitid(P_PID, child.pid, &info, WEXITED);
+    } while (rv == -1 && errno == EINTR);
+    if (rv == -1)
+        syserr("Cannot reap child %d", child.pid);
+    if (child.pidfd != -1)
+        SYSCALL_WITH_CHECK(close(child.pidfd));
+    child.pid = -1;
+    child.pidfd = -1;
+    return info.si_code == CLD_EXITED ? info.si_status : 128 + info.si_status;
+}
+
+}  // namespace Judge
@@ -0,0 +1,215 @@
+#include "matchlog.h"
+#include "err.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Judge {
+
+static constexpr char ARCHIVE_MAGIC[8] = {'B', 'J', 'L', 'O',
+                                          'G', 'A', 'R', 'C'};
+static constexpr char INDEX_MAGIC[8] = {'B', 'J', 'L', 'O',
+                                        'G', 'I', 'D', 'X'};
+static constexpr uint32_t FORMAT_VERSION = 1;
+static constexpr size_t HEADER_SIZE = 16;
+
+static_assert(sizeof(MatchLogEntry) == 32, "index entries are 32 bytes");
+
+static void write_header(filedesc_t fd, const char (&magic)[8]) {
+    char header[HEADER_SIZE] = {};
+    memcpy(header, magic, sizeof(magic));
+    uint32_t fields[2] = {FORMAT_VERSION, sizeof(MatchLogEntry)};
+    memcpy(header + sizeof(magic), fields, sizeof(fields));
+    if (pwrite(fd, header, HEADER_SIZE, 0) != HEADER_SIZE)
+        syserr("Cannot write match log header");
+}
+
+static void pwrite_all(filedesc_t fd, iovec* iov, int iovcnt, off_t offset) {
+    while (iovcnt > 0) {
+        ssize_t rv = pwritev(fd, iov, iovcnt, offset);
+        if (rv == -1) {
+            if (errno == EINTR)
+                continue;
+            syserr("Cannot append to match log");
+        }
+        offset += rv;
+        while (iovcnt > 0 && static_cast<size_t>(rv) >= iov->iov_len) {
+            rv -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + rv;
+            iov->iov_len -= rv;
+        }
+    }
+}
+
+MatchLog::MatchLog(const std::string& path)
+    : next_offset(HEADER_SIZE), next_slot(0) {
+    SYSCALL_WITH_CHECK(archive_fd = open(path.c_str(),
+                                         O_WRONLY | O_CREAT | O_TRUNC |
+                                             O_CLOEXEC,
+                                         0640));
+    std::string index_path = path + ".idx";
+    SYSCALL_WITH_CHECK(index_fd = open(index_path.c_str(),
+                                       O_WRONLY | O_CREAT | O_TRUNC |
+                                           O_CLOEXEC,
+                                       0640));
+    write_header(archive_fd, ARCHIVE_MAGIC);
+    write_header(index_fd, INDEX_MAGIC);
+}
+
+MatchLog::~MatchLog() {
+    SYSCALL_WITH_CHECK(close(archive_fd));
+    SYSCALL_WITH_CHECK(close(index_fd));
+}
+
+uint64_t MatchLog::reserve(size_t length,
+                           MatchLogEntry& entry,
+                           uint64_t& slot) {
+    uint64_t record_offset =
+        next_offset.fetch_add(sizeof(MatchLogEntry) + length);
+    slot = next_slot.fetch_add(1);
+    entry.written = 1;
+    entry.offset = record_offset + sizeof(MatchLogEntry);
+    entry.length = length;
+    return record_offset;
+}
+
+void MatchLog::commit(const MatchLogEntry& entry, uint64_t slot) {
+    iovec iov = {const_cast<MatchLogEntry*>(&entry), sizeof(entry)};
+    pwrite_all(index_fd, &iov, 1, HEADER_SIZE + slot * sizeof(entry));
+}
+
+void MatchLog::append(int match_id,
+                      int player_id,
+                      MatchLogEntry::Kind kind,
+                      const void* data,
+                      size_t length) {
+    MatchLogEntry entry = {static_cast<uint32_t>(match_id), player_id, kind,
+                           0, 0, 0};
+    uint64_t slot;
+    uint64_t record_offset = reserve(length, entry, slot);
+    iovec iov[2] = {{&entry, sizeof(entry)},
+                    {const_cast<void*>(data), length}};
+    pwrite_all(archive_fd, iov, 2, record_offset);
+    commit(entry, slot);
+}
+
+void MatchLog::appendFile(int match_id,
+                          int player_id,
+                          MatchLogEntry::Kind kind,
+                          filedesc_t fd,
+                          off_t begin,
+                          off_t end) {
+    if (end == -1) {
+        struct stat st;
+        SYSCALL_WITH_CHECK(fstat(fd, &st));
+        end = st.st_size;
+    }
+    size_t length = end - begin;
+
+    MatchLogEntry entry = {static_cast<uint32_t>(match_id), player_id, kind,
+                           0, 0, 0};
+    uint64_t slot;
+    uint64_t record_offset = reserve(length, entry, slot);
+    iovec iov = {&entry, sizeof(entry)};
+    pwrite_all(archive_fd, &iov, 1, record_offset);
+
+    char buf[1 << 16];
+    off_t copied = 0;
+    while (static_cast<size_t>(copied) < length) {
+        ssize_t rv = pread(fd, buf, std::min(sizeof(buf), length - copied),
+                           begin + copied);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv <= 0)
+            break;
+        iov = {buf, static_cast<size_t>(rv)};
+        pwrite_all(archive_fd, &iov, 1, entry.offset + copied);
+        copied += rv;
+    }
+    // The file shrank under us; keep the record well-formed.
+    if (static_cast<size_t>(copied) < length) {
+        memset(buf, 0, sizeof(buf));
+        while (static_cast<size_t>(copied) < length) {
+            iov = {buf, std::min(sizeof(buf), length - copied)};
+            pwrite_all(archive_fd, &iov, 1, entry.offset + copied);
+            copied += iov.iov_len;
+        }
+    }
+    commit(entry, slot);
+}
+
+static const char* map_file(const std::string& path,
+                            const char (&magic)[8],
+                            size_t& size) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        syserr("Cannot open %s", path.c_str());
+    struct stat st;
+    SYSCALL_WITH_CHECK(fstat(fd, &st));
+    size = st.st_size;
+    if (size < HEADER_SIZE)
+        fatal("%s is not a match log", path.c_str());
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        syserr("Cannot map %s", path.c_str());
+    SYSCALL_WITH_CHECK(close(fd));
+    if (memcmp(data, magic, sizeof(magic)) != 0)
+        fatal("%s is not a match log", path.c_str());
+    return static_cast<const char*>(data);
+}
+
+MatchLogReader::MatchLogReader(const std::string& path) {
+    archive = map_file(path, ARCHIVE_MAGIC, archive_size);
+    index = map_file(path + ".idx", INDEX_MAGIC, index_size);
+    entries = reinterpret_cast<const MatchLogEntry*>(index + HEADER_SIZE);
+    entry_count = (index_size - HEADER_SIZE) / sizeof(MatchLogEntry);
+}
+
+MatchLogReader::~MatchLogReader() {
+    munmap(const_cast<char*>(archive), archive_size);
+    munmap(const_cast<char*>(index), index_size);
+}
+
+std::vector<MatchLogEntry> MatchLogReader::find(int match_id) const {
+    std::vector<MatchLogEntry> result;
+    for (const MatchLogEntry& entry : *this) {
+        if (entry.written && entry.match_id == static_cast<uint32_t>(match_id))
+            result.push_back(entry);
+    }
+    return result;
+}
+
+std::string MatchLogReader::read(const MatchLogEntry& entry) const {
+    return std::string(view(entry));
+}
+
+std::string_view MatchLogReader::view(const MatchLogEntry& entry) const {
+    if (entry.offset > archive_size ||
+        entry.length > archive_size - entry.offset)
+        fatal("match log record out of bounds");
+    return std::string_view(archive + entry.offset, entry.length);
+}
+
+const char* match_log_kind_name(uint32_t kind) {
+    switch (kind) {
+        case MatchLogEntry::Metadata:
+            return "meta";
+        case MatchLogEntry::Stderr:
+            return "stderr";
+        case MatchLogEntry::Transcript:
+            return "transcript";
+    }
+    return "unknown";
+}
+
+}  // namespace Judge
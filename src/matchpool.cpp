@@ -0,0 +1,35 @@
+#include "matchpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace Judge {
+
+MatchPool::MatchPool(int p_workers) : workers(std::max(1, p_workers)) {}
+
+void MatchPool::run(int job_count, const job_fun_t& job) {
+    std::atomic<int> next_job{0};
+    auto worker_loop = [&](int worker_id) {
+        for (int job_id = next_job++; job_id < job_count;
+             job_id = next_job++) {
+            job(job_id, worker_id);
+        }
+    };
+
+    int threads_needed = std::min(workers, job_count);
+    if (threads_needed <= 1) {
+        worker_loop(0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(threads_needed);
+    for (int i = 0; i < threads_needed; i++)
+        threads.emplace_back(worker_loop, i);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+}  // namespace Judge
@@ -1,38 +1,155 @@
 #include "playerstream.h"
+#include "framing.h"
+#include "monotonic.h"
 
+#include <fcntl.h>       // fcntl, O_NONBLOCK
+#include <poll.h>        // ppoll
 #include <signal.h>      // signaction
-#include <sys/select.h>  // select, timeval
+#include <sys/uio.h>     // writev
 #include <unistd.h>      // read
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
-playerbuf::playerbuf(int input_fd, int output_fd)
+playerbuf::playerbuf(int input_fd, int output_fd, playerbuf_policy policy)
     : input_fd_(input_fd),
       output_fd_(output_fd),
       readbuf_(nullptr),
+      readbuf_size_(0),
+      readbuf_filled_(false),
       writebuf_(nullptr),
-      timeout_(),
+      writebuf_size_(0),
+      timeout_ms_(-1),
+      deadline_set_(false),
+      read_deadline_(),
+      request_sent_(),
+      last_read_(),
+      request_pending_(false),
+      request_answered_(false),
+      write_timeout_ms_(-1),
+      max_frame_size_(Frame::DEFAULT_MAX_SIZE),
       last_error_(0) {
-    if (input_fd >= 0) {
-        readbuf_ = new char[BUF_SIZE];
-    }
+    set_buffer_policy(policy);
     if (output_fd >= 0) {
-        writebuf_ = new char[BUF_SIZE];
-        setp(writebuf_, writebuf_ + BUF_SIZE);
+        resize_writebuf();
+        // A full pipe must not block the judge; sync() waits for it with
+        // the write timeout instead. Errors surface on the first write.
+        int flags = fcntl(output_fd, F_GETFL);
+        if (flags != -1)
+            fcntl(output_fd, F_SETFL, flags | O_NONBLOCK);
     }
 }
 
+playerbuf::playerbuf(std::shared_ptr<player_transport> transport,
+                     playerbuf_policy policy)
+    : transport_(std::move(transport)),
+      input_fd_(transport_->get_poll_fd()),
+      output_fd_(transport_->get_poll_fd()),
+      readbuf_(nullptr),
+      readbuf_size_(0),
+      readbuf_filled_(false),
+      writebuf_(nullptr),
+      writebuf_size_(0),
+      timeout_ms_(-1),
+      deadline_set_(false),
+      read_deadline_(),
+      request_sent_(),
+      last_read_(),
+      request_pending_(false),
+      request_answered_(false),
+      write_timeout_ms_(-1),
+      max_frame_size_(Frame::DEFAULT_MAX_SIZE),
+      last_error_(0) {
+    set_buffer_policy(policy);
+    resize_writebuf();
+}
+
 void playerbuf::set_timeout_ms(int timeout_ms) {
-    if (timeout_ == nullptr) {
-        timeout_.reset(new timeval);
+    timeout_ms_ = timeout_ms;
+    deadline_set_ = timeout_ms >= 0;
+    if (deadline_set_)
+        read_deadline_ = Monotonic::after_ms(timeout_ms);
+}
+
+void playerbuf::set_deadline(const timespec& deadline) {
+    read_deadline_ = deadline;
+    deadline_set_ = true;
+}
+
+void playerbuf::clear_deadline() {
+    timeout_ms_ = -1;
+    deadline_set_ = false;
+}
+
+long long playerbuf::get_think_time_us() const {
+    if (request_sent_.tv_sec == 0 && request_sent_.tv_nsec == 0)
+        return 0;
+    return std::max(0LL, Monotonic::elapsed_us(request_sent_, last_read_));
+}
+
+latency_histogram playerbuf::get_response_times() const {
+    latency_histogram result = response_times_;
+    if (request_pending_ && request_answered_)
+        result.record(get_think_time_us());
+    return result;
+}
+
+void playerbuf::record_timeout() {
+    response_times_.record_timeout();
+    request_pending_ = false;
+}
+
+void playerbuf::set_write_timeout_ms(int timeout_ms) {
+    write_timeout_ms_ = timeout_ms;
+}
+
+void playerbuf::set_buffer_policy(playerbuf_policy policy) {
+    policy_.initial_size = std::max<size_t>(policy.initial_size, 1);
+    policy_.max_size = std::max(policy.max_size, policy_.initial_size);
+    if (writebuf_ != nullptr && pptr() == pbase())
+        resize_writebuf();
+}
+
+// Small buffers live in the playerbuf, larger ones on the heap.
+static char* allocate_buffer(size_t size,
+                             std::unique_ptr<char[]>& heap,
+                             char* inline_buf) {
+    if (size <= playerbuf::BUF_SIZE) {
+        heap.reset();
+        return inline_buf;
     }
-    timeout_->tv_sec = timeout_ms / 1000;
-    timeout_->tv_usec = 1000 * (timeout_ms % 1000);
+    heap = std::make_unique_for_overwrite<char[]>(size);
+    return heap.get();
 }
 
-playerbuf::~playerbuf() {
-    delete readbuf_;
-    delete writebuf_;
+// Refills the empty read buffer with a single read, after doubling it if
+// the previous read filled it.
+ssize_t playerbuf::fill_readbuf() {
+    size_t size = readbuf_filled_ ? 2 * readbuf_size_ : readbuf_size_;
+    size = std::clamp(size, policy_.initial_size, policy_.max_size);
+    if (size != readbuf_size_) {
+        readbuf_size_ = size;
+        readbuf_ = allocate_buffer(size, readbuf_heap_, readbuf_inline_);
+    }
+    setg(readbuf_, readbuf_, readbuf_);
+    ssize_t rv = read_input(readbuf_, readbuf_size_);
+    readbuf_filled_ = rv == static_cast<ssize_t>(readbuf_size_);
+    if (rv > 0) {
+        setg(readbuf_, readbuf_, readbuf_ + rv);
+        last_read_ = Monotonic::now();
+        request_answered_ = true;
+    }
+    return rv;
+}
+
+// Gives the empty write buffer the size the policy asks for.
+void playerbuf::resize_writebuf() {
+    if (writebuf_size_ != policy_.initial_size) {
+        writebuf_size_ = policy_.initial_size;
+        writebuf_ =
+            allocate_buffer(writebuf_size_, writebuf_heap_, writebuf_inline_);
+    }
+    setp(writebuf_, writebuf_ + writebuf_size_);
 }
 
 void playerbuf::throw_last_error(const playerbuf&, int errnum) {
@@ -40,37 +157,136 @@ void playerbuf::throw_last_error(const playerbuf&, int errnum) {
                           std::error_code(errnum, std::system_category()));
 }
 
+ssize_t playerbuf::read_input(char* buf, size_t len) {
+    ssize_t rv =
+        transport_ ? transport_->read(buf, len) : read(input_fd_, buf, len);
+    if (recorder_ && rv >= 0)
+        recorder_->on_input(buf, rv);
+    return rv;
+}
+
+// Like writev(). Transports take a single buffer, and are never given an
+// empty first one.
+ssize_t playerbuf::write_output(const iovec* iov, int iovcnt) {
+    ssize_t rv = transport_ ? transport_->write(
+                                  static_cast<const char*>(iov[0].iov_base),
+                                  iov[0].iov_len)
+                            : writev(output_fd_, iov, iovcnt);
+    if (recorder_) {
+        int errnum = errno;
+        if (rv > 0)
+            recorder_->on_output(iov, iovcnt, rv);
+        else if (rv == -1 && errnum != EAGAIN && errnum != EWOULDBLOCK &&
+                 errnum != EINTR)
+            recorder_->on_output_error(errnum);
+        errno = errnum;
+    }
+    return rv;
+}
+
 int playerbuf::underflow() {
     if (gptr() == egptr()) {
-        fd_set set;
-        FD_ZERO(&set);
-        FD_SET(input_fd_, &set);
-        // TODO: this works only on Linux
-        int rv = select(input_fd_ + 1, &set, nullptr, nullptr, timeout_.get());
-        if (rv == -1) {
-            last_error_ = errno;
-            call_on_error();
-            return traits_type::eof();
-        } else if (rv == 0) {
-            last_error_ = ETIME;
-            call_on_error();
-            return traits_type::eof();
-        } else {
-            rv = read(input_fd_, readbuf_, BUF_SIZE);
-            if (rv == -1) {
-                last_error_ = errno;
+        // A transport has to be read before its poll fd is waited on.
+        bool may_read = transport_ != nullptr;
+        while (true) {
+            if (may_read) {
+                ssize_t rv = fill_readbuf();
+                if (rv > 0) {
+                    break;
+                } else if (rv == 0) {
+                    return traits_type::eof();
+                } else if (errno != EAGAIN) {
+                    last_error_ = errno;
+                    call_on_error();
+                    return traits_type::eof();
+                }
+            }
+            // However the reply trickles in, it has to be complete by the
+            // same deadline.
+            pollfd pfd = {input_fd_, POLLIN, 0};
+            if (!wait_for(pfd, deadline_set_ ? &read_deadline_ : nullptr)) {
+                if (last_error_ == ETIME)
+                    record_timeout();
                 call_on_error();
                 return traits_type::eof();
-            } else if (rv == 0) {
-                return traits_type::eof();
             }
-            setg(readbuf_, readbuf_, readbuf_ + rv);
+            may_read = true;
         }
     }
     assert(gptr() != egptr());
     return traits_type::to_int_type(*gptr());
 }
 
+playerbuf::line_status playerbuf::read_line_nonblocking(std::string& line,
+                                                       bool may_read) {
+    // Reading a transport never blocks.
+    if (transport_)
+        may_read = true;
+    while (true) {
+        char* newline = nullptr;
+        if (gptr() != egptr())
+            newline =
+                static_cast<char*>(memchr(gptr(), '\n', egptr() - gptr()));
+        if (newline != nullptr) {
+            line.append(gptr(), newline);
+            gbump(newline - gptr() + 1);
+            return line_status::complete;
+        }
+        line.append(gptr(), egptr());
+        setg(readbuf_, readbuf_, readbuf_);
+        if (!may_read)
+            return line_status::pending;
+        may_read = false;
+
+        ssize_t rv = fill_readbuf();
+        if (rv == -1) {
+            if (errno == EAGAIN || errno == EINTR)
+                return line_status::pending;
+            last_error_ = errno;
+            return line_status::error;
+        } else if (rv == 0) {
+            return line_status::eof;
+        }
+    }
+}
+
+bool playerbuf::write_frame(std::string_view frame) {
+    if (frame.size() > max_frame_size_) {
+        last_error_ = EMSGSIZE;
+        call_on_error();
+        return false;
+    }
+    char header[Frame::HEADER_SIZE];
+    Frame::encode_length(frame.size(), header);
+    std::streamsize size = frame.size();
+    return sputn(header, sizeof(header)) == sizeof(header) &&
+           sputn(frame.data(), size) == size;
+}
+
+bool playerbuf::read_frame(std::string_view& frame) {
+    char header[Frame::HEADER_SIZE];
+    if (sgetn(header, sizeof(header)) != sizeof(header))
+        return false;
+    size_t size = Frame::decode_length(header);
+    if (size > max_frame_size_) {
+        last_error_ = EMSGSIZE;
+        call_on_error();
+        return false;
+    }
+    // Small frames usually arrive whole and are not copied.
+    if (static_cast<size_t>(egptr() - gptr()) >= size) {
+        frame = std::string_view(gptr(), size);
+        gbump(size);
+        return true;
+    }
+    frame_.resize(size);
+    std::streamsize expected = size;
+    if (sgetn(frame_.data(), expected) != expected)
+        return false;
+    frame = std::string_view(frame_.data(), size);
+    return true;
+}
+
 int playerbuf::overflow(int c) {
     if (sync() != 0)
         return traits_type::eof();
@@ -85,20 +301,141 @@ int playerbuf::overflow(int c) {
     return rv;
 }
 
-int playerbuf::sync() {
-    int chars_left = pptr() - pbase();
-    while (chars_left > 0) {
-        int rv = write(output_fd_, pptr() - chars_left, chars_left);
-        if (rv <= 0) {
+// Waits for `pfd` to become ready until `deadline`, if there is one.
+bool playerbuf::wait_for(pollfd& pfd, const timespec* deadline) {
+    while (true) {
+        timespec left;
+        if (deadline)
+            left = Monotonic::time_left(*deadline);
+        int rv = ppoll(&pfd, 1, deadline ? &left : nullptr, nullptr);
+        if (rv > 0)
+            return true;
+        if (rv == 0) {
+            last_error_ = ETIME;
+            return false;
+        }
+        if (errno != EINTR) {
+            last_error_ = errno;
+            return false;
+        }
+    }
+}
+
+bool playerbuf::wait_writable(const timespec* deadline) {
+    pollfd pfd = get_output_pollfd();
+    return wait_for(pfd, deadline);
+}
+
+// Sends the buffered output followed by `len` bytes of `data`, together
+// in as few writev() calls as the reader allows, and tells how much of
+// `data` went out. On an error, or when the reader is full and not
+// `may_wait`, the unsent part of the buffer is kept so that a later flush
+// can retry it. A request counts as sent once all of it went out.
+bool playerbuf::flush_with(const char* data,
+                           size_t len,
+                           size_t& data_written,
+                           bool may_wait) {
+    size_t buffered = pptr() - pbase();
+    iovec iov[2] = {{writebuf_, buffered}, {const_cast<char*>(data), len}};
+    iovec* next = buffered > 0 ? iov : iov + 1;
+    size_t left = buffered + len;
+    timespec deadline;
+    bool deadline_set = false;
+    bool ok = true;
+    // Taken before the write: the player may answer before it returns.
+    timespec started = left > 0 ? Monotonic::now() : timespec{};
+    while (left > 0) {
+        ssize_t rv = write_output(next, iov + 2 - next);
+        if (rv > 0) {
+            left -= rv;
+            for (size_t sent = rv; sent > 0;) {
+                size_t step = std::min(sent, next->iov_len);
+                next->iov_base = static_cast<char*>(next->iov_base) + step;
+                next->iov_len -= step;
+                sent -= step;
+                if (next->iov_len == 0 && next == iov)
+                    next++;
+            }
+            continue;
+        }
+        if (rv == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!may_wait)
+                break;
+            // One deadline for the whole flush, however the reader drips.
+            if (!deadline_set && write_timeout_ms_ >= 0) {
+                deadline = Monotonic::after_ms(write_timeout_ms_);
+                deadline_set = true;
+            }
+            if (wait_writable(deadline_set ? &deadline : nullptr))
+                continue;
+        } else {
             last_error_ = errno;
-            setp(pbase() - chars_left, writebuf_ + BUF_SIZE);
-            call_on_error();
-            return -1;
         }
-        chars_left -= rv;
+        ok = false;
+        break;
+    }
+    data_written = len - iov[1].iov_len;
+    size_t unsent = iov[0].iov_len;
+    if (unsent > 0) {
+        memmove(writebuf_, iov[0].iov_base, unsent);
+        setp(writebuf_, writebuf_ + writebuf_size_);
+        pbump(unsent);
+    } else {
+        resize_writebuf();
+    }
+    if (!ok) {
+        call_on_error();
+        return false;
+    }
+    if (buffered + len > 0 && left == 0) {
+        // A new request: its reply is due `timeout_ms_` from now.
+        if (request_pending_ && request_answered_)
+            response_times_.record(get_think_time_us());
+        request_pending_ = true;
+        request_answered_ = false;
+        request_sent_ = started;
+        if (timeout_ms_ >= 0)
+            set_deadline(Monotonic::after_ms(timeout_ms_, started));
+    }
+    return true;
+}
+
+playerbuf::write_status playerbuf::write_nonblocking(const char* data,
+                                                     size_t len,
+                                                     size_t& data_written) {
+    data_written = 0;
+    if (writebuf_ == nullptr) {
+        last_error_ = EBADF;
+        call_on_error();
+        return write_status::error;
+    }
+    if (!flush_with(data, len, data_written, false))
+        return write_status::error;
+    if (data_written < len || pptr() != pbase())
+        return write_status::pending;
+    return write_status::complete;
+}
+
+int playerbuf::sync() {
+    if (writebuf_ == nullptr)
+        return 0;
+    size_t data_written;
+    return flush_with(nullptr, 0, data_written) ? 0 : -1;
+}
+
+// Data that does not fit in the buffer goes out right away, in the same
+// writev() as what is buffered, instead of being copied through it.
+std::streamsize playerbuf::xsputn(const char* s, std::streamsize n) {
+    if (writebuf_ == nullptr)
+        return 0;
+    if (n <= epptr() - pptr()) {
+        memcpy(pptr(), s, n);
+        pbump(n);
+        return n;
     }
-    setp(writebuf_, writebuf_ + BUF_SIZE);
-    return 0;
+    size_t data_written;
+    flush_with(s, n, data_written);
+    return data_written;
 }
 
 void playerbuf::call_on_error() const {
@@ -0,0 +1,511 @@
+#include "resultcache.h"
+#include "err.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace Judge {
+
+static constexpr char RECORDS_MAGIC[8] = {'B', 'J', 'R', 'C',
+                                          'A', 'C', 'H', 'E'};
+static constexpr char INDEX_MAGIC[8] = {'B', 'J', 'R', 'C',
+                                        'I', 'N', 'D', 'X'};
+static constexpr uint32_t FORMAT_VERSION = 1;
+static constexpr size_t RECORDS_HEADER_SIZE = 16;
+static constexpr uint64_t INITIAL_CAPACITY = 1024;
+// Results are a few hundred bytes; anything longer is a damaged record.
+static constexpr uint64_t MAX_RECORD_LENGTH = 1 << 20;
+
+struct ResultCache::IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t capacity;  // slots, a power of two
+    uint64_t entries;
+    uint64_t records_end;  // where the indexed records end
+    char reserved[24];
+};
+
+struct ResultCache::Slot {
+    uint64_t high;
+    uint64_t low;
+    uint64_t offset;  // of the record, 0 if the slot is empty
+};
+
+// What precedes every result in the records file.
+struct RecordHeader {
+    uint64_t high;
+    uint64_t low;
+    uint64_t length;
+};
+
+static_assert(sizeof(RecordHeader) == 24, "record headers are 24 bytes");
+
+static uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static constexpr uint64_t C1 = 0x87c37b91114253d5ULL;
+static constexpr uint64_t C2 = 0x4cf5ad432745937fULL;
+
+std::string ContentHash::hex() const {
+    char digits[33];
+    snprintf(digits, sizeof(digits), "%016llx%016llx",
+             static_cast<unsigned long long>(high),
+             static_cast<unsigned long long>(low));
+    return digits;
+}
+
+void ContentHasher::mixBlock(const unsigned char* block) {
+    uint64_t k1, k2;
+    memcpy(&k1, block, 8);
+    memcpy(&k2, block + 8, 8);
+    k1 *= C1;
+    k1 = rotl(k1, 31);
+    k1 *= C2;
+    h1 ^= k1;
+    h1 = rotl(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+    k2 *= C2;
+    k2 = rotl(k2, 33);
+    k2 *= C1;
+    h2 ^= k2;
+    h2 = rotl(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+}
+
+void ContentHasher::update(const void* data, size_t length) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    total_length += length;
+    if (tail_length > 0) {
+        size_t taken = std::min(length, sizeof(tail) - tail_length);
+        memcpy(tail + tail_length, bytes, taken);
+        tail_length += taken;
+        bytes += taken;
+        length -= taken;
+        if (tail_length < sizeof(tail))
+            return;
+        mixBlock(tail);
+        tail_length = 0;
+    }
+    while (length >= sizeof(tail)) {
+        mixBlock(bytes);
+        bytes += sizeof(tail);
+        length -= sizeof(tail);
+    }
+    memcpy(tail, bytes, length);
+    tail_length = length;
+}
+
+void ContentHasher::update(std::string_view text) {
+    update(static_cast<uint64_t>(text.size()));
+    update(text.data(), text.size());
+}
+
+void ContentHasher::update(uint64_t value) {
+    update(&value, sizeof(value));
+}
+
+ContentHash ContentHasher::digest() const {
+    uint64_t d1 = h1, d2 = h2;
+    uint64_t k1 = 0, k2 = 0;
+    for (size_t i = tail_length; i > 8; i--)
+        k2 = (k2 << 8) | tail[i - 1];
+    for (size_t i = std::min<size_t>(tail_length, 8); i > 0; i--)
+        k1 = (k1 << 8) | tail[i - 1];
+    if (tail_length > 8) {
+        k2 *= C2;
+        k2 = rotl(k2, 33);
+        k2 *= C1;
+        d2 ^= k2;
+    }
+    if (tail_length > 0) {
+        k1 *= C1;
+        k1 = rotl(k1, 31);
+        k1 *= C2;
+        d1 ^= k1;
+    }
+    d1 ^= total_length;
+    d2 ^= total_length;
+    d1 += d2;
+    d2 += d1;
+    d1 = fmix(d1);
+    d2 = fmix(d2);
+    d1 += d2;
+    d2 += d1;
+    return {d1, d2};
+}
+
+ContentHash hash_file(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        syserr("Cannot open %s", path.c_str());
+    ContentHasher hasher;
+    char buf[1 << 16];
+    while (true) {
+        ssize_t rv = read(fd, buf, sizeof(buf));
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv == -1)
+            syserr("Cannot read %s", path.c_str());
+        if (rv == 0)
+            break;
+        hasher.update(buf, rv);
+    }
+    SYSCALL_WITH_CHECK(close(fd));
+    return hasher.digest();
+}
+
+static bool is_executable_file(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+           access(path.c_str(), X_OK) == 0;
+}
+
+std::string find_program(const std::string& program) {
+    if (program.find('/') != std::string::npos)
+        return is_executable_file(program) ? program : "";
+    const char* path = getenv("PATH");
+    std::string dirs = path != nullptr ? path : "/bin:/usr/bin";
+    size_t begin = 0;
+    while (begin <= dirs.size()) {
+        size_t end = dirs.find(':', begin);
+        if (end == std::string::npos)
+            end = dirs.size();
+        std::string dir = dirs.substr(begin, end - begin);
+        std::string candidate = (dir.empty() ? "." : dir) + "/" + program;
+        if (is_executable_file(candidate))
+            return candidate;
+        begin = end + 1;
+    }
+    return "";
+}
+
+static void pread_all(filedesc_t fd, void* buf, size_t length, off_t offset) {
+    char* data = static_cast<char*>(buf);
+    while (length > 0) {
+        ssize_t rv = pread(fd, data, length, offset);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv == -1)
+            syserr("Cannot read the result cache");
+        if (rv == 0)
+            fatal("The result cache ends in the middle of a record");
+        data += rv;
+        length -= rv;
+        offset += rv;
+    }
+}
+
+static void pwrite_all(filedesc_t fd,
+                       const void* buf,
+                       size_t length,
+                       off_t offset) {
+    const char* data = static_cast<const char*>(buf);
+    while (length > 0) {
+        ssize_t rv = pwrite(fd, data, length, offset);
+        if (rv == -1 && errno == EINTR)
+            continue;
+        if (rv == -1)
+            syserr("Cannot write the result cache");
+        data += rv;
+        length -= rv;
+        offset += rv;
+    }
+}
+
+template <class T>
+static void append_value(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+static bool take_value(std::string_view& in, T& value) {
+    if (in.size() < sizeof(value))
+        return false;
+    memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+// type, score count, scores, game_us, then the pretty result to the end.
+static std::string encode_result(const Engine::GameResult& result,
+                                 long long game_us) {
+    std::string out;
+    append_value(out, static_cast<uint32_t>(result.type));
+    append_value(out, static_cast<uint32_t>(result.player_scores.size()));
+    for (double score : result.player_scores)
+        append_value(out, score);
+    append_value(out, static_cast<int64_t>(game_us));
+    out += result.pretty_result;
+    return out;
+}
+
+static std::optional<CachedResult> decode_result(std::string_view in) {
+    uint32_t type, scores;
+    if (!take_value(in, type) || !take_value(in, scores) ||
+        type > Engine::GameResult::EngineError ||
+        scores > in.size() / sizeof(double))
+        return std::nullopt;
+    std::vector<double> player_scores(scores);
+    for (double& score : player_scores) {
+        if (!take_value(in, score))
+            return std::nullopt;
+    }
+    int64_t game_us;
+    if (!take_value(in, game_us))
+        return std::nullopt;
+    return CachedResult{
+        Engine::GameResult::createRecorded(
+            static_cast<Engine::GameResult::ResultType>(type),
+            std::move(player_scores), std::string(in)),
+        game_us};
+}
+
+ResultCache::ResultCache(const std::string& path)
+    : records_path(path), index_path(path + ".idx") {
+    static_assert(sizeof(IndexHeader) == 64, "the index header is 64 bytes");
+    static_assert(sizeof(Slot) == 24, "index slots are 24 bytes");
+    records_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+    if (records_fd == -1)
+        syserr("Cannot open %s", path.c_str());
+    if (flock(records_fd, LOCK_EX | LOCK_NB) == -1) {
+        if (errno == EWOULDBLOCK)
+            fatal("%s is used by another judge", path.c_str());
+        syserr("Cannot lock %s", path.c_str());
+    }
+    struct stat st;
+    SYSCALL_WITH_CHECK(fstat(records_fd, &st));
+    char header[RECORDS_HEADER_SIZE] = {};
+    if (st.st_size == 0) {
+        memcpy(header, RECORDS_MAGIC, sizeof(RECORDS_MAGIC));
+        memcpy(header + sizeof(RECORDS_MAGIC), &FORMAT_VERSION,
+               sizeof(FORMAT_VERSION));
+        pwrite_all(records_fd, header, sizeof(header), 0);
+        records_end = RECORDS_HEADER_SIZE;
+    } else {
+        uint32_t version = 0;
+        if (static_cast<size_t>(st.st_size) >= RECORDS_HEADER_SIZE) {
+            pread_all(records_fd, header, sizeof(header), 0);
+            memcpy(&version, header + sizeof(RECORDS_MAGIC), sizeof(version));
+        }
+        if (memcmp(header, RECORDS_MAGIC, sizeof(RECORDS_MAGIC)) != 0 ||
+            version != FORMAT_VERSION)
+            fatal("%s is not a result cache of this judge", path.c_str());
+        records_end = st.st_size;
+    }
+    openIndex();
+}
+
+ResultCache::~ResultCache() {
+    unmapIndex();
+    SYSCALL_WITH_CHECK(close(records_fd));
+}
+
+ResultCache::IndexHeader& ResultCache::header() {
+    return *reinterpret_cast<IndexHeader*>(index);
+}
+
+ResultCache::Slot* ResultCache::slots() {
+    return reinterpret_cast<Slot*>(index + sizeof(IndexHeader));
+}
+
+// Uses the index if it is sound and starts a new one otherwise, then
+// indexes the records it does not cover yet.
+void ResultCache::openIndex() {
+    int fd = open(index_path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd != -1) {
+        struct stat st;
+        SYSCALL_WITH_CHECK(fstat(fd, &st));
+        IndexHeader stored;
+        bool sound = static_cast<size_t>(st.st_size) >= sizeof(stored) &&
+                     pread(fd, &stored, sizeof(stored), 0) ==
+                         static_cast<ssize_t>(sizeof(stored)) &&
+                     memcmp(stored.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) ==
+                         0 &&
+                     stored.version == FORMAT_VERSION &&
+                     stored.slot_size == sizeof(Slot) &&
+                     stored.capacity > 0 &&
+                     (stored.capacity & (stored.capacity - 1)) == 0 &&
+                     static_cast<uint64_t>(st.st_size) ==
+                         sizeof(stored) + stored.capacity * sizeof(Slot) &&
+                     stored.records_end >= RECORDS_HEADER_SIZE &&
+                     stored.records_end <= records_end;
+        if (sound) {
+            mapIndex(fd);
+            indexRecords(stored.records_end);
+            return;
+        }
+        SYSCALL_WITH_CHECK(close(fd));
+    } else if (errno != ENOENT) {
+        syserr("Cannot open %s", index_path.c_str());
+    }
+    createIndex(index_path, INITIAL_CAPACITY);
+    indexRecords(RECORDS_HEADER_SIZE);
+}
+
+void ResultCache::createIndex(const std::string& path, uint64_t capacity) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd == -1)
+        syserr("Cannot create %s", path.c_str());
+    SYSCALL_WITH_CHECK(
+        ftruncate(fd, sizeof(IndexHeader) + capacity * sizeof(Slot)));
+    mapIndex(fd);
+    IndexHeader& created = header();
+    memcpy(created.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    created.version = FORMAT_VERSION;
+    created.slot_size = sizeof(Slot);
+    created.capacity = capacity;
+    created.records_end = RECORDS_HEADER_SIZE;
+}
+
+// Takes over `fd`.
+void ResultCache::mapIndex(filedesc_t fd) {
+    struct stat st;
+    SYSCALL_WITH_CHECK(fstat(fd, &st));
+    void* data =
+        mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+        syserr("Cannot map %s", index_path.c_str());
+    SYSCALL_WITH_CHECK(close(fd));
+    index = static_cast<char*>(data);
+    index_size = st.st_size;
+}
+
+void ResultCache::unmapIndex() {
+    SYSCALL_WITH_CHECK(munmap(index, index_size));
+    index = nullptr;
+    index_size = 0;
+}
+
+// Indexes the records from `from` to the end of the file, cutting off a
+// record the end of the file tears.
+void ResultCache::indexRecords(uint64_t from) {
+    uint64_t offset = from;
+    while (offset < records_end) {
+        RecordHeader record;
+        if (records_end - offset < sizeof(record))
+            break;
+        pread_all(records_fd, &record, sizeof(record), offset);
+        if (record.length > MAX_RECORD_LENGTH ||
+            record.length > records_end - offset - sizeof(record))
+            break;
+        ContentHash key = {record.high, record.low};
+        if (slotFor(key).offset == 0)
+            addSlot(key, offset);
+        offset += sizeof(record) + record.length;
+    }
+    if (offset < records_end) {
+        SYSCALL_WITH_CHECK(ftruncate(records_fd, offset));
+        records_end = offset;
+    }
+    header().records_end = records_end;
+}
+
+// Rehashes into a table twice as large, written next to the index and
+// renamed over it, so that the old one stays whole until then.
+void ResultCache::grow() {
+    char* old_index = index;
+    size_t old_size = index_size;
+    const IndexHeader old_header = header();
+    const Slot* old_slots = slots();
+
+    std::string new_path = index_path + ".new";
+    createIndex(new_path, old_header.capacity * 2);
+    header().records_end = old_header.records_end;
+    for (uint64_t i = 0; i < old_header.capacity; i++) {
+        if (old_slots[i].offset != 0)
+            addSlot({old_slots[i].high, old_slots[i].low},
+                    old_slots[i].offset);
+    }
+    if (rename(new_path.c_str(), index_path.c_str()) == -1)
+        syserr("Cannot replace %s", index_path.c_str());
+    SYSCALL_WITH_CHECK(munmap(old_index, old_size));
+}
+
+// Keys are hashes already, so their low bits pick the slot; collisions
+// probe linearly.
+ResultCache::Slot& ResultCache::slotFor(const ContentHash& key) {
+    const uint64_t mask = header().capacity - 1;
+    Slot* table = slots();
+    for (uint64_t i = key.low & mask;; i = (i + 1) & mask) {
+        Slot& slot = table[i];
+        if (slot.offset == 0 || (slot.high == key.high && slot.low == key.low))
+            return slot;
+    }
+}
+
+void ResultCache::addSlot(const ContentHash& key, uint64_t offset) {
+    if ((header().entries + 1) * 2 > header().capacity)
+        grow();
+    Slot& slot = slotFor(key);
+    slot.high = key.high;
+    slot.low = key.low;
+    slot.offset = offset;
+    header().entries++;
+}
+
+std::optional<CachedResult> ResultCache::find(const ContentHash& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t offset = slotFor(key).offset;
+    if (offset == 0)
+        return std::nullopt;
+    RecordHeader record;
+    pread_all(records_fd, &record, sizeof(record), offset);
+    if (record.high != key.high || record.low != key.low ||
+        record.length > MAX_RECORD_LENGTH)
+        fatal("The index of %s is damaged; remove %s", records_path.c_str(),
+              index_path.c_str());
+    std::string payload(record.length, '\0');
+    pread_all(records_fd, payload.data(), payload.size(),
+              offset + sizeof(record));
+    std::optional<CachedResult> cached = decode_result(payload);
+    if (!cached)
+        fatal("Damaged record in %s", records_path.c_str());
+    return cached;
+}
+
+void ResultCache::insert(const ContentHash& key,
+                         const Engine::GameResult& result,
+                         long long game_us) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (slotFor(key).offset != 0)
+        return;
+    std::string payload = encode_result(result, game_us);
+    RecordHeader record = {key.high, key.low, payload.size()};
+    std::string data(reinterpret_cast<const char*>(&record), sizeof(record));
+    data += payload;
+    // The record is complete before the index points at it.
+    uint64_t offset = records_end;
+    pwrite_all(records_fd, data.data(), data.size(), offset);
+    records_end += data.size();
+    addSlot(key, offset);
+    header().records_end = records_end;
+}
+
+uint64_t ResultCache::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return header().entries;
+}
+
+}  // namespace Judge
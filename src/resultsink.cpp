@@ -0,0 +1,241 @@
+#include "resultsink.h"
+#include "err.h"
+#include "monotonic.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+
+namespace Judge {
+
+static const char CSV_HEADER[] =
+    "match,game,bots,seeds,scores,result,duration_us,details\n";
+
+static void append_number(std::string& out, double value) {
+    char digits[32];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, end);
+}
+
+static void append_json_string(std::string& out, const std::string& text) {
+    out += '"';
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += '"';
+}
+
+// Quoted only when needed, doubling the quotes inside as RFC 4180 does.
+static void append_csv_field(std::string& out, const std::string& field) {
+    if (field.find_first_of(",\"\r\n") == std::string::npos) {
+        out += field;
+        return;
+    }
+    out += '"';
+    for (char c : field) {
+        if (c == '"')
+            out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+// The elements of a list field of a CSV record, separated by ';'.
+template <class T, class Append>
+static std::string join(const std::vector<T>& values, Append append) {
+    std::string joined;
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0)
+            joined += ';';
+        append(joined, values[i]);
+    }
+    return joined;
+}
+
+template <class T, class Append>
+static void append_json_array(std::string& out,
+                              const std::vector<T>& values,
+                              Append append) {
+    out += '[';
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i > 0)
+            out += ',';
+        append(out, values[i]);
+    }
+    out += ']';
+}
+
+std::string ResultSink::formatRecord(Format format,
+                                     const MatchRecord& record) {
+    auto append_string = [](std::string& out, const std::string& s) {
+        out += s;
+    };
+    auto append_seed = [](std::string& out, unsigned seed) {
+        out += std::to_string(seed);
+    };
+    std::string line;
+    if (format == Format::Csv) {
+        line += std::to_string(record.match_id);
+        line += ',';
+        append_csv_field(line, record.game);
+        line += ',';
+        append_csv_field(line, join(record.bots, append_string));
+        line += ',';
+        line += join(record.seeds, append_seed);
+        line += ',';
+        line += join(record.scores, append_number);
+        line += ',';
+        append_csv_field(line, record.result);
+        line += ',';
+        line += std::to_string(record.duration_us);
+        line += ',';
+        append_csv_field(line, record.details);
+    } else {
+        line += "{\"match\":";
+        line += std::to_string(record.match_id);
+        line += ",\"game\":";
+        append_json_string(line, record.game);
+        line += ",\"bots\":";
+        append_json_array(line, record.bots, append_json_string);
+        line += ",\"seeds\":";
+        append_json_array(line, record.seeds, append_seed);
+        line += ",\"scores\":";
+        append_json_array(line, record.scores, append_number);
+        line += ",\"result\":";
+        append_json_string(line, record.result);
+        line += ",\"duration_us\":";
+        line += std::to_string(record.duration_us);
+        line += ",\"details\":";
+        append_json_string(line, record.details);
+        line += '}';
+    }
+    line += '\n';
+    return line;
+}
+
+ResultSink::Format ResultSink::formatFor(const std::string& path) {
+    const std::string csv = ".csv";
+    if (path.size() >= csv.size() &&
+        path.compare(path.size() - csv.size(), csv.size(), csv) == 0)
+        return Format::Csv;
+    return Format::Jsonl;
+}
+
+ResultSink::ResultSink(const std::string& path, Format p_format, int workers,
+                       int flush_interval_ms)
+    : format(p_format),
+      buffers(workers),
+      flush_interval_us(flush_interval_ms * 1000LL) {
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    if (fd == -1)
+        syserr("Cannot open %s", path.c_str());
+    struct stat st;
+    SYSCALL_WITH_CHECK(fstat(fd, &st));
+    if (format == Format::Csv && st.st_size == 0) {
+        WorkerBuffer header;
+        header.data = CSV_HEADER;
+        writeOut(header);
+    }
+    flusher = std::thread(&ResultSink::flushIdle, this);
+}
+
+ResultSink::~ResultSink() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex);
+        stopping = true;
+    }
+    stop_cv.notify_one();
+    flusher.join();
+    flush();
+    SYSCALL_WITH_CHECK(close(fd));
+}
+
+void ResultSink::append(int worker_id, const MatchRecord& record) {
+    std::string line = formatRecord(format, record);
+    WorkerBuffer& buffer = buffers[worker_id];
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.data.empty())
+        buffer.oldest = Monotonic::now();
+    buffer.data += line;
+    if (buffer.data.size() >= FLUSH_BYTES)
+        writeOut(buffer);
+}
+
+void ResultSink::flush() {
+    for (WorkerBuffer& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        writeOut(buffer);
+    }
+}
+
+// Sleeps until the oldest buffered record is due, so no record stays
+// buffered much longer than the interval, however long its worker is idle.
+void ResultSink::flushIdle() {
+    std::unique_lock<std::mutex> stop_lock(stop_mutex);
+    while (!stopping) {
+        timespec now = Monotonic::now();
+        long long sleep_us = flush_interval_us;
+        for (WorkerBuffer& buffer : buffers) {
+            std::lock_guard<std::mutex> lock(buffer.mutex);
+            if (buffer.data.empty())
+                continue;
+            long long due_us = flush_interval_us -
+                               Monotonic::elapsed_us(buffer.oldest, now);
+            if (due_us <= 0)
+                writeOut(buffer);
+            else
+                sleep_us = std::min(sleep_us, due_us);
+        }
+        stop_cv.wait_for(stop_lock, std::chrono::microseconds(sleep_us),
+                         [this] { return stopping; });
+    }
+}
+
+// With O_APPEND every write() lands at the end of the file as a whole, so
+// buffers of different workers never interleave within a record.
+void ResultSink::writeOut(WorkerBuffer& buffer) {
+    const char* data = buffer.data.data();
+    size_t left = buffer.data.size();
+    while (left > 0) {
+        ssize_t rv = write(fd, data, left);
+        if (rv == -1) {
+            if (errno == EINTR)
+                continue;
+            syserr("Cannot write results");
+        }
+        data += rv;
+        left -= rv;
+    }
+    buffer.data.clear();
+}
+
+}  // namespace Judge
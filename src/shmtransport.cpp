@@ -0,0 +1,121 @@
+#include "shmtransport.h"
+#include "err.h"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+namespace Judge {
+
+ShmTransport::ShmTransport(filedesc_t p_hangup_fd, uint32_t ring_size)
+    : hangup_fd(p_hangup_fd), map_size(Shm::mapping_size(ring_size)) {
+    assert(ring_size > 0 && (ring_size & (ring_size - 1)) == 0);
+
+    SYSCALL_WITH_CHECK(shm_fd = memfd_create("bots-judge-shm", MFD_CLOEXEC));
+    SYSCALL_WITH_CHECK(ftruncate(shm_fd, map_size));
+    void* data =
+        mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (data == MAP_FAILED)
+        syserr("Cannot map the shared-memory transport");
+    // The fresh memfd is zero-filled, so the rings start out empty.
+    header = static_cast<Shm::Header*>(data);
+    memcpy(header->magic, Shm::MAGIC, sizeof(Shm::MAGIC));
+    header->version = Shm::VERSION;
+    header->ring_size = ring_size;
+    to_bot = Shm::Ring(header, Shm::TO_BOT);
+    to_judge = Shm::Ring(header, Shm::TO_JUDGE);
+
+    SYSCALL_WITH_CHECK(bot_doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    SYSCALL_WITH_CHECK(judge_doorbell =
+                           eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+
+    int flags;
+    SYSCALL_WITH_CHECK(flags = fcntl(hangup_fd, F_GETFL));
+    SYSCALL_WITH_CHECK(fcntl(hangup_fd, F_SETFL, flags | O_NONBLOCK));
+
+    SYSCALL_WITH_CHECK(epoll_fd = epoll_create1(EPOLL_CLOEXEC));
+    for (filedesc_t fd : {judge_doorbell, hangup_fd}) {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        SYSCALL_WITH_CHECK(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event));
+    }
+}
+
+ShmTransport::~ShmTransport() {
+    munmap(header, map_size);
+    SYSCALL_WITH_CHECK(close(epoll_fd));
+    SYSCALL_WITH_CHECK(close(judge_doorbell));
+    SYSCALL_WITH_CHECK(close(bot_doorbell));
+    SYSCALL_WITH_CHECK(close(shm_fd));
+}
+
+std::vector<FdMapping> ShmTransport::getChildFds() const {
+    return {{shm_fd, Shm::BOT_SHM_FD},
+            {bot_doorbell, Shm::BOT_DOORBELL_FD},
+            {judge_doorbell, Shm::BOT_JUDGE_DOORBELL_FD}};
+}
+
+std::string ShmTransport::getChildEnv() {
+    return std::string(Shm::ENV_VAR) + "=" + std::to_string(Shm::BOT_SHM_FD) +
+           "," + std::to_string(Shm::BOT_DOORBELL_FD) + "," +
+           std::to_string(Shm::BOT_JUDGE_DOORBELL_FD);
+}
+
+// Drains the bot's stdout; it is gone once that reaches end of file.
+bool ShmTransport::isBotGone() {
+    char discarded[256];
+    while (true) {
+        ssize_t rv = ::read(hangup_fd, discarded, sizeof(discarded));
+        if (rv == 0)
+            return true;
+        if (rv == -1)
+            return errno != EAGAIN && errno != EINTR;
+    }
+}
+
+ssize_t ShmTransport::read(char* buf, size_t len) {
+    // Reset the doorbell before looking at the ring: whatever the bot
+    // publishes afterwards rings it again.
+    Shm::clear_doorbell(judge_doorbell);
+    bool wake_bot;
+    size_t n = to_judge.read(buf, len, wake_bot);
+    if (wake_bot)
+        Shm::ring_doorbell(bot_doorbell);
+    if (n > 0)
+        return n;
+    if (isBotGone()) {
+        // The bot may have written its last words just before exiting.
+        return to_judge.read(buf, len, wake_bot);
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+ssize_t ShmTransport::write(const char* buf, size_t len) {
+    Shm::clear_doorbell(judge_doorbell);
+    while (true) {
+        bool wake_bot;
+        size_t n = to_bot.write(buf, len, wake_bot);
+        if (wake_bot)
+            Shm::ring_doorbell(bot_doorbell);
+        if (n > 0 || len == 0)
+            return n;
+        if (isBotGone()) {
+            errno = EPIPE;
+            return -1;
+        }
+        if (to_bot.waitForSpace()) {
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+}
+
+}  // namespace Judge
@@ -0,0 +1,62 @@
+#include "sprt.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Judge {
+
+// The virtual win and loss ScoreStats starts with.
+static constexpr int VIRTUAL_MATCHES = 2;
+
+double score_to_elo(double score) {
+    return -400 * std::log10(1 / score - 1);
+}
+
+double elo_to_score(double elo) {
+    return 1 / (1 + std::pow(10, -elo / 400));
+}
+
+void ScoreStats::add(double score) {
+    matches++;
+    sum += score;
+    sum_squares += score * score;
+}
+
+double ScoreStats::mean() const {
+    return sum / (matches + VIRTUAL_MATCHES);
+}
+
+double ScoreStats::variance() const {
+    double m = mean();
+    return std::max(0.0, sum_squares / (matches + VIRTUAL_MATCHES) - m * m);
+}
+
+double ScoreStats::halfWidth(double z) const {
+    return z * std::sqrt(variance() / (matches + VIRTUAL_MATCHES));
+}
+
+Sprt::Sprt(double p_elo0, double p_elo1, double alpha, double beta)
+    : elo0(p_elo0),
+      elo1(p_elo1),
+      score0(elo_to_score(p_elo0)),
+      score1(elo_to_score(p_elo1)),
+      lower_bound(std::log(beta / (1 - alpha))),
+      upper_bound(std::log((1 - beta) / alpha)) {}
+
+double Sprt::llr(const ScoreStats& stats) const {
+    if (stats.getMatches() == 0 || stats.variance() == 0)
+        return 0;
+    return stats.getMatches() * (score1 - score0) *
+           (2 * stats.mean() - score0 - score1) / (2 * stats.variance());
+}
+
+Sprt::Decision Sprt::decide(const ScoreStats& stats) const {
+    double ratio = llr(stats);
+    if (ratio >= upper_bound)
+        return Decision::AcceptH1;
+    if (ratio <= lower_bound)
+        return Decision::AcceptH0;
+    return Decision::Continue;
+}
+
+}  // namespace Judge
@@ -0,0 +1,91 @@
+#include "timebudget.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <unistd.h>
+
+namespace Engine {
+
+// A bot waiting for the CPU on a loaded machine gets this many times its
+// remaining budget in wall-clock time, plus a fixed allowance for the pipe
+// round trip.
+constexpr int WALL_TIME_FACTOR = 3;
+constexpr int WALL_TIME_SLACK_MS = 100;
+
+TimeBudget::TimeBudget()
+    : limited(false),
+      pid(-1),
+      clock(),
+      has_clock(false),
+      remaining_us(0),
+      increment_us(0),
+      move_start_us(0),
+      last_move_us(0),
+      used_us(0),
+      moves(0) {}
+
+TimeBudget::TimeBudget(pid_t p_pid, int initial_ms, int increment_ms)
+    : TimeBudget() {
+    limited = true;
+    pid = p_pid;
+    remaining_us = initial_ms * 1000LL;
+    increment_us = increment_ms * 1000LL;
+    has_clock = (clock_getcpuclockid(pid, &clock) == 0);
+}
+
+long long TimeBudget::cpuTimeUs() const {
+    if (has_clock) {
+        timespec ts;
+        if (clock_gettime(clock, &ts) == 0)
+            return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+    }
+    // Fallback with clock-tick resolution: utime and stime are fields 14
+    // and 15 of /proc/<pid>/stat, counted after the parenthesized name.
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string contents((std::istreambuf_iterator<char>(stat)),
+                         std::istreambuf_iterator<char>());
+    size_t name_end = contents.rfind(')');
+    if (name_end == std::string::npos)
+        return move_start_us;
+    std::istringstream fields(contents.substr(name_end + 2));
+    std::string field;
+    for (int i = 3; i < 14; i++)
+        fields >> field;
+    long long utime = 0, stime = 0;
+    fields >> utime >> stime;
+    return (utime + stime) * 1000000LL / sysconf(_SC_CLK_TCK);
+}
+
+int TimeBudget::getWallTimeoutMs() const {
+    if (!limited)
+        return -1;
+    long long timeout =
+        std::max(0LL, getRemainingMs()) * WALL_TIME_FACTOR + WALL_TIME_SLACK_MS;
+    return static_cast<int>(std::min<long long>(timeout, INT_MAX));
+}
+
+void TimeBudget::startMove() {
+    if (limited)
+        move_start_us = cpuTimeUs();
+}
+
+bool TimeBudget::stopMove() {
+    if (!limited)
+        return true;
+    // A bot that has exited keeps its last reading.
+    last_move_us = std::max(0LL, cpuTimeUs() - move_start_us);
+    used_us += last_move_us;
+    remaining_us -= last_move_us;
+    moves++;
+    if (remaining_us < 0)
+        return false;
+    remaining_us += increment_us;
+    return true;
+}
+
+}  // namespace Engine
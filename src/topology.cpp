@@ -0,0 +1,152 @@
+#include "topology.h"
+#include "err.h"
+
+#include <dirent.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <utility>
+
+namespace Judge {
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        if (range.empty() || range == "\n")
+            continue;
+        int first, last;
+        char dash;
+        std::istringstream bounds(range);
+        if (!(bounds >> first))
+            continue;
+        if (bounds >> dash && dash == '-' && bounds >> last) {
+            for (int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        } else {
+            cpus.push_back(first);
+        }
+    }
+    return cpus;
+}
+
+static bool read_int(const std::string& path, int& value) {
+    std::ifstream file(path);
+    return static_cast<bool>(file >> value);
+}
+
+std::vector<CpuCore> detect_cpu_cores(const std::string& sysfs_cpu_root) {
+    std::ifstream online_file(sysfs_cpu_root + "/online");
+    std::string online;
+    std::getline(online_file, online);
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    SYSCALL_WITH_CHECK(sched_getaffinity(0, sizeof(allowed), &allowed));
+
+    std::map<std::pair<int, int>, CpuCore> cores;
+    for (int cpu : parse_cpu_list(online)) {
+        if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))
+            continue;
+        std::string topology =
+            sysfs_cpu_root + "/cpu" + std::to_string(cpu) + "/topology/";
+        int package = 0, core_id = cpu;
+        read_int(topology + "physical_package_id", package);
+        read_int(topology + "core_id", core_id);
+        CpuCore& core = cores[{package, core_id}];
+        core.package = package;
+        core.core_id = core_id;
+        core.cpus.push_back(cpu);
+    }
+
+    std::vector<CpuCore> result;
+    for (auto& [key, core] : cores) {
+        std::sort(core.cpus.begin(), core.cpus.end());
+        result.push_back(std::move(core));
+    }
+    return result;
+}
+
+std::vector<MatchSlot> plan_match_slots(const std::vector<CpuCore>& cores,
+                                        int players) {
+    std::vector<MatchSlot> slots;
+    bool smt = std::any_of(cores.begin(), cores.end(), [](const CpuCore& c) {
+        return c.cpus.size() > 1;
+    });
+
+    for (size_t begin = 0, end; begin < cores.size(); begin = end) {
+        end = begin;
+        while (end < cores.size() && cores[end].package == cores[begin].package)
+            end++;
+
+        size_t next = begin;
+        std::vector<int> judge_cpus;
+        if (!smt) {
+            if (end - begin < static_cast<size_t>(players) + 1)
+                continue;
+            judge_cpus = cores[next++].cpus;
+        }
+        for (; next + players <= end; next += players) {
+            MatchSlot slot;
+            for (size_t i = next; i < next + players; i++) {
+                slot.bot_cpus.push_back(cores[i].cpus[0]);
+                if (smt)
+                    slot.judge_cpus.insert(slot.judge_cpus.end(),
+                                           cores[i].cpus.begin() + 1,
+                                           cores[i].cpus.end());
+            }
+            // A slot of SMT and non-SMT cores has no idle siblings.
+            if (slot.judge_cpus.empty())
+                slot.judge_cpus = smt ? slot.bot_cpus : judge_cpus;
+            slots.push_back(std::move(slot));
+        }
+    }
+    return slots;
+}
+
+// Every thread has a mask of its own, and sched_setaffinity() sets one
+// thread's: a process is pinned by walking /proc/<pid>/task, again until a
+// walk finds no thread that was not pinned yet, as threads started
+// meanwhile may have inherited the old mask.
+void pin_to_cpus(pid_t pid, const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    if (pid == 0) {
+        SYSCALL_WITH_CHECK(sched_setaffinity(0, sizeof(set), &set));
+        return;
+    }
+    std::string tasks = "/proc/" + std::to_string(pid) + "/task";
+    std::set<pid_t> pinned;
+    for (bool found = true; found;) {
+        found = false;
+        DIR* dir = opendir(tasks.c_str());
+        // A bot may already be gone; the judge notices that elsewhere.
+        if (dir == nullptr) {
+            if (errno == ENOENT)
+                return;
+            syserr("Cannot list the threads of %d", pid);
+        }
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] == '.')
+                continue;
+            pid_t tid = atoi(entry->d_name);
+            if (!pinned.insert(tid).second)
+                continue;
+            found = true;
+            if (sched_setaffinity(tid, sizeof(set), &set) == -1 &&
+                errno != ESRCH)
+                syserr("Cannot pin %d to its CPUs", tid);
+        }
+        closedir(dir);
+    }
+}
+
+}  // namespace Judge
@@ -0,0 +1,180 @@
+#include "tournament.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <numeric>
+
+namespace Judge {
+
+std::vector<Pairing> round_robin_pairings(int bots) {
+    std::vector<Pairing> pairings;
+    if (bots < 2)
+        return pairings;
+    pairings.reserve(static_cast<size_t>(bots) * (bots - 1) / 2);
+
+    // Circle method: bot 0 stays in place, the rest rotate by one position
+    // every round. With an odd number of bots slot `bots` is a bye.
+    int slots = bots + bots % 2;
+    std::vector<int> circle(slots);
+    std::iota(circle.begin(), circle.end(), 0);
+    for (int round = 0; round < slots - 1; round++) {
+        for (int i = 0; i < slots / 2; i++) {
+            int bot1 = circle[i];
+            int bot2 = circle[slots - 1 - i];
+            if (bot1 >= bots || bot2 >= bots)
+                continue;
+            if ((round + i) % 2 == 0)
+                pairings.push_back({bot1, bot2});
+            else
+                pairings.push_back({bot2, bot1});
+        }
+        std::rotate(circle.begin() + 1, circle.end() - 1, circle.end());
+    }
+    return pairings;
+}
+
+Crosstable::Crosstable(int p_bots)
+    : bots(p_bots),
+      pair_scores(static_cast<size_t>(p_bots) * p_bots, 0.0),
+      pair_games(static_cast<size_t>(p_bots) * p_bots, 0),
+      total_scores(p_bots, 0.0),
+      total_games(p_bots, 0) {}
+
+void Crosstable::addResult(const Pairing& pairing,
+                           const std::vector<double>& scores) {
+    assert(scores.size() == 2);
+    std::lock_guard<std::mutex> lock(mutex);
+    int first = pairing.first, second = pairing.second;
+    pair_scores[first * bots + second] += scores[0];
+    pair_scores[second * bots + first] += scores[1];
+    pair_games[first * bots + second]++;
+    pair_games[second * bots + first]++;
+    total_scores[first] += scores[0];
+    total_scores[second] += scores[1];
+    total_games[first]++;
+    total_games[second]++;
+}
+
+void Crosstable::addBye(int bot, double score) {
+    std::lock_guard<std::mutex> lock(mutex);
+    total_scores[bot] += score;
+}
+
+double Crosstable::getScore(int bot) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_scores[bot];
+}
+
+double Crosstable::getScore(int bot, int opponent) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pair_scores[bot * bots + opponent];
+}
+
+int Crosstable::getGames(int bot) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_games[bot];
+}
+
+int Crosstable::getGames(int bot, int opponent) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pair_games[bot * bots + opponent];
+}
+
+void Crosstable::print(std::ostream& out,
+                       const std::vector<std::string>& names) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<int> ranking(bots);
+    std::iota(ranking.begin(), ranking.end(), 0);
+    std::stable_sort(ranking.begin(), ranking.end(), [this](int a, int b) {
+        return total_scores[a] > total_scores[b];
+    });
+
+    out << "Standings:" << std::endl;
+    for (int rank = 0; rank < bots; rank++) {
+        int bot = ranking[rank];
+        out << std::setw(4) << rank + 1 << ". Bot #" << bot << "("
+            << names[bot] << ") score " << total_scores[bot] << " in "
+            << total_games[bot] << " games" << std::endl;
+    }
+
+    out << "Crosstable:" << std::endl;
+    out << std::setw(5) << "";
+    for (int rank = 0; rank < bots; rank++)
+        out << std::setw(7) << rank + 1;
+    out << std::endl;
+    for (int row = 0; row < bots; row++) {
+        int bot = ranking[row];
+        out << std::setw(4) << row + 1 << ".";
+        for (int col = 0; col < bots; col++) {
+            int opponent = ranking[col];
+            if (bot == opponent || pair_games[bot * bots + opponent] == 0)
+                out << std::setw(7) << (bot == opponent ? "X" : ".");
+            else
+                out << std::setw(7) << pair_scores[bot * bots + opponent];
+        }
+        out << std::endl;
+    }
+}
+
+SwissPairer::SwissPairer(int p_bots)
+    : bots(p_bots),
+      bye(-1),
+      met(static_cast<size_t>(p_bots) * p_bots, 0),
+      had_bye(p_bots, 0),
+      first_seats(p_bots, 0) {}
+
+std::vector<Pairing> SwissPairer::nextRound(const Crosstable& table) {
+    std::vector<double> scores(bots);
+    for (int bot = 0; bot < bots; bot++)
+        scores[bot] = table.getScore(bot);
+    std::vector<int> ranking(bots);
+    std::iota(ranking.begin(), ranking.end(), 0);
+    std::stable_sort(ranking.begin(), ranking.end(),
+                     [&](int a, int b) { return scores[a] > scores[b]; });
+
+    bye = -1;
+    if (bots % 2 == 1) {
+        auto it = std::find_if(ranking.rbegin(), ranking.rend(),
+                               [this](int bot) { return !had_bye[bot]; });
+        bye = (it != ranking.rend() ? *it : ranking.back());
+        had_bye[bye] = 1;
+        ranking.erase(std::find(ranking.begin(), ranking.end(), bye));
+    }
+
+    std::vector<Pairing> pairings;
+    std::vector<char> paired(bots, 0);
+    for (size_t i = 0; i < ranking.size(); i++) {
+        int bot1 = ranking[i];
+        if (paired[bot1])
+            continue;
+        // Best-ranked fresh opponent; fall back to a rematch with the
+        // best-ranked free one when everybody left has been met.
+        int rematch = -1, opponent = -1;
+        for (size_t j = i + 1; j < ranking.size(); j++) {
+            int bot2 = ranking[j];
+            if (paired[bot2])
+                continue;
+            if (rematch == -1)
+                rematch = bot2;
+            if (!haveMet(bot1, bot2)) {
+                opponent = bot2;
+                break;
+            }
+        }
+        if (opponent == -1)
+            opponent = rematch;
+        assert(opponent != -1);
+
+        paired[bot1] = paired[opponent] = 1;
+        met[bot1 * bots + opponent] = met[opponent * bots + bot1] = 1;
+        Pairing pairing = first_seats[bot1] <= first_seats[opponent]
+                              ? Pairing{bot1, opponent}
+                              : Pairing{opponent, bot1};
+        first_seats[pairing.first]++;
+        pairings.push_back(pairing);
+    }
+    return pairings;
+}
+
+}  // namespace Judge
@@ -0,0 +1,234 @@
+#include "transcript.h"
+#include "err.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+namespace Judge {
+
+static bool read_number(std::string_view& data, uint64_t& number) {
+    number = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (data.empty())
+            return false;
+        unsigned char byte = data.front();
+        data.remove_prefix(1);
+        number |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool parse_transcript(std::string_view transcript,
+                      std::vector<TranscriptEvent>& events) {
+    while (!transcript.empty()) {
+        TranscriptEvent event;
+        event.kind = static_cast<TranscriptEvent::Kind>(transcript.front());
+        transcript.remove_prefix(1);
+        uint64_t number;
+        if (!read_number(transcript, number))
+            return false;
+        switch (event.kind) {
+            case TranscriptEvent::Output:
+            case TranscriptEvent::Input:
+                if (number > transcript.size())
+                    return false;
+                event.data = transcript.substr(0, number);
+                transcript.remove_prefix(number);
+                break;
+            case TranscriptEvent::OutputError:
+                event.errnum = static_cast<int>(number);
+                break;
+            case TranscriptEvent::Eof:
+                break;
+            default:
+                return false;
+        }
+        events.push_back(event);
+    }
+    return true;
+}
+
+// Lines are printed as they are, other bytes in \xNN form.
+static void describe_data(std::string& out,
+                          const char* prefix,
+                          std::string_view data,
+                          bool& line_start) {
+    for (char c : data) {
+        if (line_start)
+            out += prefix;
+        line_start = c == '\n';
+        if (c == '\n' || (c >= ' ' && c != '\\' && c < 0x7f)) {
+            out += c;
+        } else {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\x%02x",
+                     static_cast<unsigned char>(c));
+            out += escaped;
+        }
+    }
+}
+
+std::string describe_transcript(std::string_view transcript) {
+    std::vector<TranscriptEvent> events;
+    if (!parse_transcript(transcript, events))
+        return "malformed transcript\n";
+    std::string out;
+    TranscriptEvent::Kind last = TranscriptEvent::Eof;
+    bool line_start = true;
+    for (const TranscriptEvent& event : events) {
+        if (event.kind != last && !line_start) {
+            out += '\n';
+            line_start = true;
+        }
+        last = event.kind;
+        switch (event.kind) {
+            case TranscriptEvent::Output:
+                describe_data(out, "> ", event.data, line_start);
+                break;
+            case TranscriptEvent::Input:
+                describe_data(out, "< ", event.data, line_start);
+                break;
+            case TranscriptEvent::Eof:
+                out += "< EOF\n";
+                break;
+            case TranscriptEvent::OutputError:
+                out += "> error: ";
+                out += strerror(event.errnum);
+                out += '\n';
+                break;
+        }
+    }
+    if (!line_start)
+        out += '\n';
+    return out;
+}
+
+void TranscriptRecorder::appendEvent(TranscriptEvent::Kind kind,
+                                     uint64_t number) {
+    transcript += kind;
+    do {
+        unsigned char byte = number & 0x7f;
+        number >>= 7;
+        if (number != 0)
+            byte |= 0x80;
+        transcript += static_cast<char>(byte);
+    } while (number != 0);
+}
+
+void TranscriptRecorder::on_input(const char* buf, size_t len) {
+    if (len == 0) {
+        appendEvent(TranscriptEvent::Eof, 0);
+        return;
+    }
+    appendEvent(TranscriptEvent::Input, len);
+    transcript.append(buf, len);
+}
+
+void TranscriptRecorder::on_output(const iovec* iov,
+                                   int iovcnt,
+                                   size_t len) {
+    appendEvent(TranscriptEvent::Output, len);
+    for (int i = 0; i < iovcnt && len > 0; i++) {
+        size_t part = std::min(len, iov[i].iov_len);
+        transcript.append(static_cast<const char*>(iov[i].iov_base), part);
+        len -= part;
+    }
+}
+
+void TranscriptRecorder::on_output_error(int errnum) {
+    appendEvent(TranscriptEvent::OutputError, errnum);
+}
+
+ReplayTransport::ReplayTransport(std::string_view transcript)
+    : error_after(std::numeric_limits<size_t>::max()) {
+    std::vector<TranscriptEvent> events;
+    if (!parse_transcript(transcript, events))
+        fatal("malformed transcript");
+    for (const TranscriptEvent& event : events) {
+        switch (event.kind) {
+            case TranscriptEvent::Output:
+                expected_output += event.data;
+                break;
+            case TranscriptEvent::Input:
+                input.push_back({expected_output.size(), event.data, false});
+                break;
+            case TranscriptEvent::Eof:
+                input.push_back({expected_output.size(), {}, true});
+                break;
+            case TranscriptEvent::OutputError:
+                if (error_after == std::numeric_limits<size_t>::max()) {
+                    error_after = expected_output.size();
+                    error_errnum = event.errnum;
+                }
+                break;
+        }
+    }
+    SYSCALL_WITH_CHECK(event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+    updatePollFd();
+}
+
+ReplayTransport::~ReplayTransport() {
+    close(event_fd);
+}
+
+bool ReplayTransport::inputReady() const {
+    return next_chunk < input.size() && input[next_chunk].after <= written;
+}
+
+// The poll fd is readable exactly while read() has something to return.
+void ReplayTransport::updatePollFd() {
+    bool ready = inputReady();
+    if (ready == signalled)
+        return;
+    uint64_t value = 1;
+    if (ready) {
+        SYSCALL_WITH_CHECK(::write(event_fd, &value, sizeof(value)));
+    } else {
+        SYSCALL_WITH_CHECK(::read(event_fd, &value, sizeof(value)));
+    }
+    signalled = ready;
+}
+
+ssize_t ReplayTransport::read(char* buf, size_t len) {
+    size_t copied = 0;
+    while (copied < len && inputReady() && !input[next_chunk].eof) {
+        const Chunk& chunk = input[next_chunk];
+        size_t part = std::min(len - copied, chunk.data.size() - chunk_offset);
+        memcpy(buf + copied, chunk.data.data() + chunk_offset, part);
+        copied += part;
+        chunk_offset += part;
+        if (chunk_offset == chunk.data.size()) {
+            next_chunk++;
+            chunk_offset = 0;
+        }
+    }
+    if (copied > 0 || (inputReady() && input[next_chunk].eof)) {
+        updatePollFd();
+        return copied;
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+ssize_t ReplayTransport::write(const char* buf, size_t len) {
+    if (written >= error_after) {
+        errno = error_errnum;
+        return -1;
+    }
+    len = std::min(len, error_after - written);
+    if (written + len > expected_output.size() ||
+        memcmp(buf, expected_output.data() + written, len) != 0)
+        diverged = true;
+    written += len;
+    updatePollFd();
+    return len;
+}
+
+}  // namespace Judge
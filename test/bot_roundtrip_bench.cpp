@@ -0,0 +1,145 @@
+// Round-trip latency of one command and its answer, as the judge sees it:
+// the time from sending "MOVE" until the bot's reply line has been read.
+// The bot is a forked child that answers every line right away, written
+// either the way the example bots used to be (getline and endl on the
+// synced standard streams) or with the bot SDK, over pipes and over the
+// shared-memory transport.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "botsdk.h"
+#include "common.h"
+#include "err.h"
+#include "playerstream.h"
+#include "shmtransport.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int WARMUP = 1000;
+constexpr int ITERATIONS = 20000;
+
+void bot_iostream() {
+    std::string command;
+    while (std::getline(std::cin, command))
+        std::cout << "ROCK" << std::endl;
+}
+
+void bot_sdk(Bot::Connection& judge) {
+    std::string_view command;
+    while (judge.readLine(command))
+        judge.reply("ROCK");
+}
+
+// The bot's stdin and stdout.
+struct BotPipes {
+    BotPipes() {
+        Judge::make_cloexec_pipe(in);
+        Judge::make_cloexec_pipe(out);
+    }
+    int in[2];
+    int out[2];
+};
+
+// Starts `bot` in a child with its stdin and stdout on `pipes`, of which
+// the judge keeps only its own ends.
+template <class BotMain>
+pid_t fork_bot(BotPipes& pipes, BotMain bot) {
+    pid_t pid = fork();
+    if (pid == -1)
+        syserr("fork");
+    if (pid == 0) {
+        SYSCALL_WITH_CHECK(dup2(pipes.in[PIPE_READ_END], STDIN_FILENO));
+        SYSCALL_WITH_CHECK(dup2(pipes.out[PIPE_WRITE_END], STDOUT_FILENO));
+        close(pipes.in[PIPE_WRITE_END]);
+        close(pipes.out[PIPE_READ_END]);
+        bot();
+        _exit(0);
+    }
+    close(pipes.in[PIPE_READ_END]);
+    close(pipes.out[PIPE_WRITE_END]);
+    return pid;
+}
+
+void measure(const char* method, playerstream& stream) {
+    std::vector<double> latencies_us;
+    std::string reply;
+    for (int i = 0; i < WARMUP + ITERATIONS; i++) {
+        auto start = Clock::now();
+        stream << "MOVE" << std::endl;
+        if (!std::getline(stream, reply))
+            fatal("%s: the bot did not answer", method);
+        auto elapsed = Clock::now() - start;
+        if (i >= WARMUP)
+            latencies_us.push_back(
+                std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+    std::sort(latencies_us.begin(), latencies_us.end());
+    double sum = 0;
+    for (double latency : latencies_us)
+        sum += latency;
+    printf(
+        "benchmark=bot_roundtrip method=%s n=%d mean_us=%.2f p50_us=%.2f "
+        "p99_us=%.2f\n",
+        method, ITERATIONS, sum / ITERATIONS, latencies_us[ITERATIONS / 2],
+        latencies_us[ITERATIONS * 99 / 100]);
+}
+
+template <class BotMain>
+void run_pipes(const char* method, BotMain bot) {
+    BotPipes pipes;
+    pid_t pid = fork_bot(pipes, bot);
+    {
+        playerstream stream(pipes.out[PIPE_READ_END],
+                            pipes.in[PIPE_WRITE_END]);
+        measure(method, stream);
+    }
+    close(pipes.in[PIPE_WRITE_END]);
+    close(pipes.out[PIPE_READ_END]);
+    waitpid(pid, nullptr, 0);
+}
+
+void run_shm() {
+    BotPipes pipes;
+    auto transport =
+        std::make_shared<Judge::ShmTransport>(pipes.out[PIPE_READ_END]);
+    pid_t pid = fork_bot(pipes, [&transport] {
+        std::vector<Judge::FdMapping> fds = transport->getChildFds();
+        Bot::Connection judge(std::unique_ptr<Bot::ShmChannel>(
+            new Bot::ShmChannel(fds[0].parent_fd, fds[1].parent_fd,
+                                fds[2].parent_fd)));
+        bot_sdk(judge);
+    });
+    {
+        playerstream stream(transport);
+        measure("sdk_shm", stream);
+    }
+    // The bot notices the hangup on its stdin.
+    close(pipes.in[PIPE_WRITE_END]);
+    waitpid(pid, nullptr, 0);
+    transport.reset();
+    close(pipes.out[PIPE_READ_END]);
+}
+
+}  // namespace
+
+int main() {
+    playerstream_base::ignore_sigpipe();
+    run_pipes("iostream_pipe", bot_iostream);
+    run_pipes("sdk_pipe", [] {
+        Bot::Connection judge(STDIN_FILENO, STDOUT_FILENO);
+        bot_sdk(judge);
+    });
+    run_shm();
+    return 0;
+}
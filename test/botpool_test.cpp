@@ -0,0 +1,175 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "botpool.h"
+#include "err.h"
+#include "launcher.h"
+
+namespace {
+
+using Judge::BotPool;
+using Judge::BotProcess;
+
+// Answers NEWGAME with READY and otherwise does what it is told: SEED
+// prints its seed, SLOW answers late, and EXIT exits.
+const char RESETTING_BOT[] =
+    "#!/bin/sh\n"
+    "seed=$1\n"
+    "while read command arg; do\n"
+    "    case $command in\n"
+    "        NEWGAME) seed=$arg; echo READY ;;\n"
+    "        SEED) echo $seed ;;\n"
+    "        SLOW) sleep 0.2; echo LATE ;;\n"
+    "        EXIT) exit 0 ;;\n"
+    "    esac\n"
+    "done\n";
+
+// Does not know NEWGAME and says nothing.
+const char SILENT_BOT[] =
+    "#!/bin/sh\n"
+    "while read line; do :; done\n";
+
+class BotPoolTest : public ::testing::Test {
+   protected:
+    BotPoolTest() {
+        char dir_template[] = "/tmp/botpool_test.XXXXXX";
+        if (mkdtemp(dir_template) == nullptr)
+            syserr("mkdtemp");
+        dir = dir_template;
+        resetting = writeBot("resetting", RESETTING_BOT);
+        silent = writeBot("silent", SILENT_BOT);
+    }
+
+    ~BotPoolTest() {
+        unlink(resetting.c_str());
+        unlink(silent.c_str());
+        rmdir(dir.c_str());
+    }
+
+    std::string writeBot(const std::string& name, const char* script) {
+        std::string path = dir + "/" + name;
+        std::ofstream(path) << script;
+        SYSCALL_WITH_CHECK(chmod(path.c_str(), 0700));
+        return path;
+    }
+
+    std::unique_ptr<BotProcess> spawn(const std::string& program,
+                                      unsigned seed) {
+        int err_fd;
+        SYSCALL_WITH_CHECK(err_fd =
+                               open("/dev/null", O_WRONLY | O_CLOEXEC));
+        return Judge::spawn_bot(program, seed, err_fd, false);
+    }
+
+    static void send(BotProcess& bot, const std::string& line) {
+        std::string data = line + "\n";
+        ASSERT_EQ(write(bot.write_fd, data.data(), data.size()),
+                  static_cast<ssize_t>(data.size()));
+    }
+
+    static std::string receive(BotProcess& bot) {
+        std::string line;
+        char c;
+        while (read(bot.read_fd, &c, 1) == 1 && c != '\n')
+            line += c;
+        return line;
+    }
+
+    std::string dir;
+    std::string resetting;
+    std::string silent;
+};
+
+TEST_F(BotPoolTest, ResetsAReleasedBotForTheNextGame) {
+    BotPool pool(1000);
+    std::unique_ptr<BotProcess> bot = spawn(resetting, 1);
+    pid_t pid = bot->process.pid;
+    send(*bot, "SEED");
+    EXPECT_EQ(receive(*bot), "1");
+    pool.release(std::move(bot));
+    bot = pool.acquire(resetting, 2);
+    ASSERT_NE(bot, nullptr);
+    EXPECT_EQ(bot->process.pid, pid);
+    EXPECT_EQ(bot->matches_played, 1);
+    send(*bot, "SEED");
+    EXPECT_EQ(receive(*bot), "2");
+    // Nothing else is idle.
+    EXPECT_EQ(pool.acquire(resetting, 3), nullptr);
+    pool.release(std::move(bot));
+}
+
+TEST_F(BotPoolTest, ReplacesABotThatCrashed) {
+    BotPool pool(1000);
+    std::unique_ptr<BotProcess> bot = spawn(resetting, 1);
+    pool.release(std::move(bot));
+    bot = pool.acquire(resetting, 2);
+    ASSERT_NE(bot, nullptr);
+    send(*bot, "EXIT");
+    while (Judge::is_running(bot->process))
+        usleep(1000);
+    pool.release(std::move(bot));
+    // The dead bot is dropped, and the caller starts a fresh one.
+    EXPECT_EQ(pool.acquire(resetting, 3), nullptr);
+    // The program still supports resets, so the fresh one is pooled.
+    pool.release(spawn(resetting, 3));
+    bot = pool.acquire(resetting, 4);
+    ASSERT_NE(bot, nullptr);
+    send(*bot, "SEED");
+    EXPECT_EQ(receive(*bot), "4");
+    pool.release(std::move(bot));
+}
+
+TEST_F(BotPoolTest, KeepsPoolingAProgramWhoseFirstBotCrashed) {
+    BotPool pool(1000);
+    std::unique_ptr<BotProcess> bot = spawn(resetting, 1);
+    // It dies in its first game, before it was ever reset.
+    send(*bot, "EXIT");
+    while (Judge::is_running(bot->process))
+        usleep(1000);
+    pool.release(std::move(bot));
+    EXPECT_EQ(pool.acquire(resetting, 2), nullptr);
+    // The program is not taken for one that ignores NEWGAME.
+    pool.release(spawn(resetting, 2));
+    bot = pool.acquire(resetting, 3);
+    ASSERT_NE(bot, nullptr);
+    send(*bot, "SEED");
+    EXPECT_EQ(receive(*bot), "3");
+    pool.release(std::move(bot));
+}
+
+TEST_F(BotPoolTest, SkipsTheLateReplyOfTheLastGame) {
+    BotPool pool(1000);
+    std::unique_ptr<BotProcess> bot = spawn(resetting, 1);
+    // The engine gave up waiting for this reply, and the game ended.
+    send(*bot, "SLOW");
+    pool.release(std::move(bot));
+    bot = pool.acquire(resetting, 2);
+    ASSERT_NE(bot, nullptr);
+    // LATE came before READY and was skipped.
+    send(*bot, "SEED");
+    EXPECT_EQ(receive(*bot), "2");
+    pool.release(std::move(bot));
+}
+
+TEST_F(BotPoolTest, StopsPoolingProgramsThatDoNotAnswerNewgame) {
+    BotPool pool(100);
+    pool.release(spawn(silent, 1));
+    // The probe times out and the bot is terminated.
+    EXPECT_EQ(pool.acquire(silent, 2), nullptr);
+    // Others of the program are terminated, not probed again.
+    std::unique_ptr<BotProcess> bot = spawn(silent, 2);
+    pid_t pid = bot->process.pid;
+    pool.release(std::move(bot));
+    EXPECT_EQ(kill(pid, 0), -1);
+    EXPECT_EQ(pool.acquire(silent, 3), nullptr);
+}
+
+}  // namespace
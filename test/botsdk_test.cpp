@@ -0,0 +1,158 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "botsdk.h"
+#include "common.h"
+#include "err.h"
+
+namespace {
+
+// A connection whose judge side is driven by the test through pipes.
+class ConnectionTest : public ::testing::Test {
+   protected:
+    ConnectionTest() {
+        SYSCALL_WITH_CHECK(pipe(toBot));
+        SYSCALL_WITH_CHECK(pipe(fromBot));
+        SYSCALL_WITH_CHECK(fcntl(fromBot[PIPE_READ_END], F_SETFL, O_NONBLOCK));
+        bot.reset(
+            new Bot::Connection(toBot[PIPE_READ_END], fromBot[PIPE_WRITE_END]));
+    }
+
+    ~ConnectionTest() {
+        bot.reset();
+        for (int fd : {toBot[0], toBot[1], fromBot[0], fromBot[1]})
+            if (fd != -1)
+                close(fd);
+    }
+
+    void Send(const std::string& msg) {
+        ASSERT_EQ(static_cast<ssize_t>(msg.size()),
+                  write(toBot[PIPE_WRITE_END], msg.data(), msg.size()));
+    }
+
+    void JudgeExits() {
+        close(toBot[PIPE_WRITE_END]);
+        toBot[PIPE_WRITE_END] = -1;
+    }
+
+    std::string Received() {
+        std::string result;
+        char buf[4096];
+        ssize_t readCount;
+        while ((readCount = read(fromBot[PIPE_READ_END], buf, sizeof(buf))) >
+               0)
+            result.append(buf, readCount);
+        return result;
+    }
+
+    int toBot[2];
+    int fromBot[2];
+    std::unique_ptr<Bot::Connection> bot;
+};
+
+TEST_F(ConnectionTest, TestLinesArrivingTogetherAreSplit) {
+    Send("MOVE\nNEWGAME 42\n\nMO");
+    std::string_view line;
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, "MOVE");
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, "NEWGAME 42");
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, "");
+    Send("VE\n");
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, "MOVE");
+}
+
+TEST_F(ConnectionTest, TestEofAfterTheLastLine) {
+    Send("MOVE\nunterminated");
+    JudgeExits();
+    std::string_view line;
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, "MOVE");
+    EXPECT_FALSE(bot->readLine(line));
+}
+
+TEST_F(ConnectionTest, TestLinesLongerThanTheBuffer) {
+    std::string longLine(3 * Bot::Connection::BUF_SIZE + 5, 'x');
+    // Fill the pipe from another thread; it holds less than the line.
+    std::thread judge([&] { Send("short\n" + longLine + "\nMOVE\n"); });
+    std::string_view line;
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, "short");
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, longLine);
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, "MOVE");
+    judge.join();
+}
+
+TEST_F(ConnectionTest, TestOutputLeavesOnlyOnFlush) {
+    bot->write("SCORE ");
+    bot->write(-17LL);
+    bot->writeLine("");
+    EXPECT_EQ(Received(), "");
+    EXPECT_TRUE(bot->flush());
+    EXPECT_EQ(Received(), "SCORE -17\n");
+    EXPECT_TRUE(bot->reply("ROCK"));
+    EXPECT_EQ(Received(), "ROCK\n");
+}
+
+TEST_F(ConnectionTest, TestWritesLargerThanTheBuffer) {
+    std::string big(Bot::Connection::BUF_SIZE + 1, 'y');
+    std::thread reader([&] {
+        std::string received;
+        while (received.size() < big.size() + 2) {
+            std::string chunk = Received();
+            received += chunk;
+        }
+        EXPECT_EQ(received, "a" + big + "\n");
+    });
+    bot->write("a");
+    EXPECT_TRUE(bot->reply(big));
+    reader.join();
+}
+
+TEST_F(ConnectionTest, TestFramesRoundTrip) {
+    std::string binary("\0\n\x01\x02", 4);
+    std::string header("\x04\0\0\0", 4);
+    Send(header + binary + "MOVE\n" + header.substr(0, 2));
+    std::string_view frame;
+    ASSERT_TRUE(bot->readFrame(frame));
+    EXPECT_EQ(frame, binary);
+    std::string_view line;
+    ASSERT_TRUE(bot->readLine(line));
+    EXPECT_EQ(line, "MOVE");
+    Send(header.substr(2) + "abcd");
+    ASSERT_TRUE(bot->readFrame(frame));
+    EXPECT_EQ(frame, "abcd");
+
+    bot->writeFrame(binary);
+    bot->flush();
+    EXPECT_EQ(Received(), header + binary);
+}
+
+TEST_F(ConnectionTest, TestOversizedFrameIsRejected) {
+    bot->setMaxFrameSize(3);
+    Send(std::string("\x04\0\0\0abcd", 8));
+    std::string_view frame;
+    EXPECT_FALSE(bot->readFrame(frame));
+}
+
+TEST(BotSdkTest, TestParseInt) {
+    long long value;
+    EXPECT_TRUE(Bot::parse_int("12345", value));
+    EXPECT_EQ(value, 12345);
+    EXPECT_TRUE(Bot::parse_int("-3", value));
+    EXPECT_EQ(value, -3);
+    EXPECT_FALSE(Bot::parse_int("12x", value));
+    EXPECT_FALSE(Bot::parse_int("", value));
+}
+
+}  // namespace
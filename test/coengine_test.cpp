@@ -0,0 +1,208 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "coengine.h"
+#include "common.h"
+#include "err.h"
+
+namespace {
+
+using Engine::exchange_async;
+using Engine::GameResult;
+using Engine::PlayerData;
+using Engine::Reactor;
+using Engine::Reply;
+using Engine::Task;
+
+// Two players over pipes; the test writes their replies.
+class PipeMatch {
+   public:
+    PipeMatch() {
+        for (int id = 0; id < 2; id++) {
+            int to_player[2], from_player[2];
+            SYSCALL_WITH_CHECK(pipe(to_player));
+            SYSCALL_WITH_CHECK(pipe(from_player));
+            players.emplace_back(from_player[PIPE_READ_END],
+                                 to_player[PIPE_WRITE_END], -1, "bot", id);
+            reply_fds.push_back(from_player[PIPE_WRITE_END]);
+            request_fds.push_back(to_player[PIPE_READ_END]);
+            fds.insert(fds.end(), {to_player[0], to_player[1],
+                                   from_player[0], from_player[1]});
+        }
+    }
+
+    ~PipeMatch() {
+        players.clear();
+        for (int fd : fds)
+            close(fd);
+    }
+
+    void reply(int id, const std::string& line) {
+        std::string data = line + "\n";
+        EXPECT_EQ(write(reply_fds[id], data.data(), data.size()),
+                  static_cast<ssize_t>(data.size()));
+    }
+
+    // What player `id` was sent since the last call, without waiting.
+    std::string requests(int id) {
+        SYSCALL_WITH_CHECK(fcntl(request_fds[id], F_SETFL, O_NONBLOCK));
+        std::string sent;
+        char buf[4096];
+        ssize_t rv;
+        while ((rv = read(request_fds[id], buf, sizeof(buf))) > 0)
+            sent.append(buf, rv);
+        return sent;
+    }
+
+    std::vector<PlayerData> players;
+
+   private:
+    std::vector<int> reply_fds;
+    std::vector<int> request_fds;
+    std::vector<int> fds;
+};
+
+Task<int> add(int a, int b) {
+    co_return a + b;
+}
+
+Task<int> add_twice(int a) {
+    int sum = co_await add(a, a);
+    co_return sum + co_await add(1, 0);
+}
+
+Task<std::vector<Reply>> ask(std::vector<PlayerData>& players,
+                             int rounds,
+                             int timeout_ms) {
+    std::vector<Reply> replies;
+    for (int round = 0; round < rounds; round++)
+        replies = co_await exchange_async(players, "MOVE", timeout_ms);
+    co_return replies;
+}
+
+Task<std::vector<Reply>> tell(std::vector<PlayerData>& players,
+                              std::string message) {
+    co_return co_await exchange_async(players, message, 1000);
+}
+
+Task<GameResult> draw_after_move(std::vector<PlayerData>& players) {
+    std::vector<Reply> replies = co_await exchange_async(players, "MOVE", 1000);
+    co_return GameResult::createDraw(players,
+                                     replies[0].line + "-" + replies[1].line);
+}
+
+TEST(CoEngineTest, TestNestedTasksReturnTheirValues) {
+    Reactor reactor;
+    int result = 0;
+    reactor.spawn<int>(add_twice(3), [&](int value) { result = value; });
+    EXPECT_EQ(result, 7);
+    EXPECT_EQ(reactor.tasks(), 0u);
+    EXPECT_FALSE(reactor.runOnce());
+}
+
+TEST(CoEngineTest, TestExchangeSuspendsUntilRepliesArrive) {
+    PipeMatch match;
+    Reactor reactor;
+    std::vector<Reply> replies;
+    reactor.spawn<std::vector<Reply>>(
+        ask(match.players, 1, 1000),
+        [&](std::vector<Reply> result) { replies = std::move(result); });
+    EXPECT_EQ(reactor.tasks(), 1u);
+
+    match.reply(0, "ROCK");
+    EXPECT_TRUE(reactor.runOnce());
+    EXPECT_EQ(reactor.tasks(), 1u);
+    match.reply(1, "PAPER");
+    reactor.run();
+    EXPECT_EQ(reactor.tasks(), 0u);
+    ASSERT_EQ(replies.size(), 2u);
+    EXPECT_TRUE(replies[0].ok());
+    EXPECT_EQ(replies[0].line, "ROCK");
+    EXPECT_TRUE(replies[1].ok());
+    EXPECT_EQ(replies[1].line, "PAPER");
+}
+
+TEST(CoEngineTest, TestSilentPlayerTimesOut) {
+    PipeMatch match;
+    match.reply(0, "ROCK");
+    Reactor reactor;
+    std::vector<Reply> replies;
+    reactor.spawn<std::vector<Reply>>(
+        ask(match.players, 1, 50),
+        [&](std::vector<Reply> result) { replies = std::move(result); });
+    reactor.run();
+    ASSERT_EQ(replies.size(), 2u);
+    EXPECT_TRUE(replies[0].ok());
+    EXPECT_EQ(replies[1].status, Reply::Timeout);
+    EXPECT_EQ(match.players[1].playerStream().get_response_times().timeouts(),
+              1u);
+}
+
+TEST(CoEngineTest, TestLongMessageIsSentAsPlayersReadIt) {
+    PipeMatch match;
+    match.reply(0, "ROCK");
+    match.reply(1, "PAPER");
+    // More than a pipe holds.
+    std::string message(1 << 18, 'x');
+    Reactor reactor;
+    std::vector<Reply> replies;
+    reactor.spawn<std::vector<Reply>>(
+        tell(match.players, message),
+        [&](std::vector<Reply> result) { replies = std::move(result); });
+    // The reactor thread did not wait for the players to read.
+    EXPECT_EQ(reactor.tasks(), 1u);
+    std::string received[2];
+    while (reactor.tasks() > 0) {
+        for (int id = 0; id < 2; id++)
+            received[id] += match.requests(id);
+        reactor.runOnce();
+    }
+    for (int id = 0; id < 2; id++)
+        EXPECT_EQ(received[id] + match.requests(id), message + "\n");
+    ASSERT_EQ(replies.size(), 2u);
+    EXPECT_EQ(replies[0].line, "ROCK");
+    EXPECT_EQ(replies[1].line, "PAPER");
+}
+
+TEST(CoEngineTest, TestOneReactorDrivesManyMatches) {
+    constexpr int MATCHES = 50;
+    constexpr int ROUNDS = 3;
+    std::vector<std::unique_ptr<PipeMatch>> matches;
+    Reactor reactor;
+    int finished = 0;
+    for (int i = 0; i < MATCHES; i++) {
+        matches.push_back(std::make_unique<PipeMatch>());
+        reactor.spawn<std::vector<Reply>>(
+            ask(matches.back()->players, ROUNDS, 1000),
+            [&](std::vector<Reply> replies) {
+                EXPECT_TRUE(replies[0].ok() && replies[1].ok());
+                finished++;
+            });
+    }
+    EXPECT_EQ(reactor.tasks(), static_cast<size_t>(MATCHES));
+    // The bots answer in reverse order, after all matches have asked.
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = MATCHES - 1; i >= 0; i--) {
+            matches[i]->reply(0, "ROCK");
+            matches[i]->reply(1, "SCISSORS");
+        }
+    }
+    reactor.run();
+    EXPECT_EQ(finished, MATCHES);
+}
+
+TEST(CoEngineTest, TestRunBlockingPlaysAMatch) {
+    PipeMatch match;
+    match.reply(0, "ROCK");
+    match.reply(1, "PAPER");
+    GameResult result = Engine::run_blocking(draw_after_move(match.players));
+    EXPECT_EQ(result.pretty_result, "Draw [ROCK-PAPER]");
+}
+
+}  // namespace
@@ -0,0 +1,268 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "coordinator.h"
+#include "engine.h"
+
+namespace {
+
+using Engine::GameResult;
+using Judge::Coordinator;
+using Judge::RemoteMatch;
+using Judge::RemoteResult;
+using Judge::WorkerClient;
+
+std::vector<RemoteMatch> make_matches(int count) {
+    std::vector<RemoteMatch> matches;
+    for (int i = 0; i < count; i++)
+        matches.push_back({i, 100 + i, i, "rsp", {"bot a", "bot b"}});
+    return matches;
+}
+
+// Forks a worker that plays every match it gets by reporting a win of the
+// first bot worth the battle id, and exits once the run is over. It
+// leaves without a word after `give_up_after` matches, if not -1, and
+// connects once it can read from `start_fd`, if not -1.
+pid_t fork_worker(const std::string& address,
+                  std::vector<std::string> games = {"rsp"},
+                  int batch = 2,
+                  int give_up_after = -1,
+                  int start_fd = -1,
+                  const std::string& token = "secret") {
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+    char start;
+    if (start_fd != -1 && read(start_fd, &start, 1) != 1)
+        _exit(4);
+    WorkerClient client(address, games, token);
+    if (client.getRunSeed() != 42)
+        _exit(2);
+    int played = 0;
+    while (auto match = client.next(batch)) {
+        if (played++ == give_up_after)
+            _exit(0);
+        if (match->programs != std::vector<std::string>{"bot a", "bot b"} ||
+            match->round != match->battle_id - 100)
+            _exit(3);
+        client.sendResult({static_cast<uint64_t>(match->job_id),
+                           GameResult::Win, 1000,
+                           {static_cast<double>(match->battle_id), 0.5},
+                           "details\twith a tab"});
+    }
+    _exit(0);
+}
+
+int wait_for(pid_t pid) {
+    int status;
+    EXPECT_EQ(waitpid(pid, &status, 0), pid);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+class CoordinatorTest : public ::testing::Test {
+   protected:
+    CoordinatorTest()
+        : address("unix:/tmp/coordinator_test." + std::to_string(getpid())) {}
+
+    std::string address;
+};
+
+TEST_F(CoordinatorTest, PlaysEveryMatchOnTheWorkers) {
+    Coordinator coordinator(address, 42, {"rsp"}, 60 * 1000, "secret");
+    std::vector<pid_t> workers = {fork_worker(address),
+                                  fork_worker(address, {"other", "rsp"}, 3)};
+    std::map<int, int> reported;
+    std::vector<RemoteMatch> matches = make_matches(20);
+    coordinator.run(matches, [&](const RemoteMatch& match,
+                                 const RemoteResult& result,
+                                 const std::string& worker) {
+        reported[match.job_id]++;
+        EXPECT_EQ(result.type, GameResult::Win);
+        EXPECT_EQ(result.game_us, 1000);
+        EXPECT_EQ(result.scores,
+                  (std::vector<double>{double(match.battle_id), 0.5}));
+        // Tabs would split the field.
+        EXPECT_EQ(result.details, "details with a tab");
+        EXPECT_EQ(worker.substr(0, 6), "local#");
+        return true;
+    });
+    EXPECT_EQ(reported.size(), 20u);
+    for (const auto& [job_id, times] : reported)
+        EXPECT_EQ(times, 1) << job_id;
+    EXPECT_EQ(coordinator.getRequeued(), 0);
+    coordinator.finish();
+    for (pid_t worker : workers)
+        EXPECT_EQ(wait_for(worker), 0);
+}
+
+TEST_F(CoordinatorTest, RequeuesTheMatchesOfALostWorker) {
+    Coordinator coordinator(address, 42, {"rsp"}, 60 * 1000, "secret");
+    // It takes 5 matches and leaves after playing 1; the other worker
+    // comes once it has.
+    pid_t quitter = fork_worker(address, {"rsp"}, 5, 1);
+    pid_t worker = -1;
+    int reported = 0;
+    coordinator.run(make_matches(10), [&](const RemoteMatch&,
+                                          const RemoteResult&,
+                                          const std::string&) {
+        if (reported++ == 0)
+            worker = fork_worker(address);
+        return true;
+    });
+    EXPECT_EQ(wait_for(quitter), 0);
+    EXPECT_EQ(reported, 10);
+    EXPECT_EQ(coordinator.getRequeued(), 4);
+    coordinator.finish();
+    EXPECT_EQ(wait_for(worker), 0);
+}
+
+TEST_F(CoordinatorTest, RequeuesTheMatchesOfAStalledWorker) {
+    Coordinator coordinator(address, 42, {"rsp"}, 50, "secret");
+    int started[2];
+    ASSERT_EQ(pipe(started), 0);
+    // It takes every match and never reports one; the other worker comes
+    // once it has them.
+    pid_t staller = fork();
+    if (staller == 0) {
+        WorkerClient client(address, {"rsp"}, "secret");
+        client.next(5);
+        if (write(started[1], "!", 1) != 1)
+            _exit(4);
+        pause();
+        _exit(0);
+    }
+    pid_t worker = fork_worker(address, {"rsp"}, 2, -1, started[0]);
+    int reported = 0;
+    coordinator.run(make_matches(5), [&](const RemoteMatch&,
+                                         const RemoteResult&,
+                                         const std::string&) {
+        reported++;
+        return true;
+    });
+    EXPECT_EQ(reported, 5);
+    EXPECT_EQ(coordinator.getRequeued(), 5);
+    coordinator.finish();
+    EXPECT_EQ(wait_for(worker), 0);
+    kill(staller, SIGKILL);
+    EXPECT_EQ(wait_for(staller), -1);
+    close(started[0]);
+    close(started[1]);
+}
+
+TEST_F(CoordinatorTest, KeepsWorkersBetweenRuns) {
+    Coordinator coordinator(address, 42, {"rsp"}, 60 * 1000, "secret");
+    pid_t worker = fork_worker(address);
+    int reported = 0;
+    coordinator.run(make_matches(10), [&](const RemoteMatch&,
+                                          const RemoteResult&,
+                                          const std::string&) {
+        return ++reported < 3;
+    });
+    EXPECT_EQ(reported, 3);
+    std::vector<RemoteMatch> second = make_matches(4);
+    std::map<int, int> reported_second;
+    coordinator.run(second, [&](const RemoteMatch& match,
+                                const RemoteResult& result,
+                                const std::string&) {
+        // Late results of the first run must not show up here.
+        EXPECT_EQ(result.scores[0], match.battle_id);
+        reported_second[match.job_id]++;
+        return true;
+    });
+    EXPECT_EQ(reported_second.size(), 4u);
+    coordinator.finish();
+    EXPECT_EQ(wait_for(worker), 0);
+}
+
+TEST_F(CoordinatorTest, RefusesWorkersWithoutTheGames) {
+    Coordinator coordinator(address, 42, {"rsp"}, 60 * 1000, "secret");
+    pid_t refused = fork_worker(address, {"chess"});
+    pid_t worker = fork_worker(address);
+    int reported = 0;
+    coordinator.run(make_matches(3), [&](const RemoteMatch&,
+                                         const RemoteResult&,
+                                         const std::string&) {
+        reported++;
+        return true;
+    });
+    EXPECT_EQ(reported, 3);
+    coordinator.finish();
+    EXPECT_EQ(wait_for(refused), 1);
+    EXPECT_EQ(wait_for(worker), 0);
+}
+
+TEST_F(CoordinatorTest, TakesOverAStaleSocketOnly) {
+    // A socket file nobody listens on, as a crashed coordinator leaves.
+    std::string path = address.substr(5);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_NE(fd, -1);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    ASSERT_EQ(close(fd), 0);
+    Coordinator coordinator(address, 42, {"rsp"}, 60 * 1000, "secret");
+    EXPECT_EXIT(Coordinator(address, 42, {"rsp"}, 60 * 1000, "secret"),
+                ::testing::ExitedWithCode(1), "another coordinator");
+}
+
+TEST_F(CoordinatorTest, RefusesWorkersWithoutTheToken) {
+    Coordinator coordinator(address, 42, {"rsp"}, 60 * 1000, "secret");
+    pid_t refused = fork_worker(address, {"rsp"}, 2, -1, -1, "guess");
+    pid_t worker = fork_worker(address);
+    int reported = 0;
+    coordinator.run(make_matches(3), [&](const RemoteMatch&,
+                                         const RemoteResult&,
+                                         const std::string&) {
+        reported++;
+        return true;
+    });
+    EXPECT_EQ(reported, 3);
+    coordinator.finish();
+    EXPECT_EQ(wait_for(refused), 1);
+    EXPECT_EQ(wait_for(worker), 0);
+}
+
+TEST(CoordinatorDeathTest, NeedsATokenToListenBeyondThisHost) {
+    EXPECT_EXIT(Coordinator("0.0.0.0:0", 42, {"rsp"}, 60 * 1000, ""),
+                ::testing::ExitedWithCode(1), "BOTS_JUDGE_TOKEN");
+}
+
+TEST_F(CoordinatorTest, ListensOnLoopbackWithoutAHost) {
+    Coordinator coordinator(":0", 42, {"rsp"}, 60 * 1000, "");
+    const std::string& bound = coordinator.getAddress();
+    EXPECT_TRUE(bound.substr(0, 10) == "127.0.0.1:" ||
+                bound.substr(0, 6) == "[::1]:")
+        << bound;
+}
+
+TEST_F(CoordinatorTest, ListensOnAnyFreeTcpPort) {
+    Coordinator coordinator("127.0.0.1:0", 42, {"rsp"}, 60 * 1000, "secret");
+    const std::string& bound = coordinator.getAddress();
+    ASSERT_EQ(bound.substr(0, 10), "127.0.0.1:");
+    EXPECT_NE(bound, "127.0.0.1:0");
+    pid_t worker = fork_worker(bound);
+    int reported = 0;
+    coordinator.run(make_matches(5), [&](const RemoteMatch&,
+                                         const RemoteResult&,
+                                         const std::string& name) {
+        EXPECT_EQ(name.substr(0, 10), "127.0.0.1:");
+        reported++;
+        return true;
+    });
+    EXPECT_EQ(reported, 5);
+    coordinator.finish();
+    EXPECT_EQ(wait_for(worker), 0);
+}
+
+}  // namespace
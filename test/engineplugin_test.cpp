@@ -0,0 +1,55 @@
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+#include "engine.h"
+#include "engineplugin.h"
+#include "err.h"
+
+namespace {
+
+using Engine::PlayerData;
+
+TEST(EnginePluginTest, TestPluginPlaysItsGame) {
+    Judge::Game game = Judge::load_engine_plugin("./test_engine.so");
+    EXPECT_EQ(game.name, "test");
+
+    const char* moves[] = {"ROCK\n", "PAPER\n"};
+    std::vector<int> fds;
+    std::vector<PlayerData> players;
+    for (int id = 0; id < 2; id++) {
+        int to_player[2], from_player[2];
+        SYSCALL_WITH_CHECK(pipe(to_player));
+        SYSCALL_WITH_CHECK(pipe(from_player));
+        ASSERT_EQ(write(from_player[PIPE_WRITE_END], moves[id],
+                        strlen(moves[id])),
+                  static_cast<ssize_t>(strlen(moves[id])));
+        players.emplace_back(from_player[PIPE_READ_END],
+                             to_player[PIPE_WRITE_END], -1, "bot", id);
+        fds.insert(fds.end(), {to_player[0], to_player[1], from_player[0],
+                               from_player[1]});
+    }
+    Engine::GameResult result = game.play_game(players);
+    EXPECT_EQ(result.type, Engine::GameResult::Draw);
+    EXPECT_EQ(result.pretty_result, "Draw [ROCK-PAPER]");
+    players.clear();
+    for (int fd : fds)
+        close(fd);
+}
+
+TEST(EnginePluginTest, TestMissingPluginIsFatal) {
+    EXPECT_EXIT(Judge::load_engine_plugin("./no_such_engine.so"),
+                testing::ExitedWithCode(1), "Cannot load engine plugin");
+}
+
+TEST(EnginePluginTest, TestLibraryWithoutEngineIsFatal) {
+    EXPECT_EXIT(Judge::load_engine_plugin("libc.so.6"),
+                testing::ExitedWithCode(1), "is not an engine plugin");
+}
+
+}  // namespace
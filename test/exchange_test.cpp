@@ -0,0 +1,161 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+#include "engine.h"
+#include "err.h"
+#include "exchange.h"
+
+namespace {
+
+using Engine::PlayerData;
+using Engine::Reply;
+
+// Engine side of a player whose bot side is driven by the test through
+// `botIn` (what the engine sent) and `botOut` (what the bot replies).
+struct FakeBot {
+    FakeBot() {
+        SYSCALL_WITH_CHECK(pipe(toBot));
+        SYSCALL_WITH_CHECK(pipe(fromBot));
+    }
+
+    ~FakeBot() {
+        for (int fd : {toBot[0], toBot[1], fromBot[0], fromBot[1]})
+            close(fd);
+    }
+
+    void Send(const std::string& msg) {
+        ASSERT_EQ(msg.size(), write(fromBot[PIPE_WRITE_END], msg.c_str(),
+                                    msg.size()));
+    }
+
+    void SendAfterMs(const std::string& msg, int delay_ms) {
+        replier = std::thread([this, msg, delay_ms] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+            Send(msg);
+        });
+    }
+
+    void Hangup() {
+        close(fromBot[PIPE_WRITE_END]);
+        fromBot[PIPE_WRITE_END] = -1;
+    }
+
+    std::string Received() {
+        char buf[256];
+        int readCount = read(toBot[PIPE_READ_END], buf, sizeof(buf));
+        return std::string(buf, std::max(readCount, 0));
+    }
+
+    int toBot[2];
+    int fromBot[2];
+    std::thread replier;
+};
+
+class ExchangeTest : public ::testing::Test {
+   protected:
+    ExchangeTest() {
+        playerstream_base::ignore_sigpipe();
+        for (int i = 0; i < PLAYERS; i++)
+            players.emplace_back(bots[i].fromBot[PIPE_READ_END],
+                                 bots[i].toBot[PIPE_WRITE_END], -1,
+                                 "bot" + std::to_string(i), i);
+    }
+
+    ~ExchangeTest() {
+        for (auto& bot : bots)
+            if (bot.replier.joinable())
+                bot.replier.join();
+    }
+
+    static constexpr int PLAYERS = 2;
+    FakeBot bots[PLAYERS];
+    std::vector<PlayerData> players;
+};
+
+TEST_F(ExchangeTest, TestRepliesAreCollectedInPlayerOrder) {
+    bots[1].Send("PAPER\n");
+    bots[0].Send("ROCK\n");
+    auto replies = Engine::exchange(players, "MOVE", 100);
+    ASSERT_EQ(2, replies.size());
+    EXPECT_TRUE(replies[0].ok());
+    EXPECT_EQ("ROCK", replies[0].line);
+    EXPECT_TRUE(replies[1].ok());
+    EXPECT_EQ("PAPER", replies[1].line);
+    EXPECT_EQ("MOVE\n", bots[0].Received());
+    EXPECT_EQ("MOVE\n", bots[1].Received());
+}
+
+TEST_F(ExchangeTest, TestEachReplyConsumesOneLine) {
+    bots[0].Send("ROCK\nPAPER\n");
+    bots[1].Send("SCISSORS\nROCK\n");
+    auto first = Engine::exchange(players, "MOVE", 100);
+    auto second = Engine::exchange(players, "MOVE", 100);
+    EXPECT_EQ("ROCK", first[0].line);
+    EXPECT_EQ("SCISSORS", first[1].line);
+    EXPECT_EQ("PAPER", second[0].line);
+    EXPECT_EQ("ROCK", second[1].line);
+}
+
+TEST_F(ExchangeTest, TestTimeoutAndEofAreReportedPerPlayer) {
+    bots[0].Send("ROC");
+    bots[1].Hangup();
+    auto replies = Engine::exchange(players, "MOVE", 10);
+    EXPECT_EQ(Reply::Timeout, replies[0].status);
+    EXPECT_EQ(ETIME, replies[0].errnum);
+    EXPECT_EQ("ROC", replies[0].line);
+    EXPECT_EQ(Reply::Eof, replies[1].status);
+    EXPECT_EQ("EOF", replies[1].describe());
+}
+
+TEST_F(ExchangeTest, TestSlowPlayersShareOneDeadline) {
+    constexpr int DELAY_MS = 60;
+    bots[0].SendAfterMs("ROCK\n", DELAY_MS);
+    bots[1].SendAfterMs("PAPER\n", DELAY_MS);
+    auto start = std::chrono::steady_clock::now();
+    auto replies = Engine::exchange(players, "MOVE", 1000);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_TRUE(replies[0].ok());
+    EXPECT_TRUE(replies[1].ok());
+    EXPECT_LT(elapsed, std::chrono::milliseconds(2 * DELAY_MS));
+}
+
+TEST_F(ExchangeTest, TestThinkTimeIsMeasuredPerReply) {
+    constexpr int DELAY_MS = 30;
+    bots[0].Send("ROCK\n");
+    bots[1].SendAfterMs("PAPER\n", DELAY_MS);
+    auto replies = Engine::exchange(players, "MOVE", 1000);
+    ASSERT_TRUE(replies[1].ok());
+    EXPECT_GE(replies[1].think_us, DELAY_MS * 1000);
+    EXPECT_LT(replies[1].think_us, 1000 * 1000);
+    EXPECT_LT(replies[0].think_us, replies[1].think_us);
+}
+
+TEST_F(ExchangeTest, TestResponseTimesEndUpInTheGameResult) {
+    bots[0].Send("ROCK\n");
+    bots[1].Send("PAPER\n");
+    Engine::exchange(players, "MOVE", 100);
+    bots[0].Send("ROCK\n");
+    Engine::exchange(players, "MOVE", 10);
+    auto result = Engine::GameResult::createDraw(players);
+    ASSERT_EQ(2, result.player_latencies.size());
+    EXPECT_EQ(2, result.player_latencies[0].count());
+    EXPECT_EQ(0, result.player_latencies[0].timeouts());
+    EXPECT_EQ(1, result.player_latencies[1].count());
+    EXPECT_EQ(1, result.player_latencies[1].timeouts());
+}
+
+TEST_F(ExchangeTest, TestReplyArrivingInPiecesIsJoined) {
+    bots[0].Send("PA");
+    bots[1].Send("ROCK\n");
+    bots[0].SendAfterMs("PER\n", 10);
+    auto replies = Engine::exchange(players, "MOVE", 1000);
+    EXPECT_TRUE(replies[0].ok());
+    EXPECT_EQ("PAPER", replies[0].line);
+}
+
+}  // namespace
@@ -0,0 +1,66 @@
+#include <cstdlib>
+
+#include <gtest/gtest.h>
+
+#include "latency.h"
+
+namespace {
+
+TEST(LatencyHistogramTest, TestEmpty) {
+    latency_histogram histogram;
+    EXPECT_EQ(0, histogram.count());
+    EXPECT_EQ(0, histogram.mean_us());
+    EXPECT_EQ(0, histogram.percentile_us(0.99));
+    EXPECT_EQ("responses=0 mean_us=0 p50_us=0 p99_us=0 max_us=0 timeouts=0",
+              histogram.summary());
+}
+
+TEST(LatencyHistogramTest, TestSmallValuesAreExact) {
+    latency_histogram histogram;
+    for (int us = 0; us < 8; us++)
+        histogram.record(us);
+    EXPECT_EQ(8, histogram.count());
+    EXPECT_EQ(3, histogram.percentile_us(0.5));
+    EXPECT_EQ(7, histogram.percentile_us(1.0));
+    EXPECT_EQ(7, histogram.max_us());
+}
+
+TEST(LatencyHistogramTest, TestPercentilesWithinRelativeError) {
+    latency_histogram histogram;
+    for (long long us = 1; us <= 100000; us++)
+        histogram.record(us);
+    EXPECT_EQ(100000, histogram.count());
+    EXPECT_EQ(50000, histogram.mean_us());
+    for (double fraction : {0.5, 0.9, 0.99, 0.999}) {
+        double exact = fraction * 100000;
+        EXPECT_NEAR(exact, histogram.percentile_us(fraction), exact / 16)
+            << "at " << fraction;
+    }
+    EXPECT_EQ(100000, histogram.max_us());
+    EXPECT_EQ(100000, histogram.percentile_us(1.0));
+}
+
+TEST(LatencyHistogramTest, TestOutliersAndNegativeValues) {
+    latency_histogram histogram;
+    histogram.record(-5);
+    histogram.record(1LL << 50);
+    EXPECT_EQ(0, histogram.percentile_us(0.5));
+    EXPECT_EQ(1LL << 50, histogram.max_us());
+    EXPECT_EQ(1LL << 50, histogram.percentile_us(1.0));
+}
+
+TEST(LatencyHistogramTest, TestMergeAddsEverything) {
+    latency_histogram fast, slow;
+    for (int i = 0; i < 99; i++)
+        fast.record(100);
+    slow.record(50000);
+    slow.record_timeout();
+    fast.merge(slow);
+    EXPECT_EQ(100, fast.count());
+    EXPECT_EQ(1, fast.timeouts());
+    EXPECT_EQ(99 * 100 + 50000, fast.total_us());
+    EXPECT_NEAR(100, fast.percentile_us(0.99), 100 / 16);
+    EXPECT_EQ(50000, fast.max_us());
+}
+
+}  // namespace
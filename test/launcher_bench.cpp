@@ -0,0 +1,89 @@
+// Spawn-to-first-byte latency of starting a bot: the time from deciding to
+// start a process until the judge reads the first byte of its output. The
+// judge's heap is inflated to show the cost fork() pays for copying page
+// tables, which posix_spawn avoids.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "err.h"
+#include "launcher.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int ITERATIONS = 200;
+const char* PROGRAM = "echo";
+
+// The way play_match used to start bots.
+void spawn_with_fork(int out_fd, Judge::ChildProcess& child) {
+    pid_t pid = fork();
+    if (pid == -1)
+        syserr("fork");
+    if (pid == 0) {
+        SYSCALL_WITH_CHECK(close(fileno(stdout)));
+        SYSCALL_WITH_CHECK(dup(out_fd));
+        execlp(PROGRAM, PROGRAM, "x", nullptr);
+        _exit(127);
+    }
+    child.pid = pid;
+}
+
+void spawn_with_launcher(int out_fd, Judge::ChildProcess& child) {
+    if (Judge::launch(PROGRAM, {"x"}, {{out_fd, fileno(stdout)}}, child) != 0)
+        fatal("cannot launch %s", PROGRAM);
+}
+
+template <class Spawn>
+void run(const char* method, size_t heap_mb, Spawn spawn) {
+    std::vector<double> latencies_us;
+    for (int i = 0; i < ITERATIONS; i++) {
+        int pipes[2];
+        Judge::make_cloexec_pipe(pipes);
+        Judge::ChildProcess child;
+
+        auto start = Clock::now();
+        spawn(pipes[PIPE_WRITE_END], child);
+        char c;
+        if (read(pipes[PIPE_READ_END], &c, 1) != 1)
+            fatal("no output from %s", PROGRAM);
+        auto elapsed = Clock::now() - start;
+        latencies_us.push_back(
+            std::chrono::duration<double, std::micro>(elapsed).count());
+
+        Judge::reap_child(child);
+        close(pipes[PIPE_READ_END]);
+        close(pipes[PIPE_WRITE_END]);
+    }
+    std::sort(latencies_us.begin(), latencies_us.end());
+    double sum = 0;
+    for (double latency : latencies_us)
+        sum += latency;
+    printf(
+        "benchmark=spawn_first_byte method=%s heap_mb=%zu n=%d mean_us=%.1f "
+        "p50_us=%.1f p99_us=%.1f\n",
+        method, heap_mb, ITERATIONS, sum / ITERATIONS,
+        latencies_us[ITERATIONS / 2], latencies_us[ITERATIONS * 99 / 100]);
+}
+
+}  // namespace
+
+int main() {
+    std::vector<char> heap;
+    for (size_t heap_mb : {0, 512}) {
+        // Touch every page so that fork() has page tables to copy.
+        heap.resize(heap_mb << 20);
+        memset(heap.data(), 1, heap.size());
+        run("fork_exec", heap_mb, spawn_with_fork);
+        run("posix_spawn", heap_mb, spawn_with_launcher);
+    }
+    return 0;
+}
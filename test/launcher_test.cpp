@@ -0,0 +1,119 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+#include "err.h"
+#include "launcher.h"
+#include "playerstream.h"
+
+namespace {
+
+using Judge::ChildProcess;
+
+class LauncherTest : public ::testing::Test {
+   protected:
+    LauncherTest() { Judge::make_cloexec_pipe(pipes); }
+
+    ~LauncherTest() {
+        Judge::kill_child(child);
+        Judge::reap_child(child);
+        close(pipes[PIPE_READ_END]);
+        if (pipes[PIPE_WRITE_END] != -1)
+            close(pipes[PIPE_WRITE_END]);
+    }
+
+    // Closes the judge's copy of the write end, as play_match does.
+    void CloseWriteEnd() {
+        SYSCALL_WITH_CHECK(close(pipes[PIPE_WRITE_END]));
+        pipes[PIPE_WRITE_END] = -1;
+    }
+
+    std::string ReadAll() {
+        std::string result;
+        char buf[256];
+        int readCount;
+        while ((readCount = read(pipes[PIPE_READ_END], buf, sizeof(buf))) > 0)
+            result.append(buf, readCount);
+        return result;
+    }
+
+    int pipes[2];
+    ChildProcess child;
+};
+
+TEST_F(LauncherTest, TestMappedFdBecomesChildStdout) {
+    ASSERT_EQ(0, Judge::launch("echo", {"hello", "world"},
+                               {{pipes[PIPE_WRITE_END], 1}}, child));
+    CloseWriteEnd();
+    EXPECT_EQ("hello world\n", ReadAll());
+    Judge::reap_child(child);
+    EXPECT_EQ(-1, child.pid);
+}
+
+TEST_F(LauncherTest, TestUnmappedCloexecFdsAreNotInherited) {
+    // If the child inherited the write end, reading would never see EOF.
+    ASSERT_EQ(0, Judge::launch("sleep", {"10"}, {}, child));
+    CloseWriteEnd();
+    EXPECT_EQ("", ReadAll());
+}
+
+TEST_F(LauncherTest, TestMappingsMayTargetEachOthersFds) {
+    // The first mapping overwrites the child's copy of the write end before
+    // the second one reads it, unless the launcher moves it aside.
+    int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    ASSERT_NE(-1, devnull);
+    ASSERT_EQ(0, Judge::launch("echo", {"moved"},
+                               {{devnull, pipes[PIPE_WRITE_END]},
+                                {pipes[PIPE_WRITE_END], 1}},
+                               child));
+    close(devnull);
+    CloseWriteEnd();
+    EXPECT_EQ("moved\n", ReadAll());
+}
+
+TEST_F(LauncherTest, TestChildGetsExtraEnvironment) {
+    ASSERT_EQ(0, Judge::launch("printenv", {"BOTS_JUDGE_TEST"},
+                               {{pipes[PIPE_WRITE_END], 1}}, child,
+                               {"BOTS_JUDGE_TEST=42"}));
+    CloseWriteEnd();
+    EXPECT_EQ("42\n", ReadAll());
+}
+
+TEST_F(LauncherTest, TestMissingProgramIsReported) {
+    EXPECT_EQ(ENOENT, Judge::launch("no-such-bot-binary", {}, {}, child));
+    EXPECT_EQ(-1, child.pid);
+    EXPECT_FALSE(Judge::is_running(child));
+}
+
+TEST_F(LauncherTest, TestKilledChildIsNoLongerRunning) {
+    ASSERT_EQ(0, Judge::launch("sleep", {"10"}, {}, child));
+    EXPECT_TRUE(Judge::is_running(child));
+    Judge::kill_child(child);
+    EXPECT_EQ(128 + SIGKILL, Judge::reap_child(child));
+    EXPECT_FALSE(Judge::is_running(child));
+}
+
+TEST_F(LauncherTest, TestExitStatusIsReported) {
+    ASSERT_EQ(0, Judge::launch("sh", {"-c", "exit 3"}, {}, child));
+    EXPECT_EQ(3, Judge::reap_child(child));
+    EXPECT_EQ(0, Judge::reap_child(child));
+}
+
+TEST_F(LauncherTest, TestChildGetsDefaultSigpipe) {
+    playerstream_base::ignore_sigpipe();
+    ASSERT_EQ(0, Judge::launch("grep", {"SigIgn", "/proc/self/status"},
+                               {{pipes[PIPE_WRITE_END], 1}}, child));
+    CloseWriteEnd();
+    std::string status = ReadAll();
+    // SIGPIPE is signal 13, bit 0x1000 of the ignored-signals mask.
+    ASSERT_GE(status.size(), 2u);
+    unsigned long long ignored = std::stoull(status.substr(7), nullptr, 16);
+    EXPECT_EQ(0u, ignored & (1ull << (SIGPIPE - 1)));
+}
+
+}  // namespace
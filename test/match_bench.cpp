@@ -0,0 +1,209 @@
+// Costs around a match rather than inside it, with the example RSP bots
+// built in ../example/rsp:
+//   match_setup   starting two bots the way play_match does, waiting for
+//                 their first answer and tearing them down again;
+//   game_result   building the GameResult of a finished game;
+//   matrix_round  reading two RSP moves and scoring the round, as the
+//                 engine does with matrixgame.h;
+//   rsp_matches   whole matches per second of the RSP engine, with a move
+//                 per exchange (batch=1) or up to 100 moves (batch=100),
+//                 in games of the usual 10 rounds and of 1000.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "botpool.h"
+#include "common.h"
+#include "engine.h"
+#include "err.h"
+#include "exchange.h"
+#include "launcher.h"
+#include "matrixgame.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Engine::PlayerData;
+
+constexpr int SETUP_ITERATIONS = 200;
+constexpr int RESULT_ITERATIONS = 100000;
+constexpr int ROUND_ITERATIONS = 10000000;
+constexpr int RSP_MATCHES = 300;
+constexpr int LONG_RSP_MATCHES = 30;
+constexpr int LONG_RSP_ROUNDS = 1000;
+
+std::string example_dir;
+
+void print_latencies(const char* benchmark,
+                     const char* transport,
+                     std::vector<double>& latencies_us) {
+    std::sort(latencies_us.begin(), latencies_us.end());
+    double sum = 0;
+    for (double latency : latencies_us)
+        sum += latency;
+    size_t n = latencies_us.size();
+    printf(
+        "benchmark=%s transport=%s n=%zu mean_us=%.1f p50_us=%.1f "
+        "p99_us=%.1f\n",
+        benchmark, transport, n, sum / n, latencies_us[n / 2],
+        latencies_us[n * 99 / 100]);
+}
+
+int make_stderr_file() {
+    int fd;
+    SYSCALL_WITH_CHECK(fd = memfd_create("stderr:bench", MFD_CLOEXEC));
+    return fd;
+}
+
+void run_match_setup(const char* transport, bool shm_transport) {
+    const std::string rock = example_dir + "/rock";
+    std::vector<double> latencies_us;
+    for (int i = 0; i < SETUP_ITERATIONS; i++) {
+        auto start = Clock::now();
+        std::vector<std::unique_ptr<Judge::BotProcess>> bots;
+        std::vector<PlayerData> players;
+        for (int id = 0; id < 2; id++) {
+            bots.push_back(Judge::spawn_bot(rock, 1, make_stderr_file(),
+                                            shm_transport));
+            Judge::BotProcess& bot = *bots.back();
+            if (bot.transport)
+                players.emplace_back(bot.transport, bot.err_fd, rock, id);
+            else
+                players.emplace_back(bot.read_fd, bot.write_fd, bot.err_fd,
+                                     rock, id);
+        }
+        std::vector<Engine::Reply> replies =
+            Engine::exchange(players, "MOVE", 5000);
+        if (!replies[0].ok() || !replies[1].ok())
+            fatal("%s did not answer", rock.c_str());
+        players.clear();
+        for (auto& bot : bots)
+            Judge::terminate_bot(*bot);
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(
+                                   Clock::now() - start)
+                                   .count());
+    }
+    print_latencies("match_setup", transport, latencies_us);
+}
+
+void run_game_result() {
+    int pipes[2];
+    SYSCALL_WITH_CHECK(pipe(pipes));
+    std::vector<PlayerData> players;
+    for (int id = 0; id < 2; id++)
+        players.emplace_back(pipes[PIPE_READ_END], pipes[PIPE_WRITE_END], -1,
+                             "bot", id);
+    size_t checksum = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < RESULT_ITERATIONS; i++) {
+        auto result =
+            Engine::GameResult::createWin(players, players[i % 2], "6-4");
+        checksum += result.pretty_result.size();
+    }
+    double elapsed_ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    printf("benchmark=game_result n=%d mean_ns=%.1f checksum=%zu\n",
+           RESULT_ITERATIONS, elapsed_ns / RESULT_ITERATIONS, checksum);
+    players.clear();
+    close(pipes[PIPE_READ_END]);
+    close(pipes[PIPE_WRITE_END]);
+}
+
+void run_matrix_round() {
+    static constexpr Engine::MatrixGame<3> RSP(
+        {"ROCK", "PAPER", "SCISSORS"},
+        {{{{{0, 0}, {0, 1}, {1, 0}}},
+          {{{1, 0}, {0, 0}, {0, 1}}},
+          {{{0, 1}, {1, 0}, {0, 0}}}}});
+    // Replies as they come, so that the compiler cannot fold the lookups.
+    std::vector<std::string> replies = {"ROCK", "PAPER", "SCISSORS",
+                                        "PAPER", "ROCK"};
+    long long points = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < ROUND_ITERATIONS; i++) {
+        int first = RSP.parse(replies[i % replies.size()]);
+        int second = RSP.parse(replies[(i / 3) % replies.size()]);
+        points += RSP.payoff(first, second).first;
+    }
+    double elapsed_ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    printf("benchmark=matrix_round n=%d mean_ns=%.1f checksum=%lld\n",
+           ROUND_ITERATIONS, elapsed_ns / ROUND_ITERATIONS, points);
+}
+
+void run_rsp_matches(const char* transport,
+                     int matches,
+                     int rounds,
+                     int batch) {
+    char log_dir[] = "/tmp/match_bench.XXXXXX";
+    if (mkdtemp(log_dir) == nullptr)
+        syserr("mkdtemp");
+    const std::string log = std::string(log_dir) + "/matches.log";
+    int devnull;
+    SYSCALL_WITH_CHECK(devnull = open("/dev/null", O_WRONLY | O_CLOEXEC));
+
+    // The engine reads its settings from the environment.
+    setenv("RSP_ROUNDS", std::to_string(rounds).c_str(), 1);
+    setenv("RSP_BATCH", std::to_string(batch).c_str(), 1);
+    Judge::ChildProcess engine;
+    auto start = Clock::now();
+    int rv = Judge::launch(example_dir + "/rsp_engine",
+                           {"--matches", std::to_string(matches), "--log",
+                            log, "--transport", transport, "rock", "random"},
+                           {{devnull, STDOUT_FILENO}}, engine);
+    if (rv != 0)
+        fatal("cannot start rsp_engine: %s", strerror(rv));
+    int status = Judge::reap_child(engine);
+    if (status != 0)
+        fatal("rsp_engine failed with status %d", status);
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    printf(
+        "benchmark=rsp_matches transport=%s rounds=%d batch=%d n=%d "
+        "matches_per_s=%.1f\n",
+        transport, rounds, batch, matches, matches / seconds);
+
+    close(devnull);
+    unlink(log.c_str());
+    unlink((log + ".idx").c_str());
+    rmdir(log_dir);
+}
+
+}  // namespace
+
+int main() {
+    playerstream_base::ignore_sigpipe();
+    char path[PATH_MAX];
+    if (realpath("../example/rsp", path) == nullptr)
+        syserr("Cannot find ../example/rsp");
+    example_dir = path;
+    // rsp_engine looks its bots up on $PATH.
+    const char* search_path_before = getenv("PATH");
+    std::string search_path =
+        example_dir + ":" + (search_path_before ? search_path_before : "");
+    setenv("PATH", search_path.c_str(), 1);
+
+    run_match_setup("pipe", false);
+    run_match_setup("shm", true);
+    run_game_result();
+    run_matrix_round();
+    for (const char* transport : {"pipe", "shm"}) {
+        for (int batch : {1, 100}) {
+            run_rsp_matches(transport, RSP_MATCHES, 10, batch);
+            run_rsp_matches(transport, LONG_RSP_MATCHES, LONG_RSP_ROUNDS,
+                            batch);
+        }
+    }
+    return 0;
+}
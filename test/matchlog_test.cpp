@@ -0,0 +1,103 @@
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "err.h"
+#include "matchlog.h"
+
+namespace {
+
+using Judge::MatchLog;
+using Judge::MatchLogEntry;
+using Judge::MatchLogReader;
+
+class MatchLogTest : public ::testing::Test {
+   protected:
+    MatchLogTest() {
+        char dir_template[] = "/tmp/matchlog_test.XXXXXX";
+        if (mkdtemp(dir_template) == nullptr)
+            syserr("mkdtemp");
+        dir = dir_template;
+        path = dir + "/matches.log";
+    }
+
+    ~MatchLogTest() {
+        unlink(path.c_str());
+        unlink((path + ".idx").c_str());
+        rmdir(dir.c_str());
+    }
+
+    std::string dir;
+    std::string path;
+};
+
+TEST_F(MatchLogTest, TestRecordsAreFoundByMatchId) {
+    {
+        MatchLog log(path);
+        log.append(1, -1, MatchLogEntry::Metadata, "meta1", 5);
+        log.append(2, 0, MatchLogEntry::Stderr, "err2", 4);
+        log.append(1, 1, MatchLogEntry::Stderr, "", 0);
+    }
+    MatchLogReader reader(path);
+    auto entries = reader.find(1);
+    ASSERT_EQ(2, entries.size());
+    EXPECT_EQ(-1, entries[0].player_id);
+    EXPECT_EQ(MatchLogEntry::Metadata, entries[0].kind);
+    EXPECT_EQ("meta1", reader.read(entries[0]));
+    EXPECT_EQ(1, entries[1].player_id);
+    EXPECT_EQ("", reader.read(entries[1]));
+    EXPECT_TRUE(reader.find(3).empty());
+}
+
+TEST_F(MatchLogTest, TestFileContentsAreArchived) {
+    int fd = memfd_create("stderr", MFD_CLOEXEC);
+    ASSERT_NE(-1, fd);
+    const std::string contents(100000, 'x');
+    ASSERT_EQ(contents.size(), write(fd, contents.data(), contents.size()));
+    {
+        MatchLog log(path);
+        log.appendFile(7, 0, MatchLogEntry::Stderr, fd);
+    }
+    close(fd);
+    MatchLogReader reader(path);
+    auto entries = reader.find(7);
+    ASSERT_EQ(1, entries.size());
+    EXPECT_EQ(contents, reader.read(entries[0]));
+}
+
+TEST_F(MatchLogTest, TestConcurrentAppendsDoNotOverlap) {
+    constexpr int THREADS = 4;
+    constexpr int MATCHES_PER_THREAD = 200;
+    {
+        MatchLog log(path);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++) {
+            threads.emplace_back([&log, t] {
+                for (int i = 0; i < MATCHES_PER_THREAD; i++) {
+                    int match_id = t * MATCHES_PER_THREAD + i;
+                    std::string payload = "match " + std::to_string(match_id);
+                    log.append(match_id, 0, MatchLogEntry::Stderr,
+                               payload.data(), payload.size());
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    }
+    MatchLogReader reader(path);
+    for (int match_id = 0; match_id < THREADS * MATCHES_PER_THREAD;
+         match_id++) {
+        auto entries = reader.find(match_id);
+        ASSERT_EQ(1, entries.size());
+        EXPECT_EQ("match " + std::to_string(match_id),
+                  reader.read(entries[0]));
+    }
+}
+
+}  // namespace
@@ -0,0 +1,85 @@
+#include <unistd.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+#include "engine.h"
+#include "err.h"
+#include "matrixgame.h"
+
+namespace {
+
+using Engine::GameResult;
+using Engine::MatrixGame;
+using Engine::PlayerData;
+
+constexpr MatrixGame<3> RSP({"ROCK", "PAPER", "SCISSORS"},
+                            {{{{{0, 0}, {0, 1}, {1, 0}}},
+                              {{{1, 0}, {0, 0}, {0, 1}}},
+                              {{{0, 1}, {1, 0}, {0, 0}}}}});
+
+// Names that differ in a character or two.
+constexpr MatrixGame<8> NUMBERED({"MOVE0", "MOVE1", "MOVE2", "MOVE3",
+                                  "MOVE10", "MOVE11", "MOVE12", "MOVE13"},
+                                 {});
+
+// The table is usable at compile time.
+static_assert(RSP.parse("PAPER") == 1);
+static_assert(RSP.parse("LIZARD") == -1);
+static_assert(RSP.payoff(2, 1).first == 1);
+
+TEST(MatrixGameTest, ParsesEveryMoveAndNothingElse) {
+    for (int move = 0; move < static_cast<int>(RSP.size()); move++)
+        EXPECT_EQ(RSP.parse(RSP.name(move)), move);
+    for (int move = 0; move < static_cast<int>(NUMBERED.size()); move++)
+        EXPECT_EQ(NUMBERED.parse(NUMBERED.name(move)), move);
+    for (std::string_view name : {"", "rock", "ROC", "ROCKS", " ROCK",
+                                  "SCISSORS\n", "MOVE4", "MOVE"}) {
+        EXPECT_EQ(RSP.parse(name), -1) << name;
+        EXPECT_EQ(NUMBERED.parse(name), -1) << name;
+    }
+}
+
+TEST(MatrixGameTest, LooksUpThePayoffsOfBothPlayers) {
+    int rock = RSP.parse("ROCK");
+    int scissors = RSP.parse("SCISSORS");
+    EXPECT_EQ(RSP.payoff(rock, scissors).first, 1);
+    EXPECT_EQ(RSP.payoff(rock, scissors).second, 0);
+    EXPECT_EQ(RSP.payoff(scissors, rock).first, 0);
+    EXPECT_EQ(RSP.payoff(scissors, rock).second, 1);
+    EXPECT_EQ(RSP.payoff(rock, rock).first, 0);
+}
+
+TEST(MatrixGameTest, SplitsRepliesIntoWords) {
+    std::string_view reply = "  ROCK\tPAPER  SCISSORS ";
+    EXPECT_EQ(Engine::next_word(reply), "ROCK");
+    EXPECT_EQ(Engine::next_word(reply), "PAPER");
+    EXPECT_EQ(Engine::next_word(reply), "SCISSORS");
+    EXPECT_EQ(Engine::next_word(reply), "");
+    EXPECT_EQ(Engine::next_word(reply), "");
+}
+
+TEST(MatrixGameTest, TheMorePointsWin) {
+    int pipes[2];
+    SYSCALL_WITH_CHECK(pipe(pipes));
+    std::vector<PlayerData> players;
+    for (int id = 0; id < 2; id++)
+        players.emplace_back(pipes[PIPE_READ_END], pipes[PIPE_WRITE_END], -1,
+                             "bot" + std::to_string(id), id);
+    GameResult win = Engine::matrix_game_result(players, 4, 6);
+    EXPECT_EQ(win.type, GameResult::Win);
+    EXPECT_EQ(win.player_scores, (std::vector<double>{0, 1}));
+    EXPECT_EQ(win.pretty_result, "Player #1 (bot1) won [6-4]");
+    GameResult draw = Engine::matrix_game_result(players, 5, 5);
+    EXPECT_EQ(draw.type, GameResult::Draw);
+    EXPECT_EQ(draw.pretty_result, "Draw [5-5]");
+    players.clear();
+    SYSCALL_WITH_CHECK(close(pipes[PIPE_READ_END]));
+    SYSCALL_WITH_CHECK(close(pipes[PIPE_WRITE_END]));
+}
+
+}  // namespace
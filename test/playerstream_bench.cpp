@@ -0,0 +1,142 @@
+// Throughput of a playerstream over a pipe for messages from 16 B to 16 MB,
+// with the default 1 KiB buffers and with growable ones. "read" has a
+// forked child write the messages as newline-terminated lines, which the
+// judge reads with getline(); "write" has the judge write them while the
+// child drains the pipe.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "common.h"
+#include "err.h"
+#include "playerstream.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t MIN_SIZE = 16;
+constexpr size_t MAX_SIZE = 16 << 20;
+// Bytes moved for every message size.
+constexpr size_t TOTAL_BYTES = 64 << 20;
+
+struct Policy {
+    const char* name;
+    playerbuf_policy policy;
+};
+
+// Runs `child` in a forked process with `fd` as its end of a pipe, the
+// read end if `child_reads`. Returns the judge's end.
+template <class ChildMain>
+int fork_child(bool child_reads, pid_t& pid, ChildMain child) {
+    int pipes[2];
+    SYSCALL_WITH_CHECK(pipe(pipes));
+    int child_end = child_reads ? PIPE_READ_END : PIPE_WRITE_END;
+    pid = fork();
+    if (pid == -1)
+        syserr("fork");
+    if (pid == 0) {
+        close(pipes[1 - child_end]);
+        child(pipes[child_end]);
+        _exit(0);
+    }
+    close(pipes[child_end]);
+    return pipes[1 - child_end];
+}
+
+void write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0)
+            syserr("write");
+        data += n;
+        len -= n;
+    }
+}
+
+void report(const char* direction,
+            const Policy& policy,
+            size_t size,
+            size_t count,
+            Clock::duration elapsed) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    printf(
+        "benchmark=playerstream_throughput direction=%s policy=%s "
+        "size=%zu n=%zu mb_per_s=%.1f\n",
+        direction, policy.name, size, count,
+        size * count / seconds / (1 << 20));
+}
+
+void run_read(const Policy& policy, size_t size, size_t count) {
+    // Many small lines are written in large blocks, so that the child is
+    // not what is measured.
+    size_t per_block = std::max<size_t>(1, (1 << 16) / size);
+    std::string block;
+    for (size_t i = 0; i < per_block; i++)
+        block += std::string(size - 1, 'x') + '\n';
+    pid_t pid;
+    int fd = fork_child(false, pid, [&](int out) {
+        for (size_t sent = 0; sent < count; sent += per_block)
+            write_all(out, block.data(),
+                      std::min(per_block, count - sent) * size);
+        close(out);
+    });
+
+    auto start = Clock::now();
+    {
+        iplayerstream stream(fd, policy.policy);
+        std::string line;
+        for (size_t i = 0; i < count; i++) {
+            if (!std::getline(stream, line) || line.size() != size - 1)
+                fatal("short read of a %zu byte message", size);
+        }
+    }
+    report("read", policy, size, count, Clock::now() - start);
+    close(fd);
+    waitpid(pid, nullptr, 0);
+}
+
+void run_write(const Policy& policy, size_t size, size_t count) {
+    pid_t pid;
+    int fd = fork_child(true, pid, [](int in) {
+        static char buf[1 << 16];
+        while (read(in, buf, sizeof(buf)) > 0) {
+        }
+        close(in);
+    });
+    std::string message(size - 1, 'x');
+
+    auto start = Clock::now();
+    {
+        oplayerstream stream(fd, policy.policy);
+        for (size_t i = 0; i < count; i++)
+            stream << message << '\n';
+        stream << std::flush;
+        if (!stream.good())
+            fatal("write failed: %s", stream.get_last_strerror().c_str());
+    }
+    report("write", policy, size, count, Clock::now() - start);
+    close(fd);
+    waitpid(pid, nullptr, 0);
+}
+
+}  // namespace
+
+int main() {
+    playerstream_base::ignore_sigpipe();
+    const Policy policies[] = {{"fixed_1k", playerbuf_policy()},
+                               {"growable", playerbuf_policy::growable()}};
+    for (size_t size = MIN_SIZE; size <= MAX_SIZE; size *= 16) {
+        size_t count = std::max<size_t>(1, TOTAL_BYTES / size);
+        for (const Policy& policy : policies) {
+            run_read(policy, size, count);
+            run_write(policy, size, count);
+        }
+    }
+    return 0;
+}
@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "common.h"
 #include "err.h"
+#include "monotonic.h"
 #include "playerstream.h"
 
 namespace {
@@ -214,7 +220,7 @@ class OutputPlayerStreamTest : public PlayerStreamTestBase {
         EXPECT_EQ(n, readCount);
         buf[readCount] = '\0';
         std::string result(buf);
-        delete buf;
+        delete[] buf;
         return result;
     }
 
@@ -296,6 +302,143 @@ TEST_F(OutputPlayerStreamTest, TestWritingAndFlushingPipeWithClosedReadEnd) {
     EXPECT_EQ(EPIPE, testedStream->get_last_error());
 }
 
+TEST_F(OutputPlayerStreamTest, TestWriteTimeoutWhenReaderStalls) {
+    int callCount = 0;
+    auto callback = [&callCount](const playerbuf& /*sender*/, int errnum) {
+        EXPECT_EQ(ETIME, errnum);
+        callCount++;
+    };
+    testedStream->on_error_call(callback);
+    testedStream->set_write_timeout_ms(TIMEOUT_MS_SHORT);
+
+    // Much more than a pipe can hold while nobody reads it.
+    const std::string chunk(playerbuf::BUF_SIZE, 'a');
+    for (int i = 0; i < 1024 && testedStream->good(); i++)
+        *testedStream << chunk;
+    *testedStream << std::flush;
+    EXPECT_TRUE(testedStream->bad());
+    EXPECT_EQ(ETIME, testedStream->get_last_error());
+    EXPECT_EQ(1, callCount);
+
+    CloseReadPipe();
+}
+
+TEST_F(OutputPlayerStreamTest, TestLargeWriteCompletesWhileReaderDrains) {
+    constexpr int TOTAL_SIZE = 1 << 20;
+    testedStream->set_write_timeout_ms(1000);
+    std::thread reader([this] {
+        char buf[4096];
+        int readTotal = 0;
+        while (readTotal < TOTAL_SIZE) {
+            int readCount = read(GetReadPipe(), buf, sizeof(buf));
+            ASSERT_GT(readCount, 0);
+            readTotal += readCount;
+        }
+    });
+
+    *testedStream << std::string(TOTAL_SIZE, 'a') << std::flush;
+    reader.join();
+    EXPECT_TRUE(testedStream->good());
+    EXPECT_EQ(0, testedStream->get_last_error());
+}
+
+TEST_F(OutputPlayerStreamTest, TestWriteLargerThanBufferKeepsOrder) {
+    const std::string big(3 * playerbuf::BUF_SIZE + 7, 'b');
+    const std::string expected = "head " + big + " tail";
+    testedStream->set_write_timeout_ms(1000);
+    std::string received;
+    std::thread reader([this, &received, &expected] {
+        char buf[4096];
+        while (received.size() < expected.size()) {
+            int readCount = read(GetReadPipe(), buf, sizeof(buf));
+            ASSERT_GT(readCount, 0);
+            received.append(buf, readCount);
+        }
+    });
+
+    *testedStream << "head " << big << " tail" << std::flush;
+    reader.join();
+    EXPECT_TRUE(testedStream->good());
+    EXPECT_EQ(expected, received);
+}
+
+// Serves `input` in reads of at most the requested size and keeps what is
+// written, counting the calls.
+class CountingTransport : public player_transport {
+   public:
+    explicit CountingTransport(std::string p_input)
+        : input(std::move(p_input)) {}
+
+    ssize_t read(char* buf, size_t len) override {
+        reads++;
+        size_t n = std::min(len, input.size() - offset);
+        memcpy(buf, input.data() + offset, n);
+        offset += n;
+        return n;
+    }
+
+    ssize_t write(const char* buf, size_t len) override {
+        writes++;
+        output.append(buf, len);
+        return len;
+    }
+
+    int get_poll_fd() const override { return -1; }
+
+    std::string input;
+    size_t offset = 0;
+    std::string output;
+    int reads = 0;
+    int writes = 0;
+};
+
+TEST(PlayerBufPolicyTest, TestFixedBufferReadsInBufferSizedChunks) {
+    constexpr int LINE_SIZE = 1 << 20;
+    auto transport = std::make_shared<CountingTransport>(
+        std::string(LINE_SIZE, 'm') + "\n");
+    playerstream stream(transport, playerbuf_policy::fixed(4096));
+    std::string line;
+    ASSERT_TRUE(std::getline(stream, line));
+    EXPECT_EQ(LINE_SIZE, line.size());
+    EXPECT_EQ(LINE_SIZE / 4096 + 1, transport->reads);
+}
+
+TEST(PlayerBufPolicyTest, TestGrowableBufferReadsLongLinesInFewReads) {
+    constexpr int LINE_SIZE = 1 << 20;
+    auto transport = std::make_shared<CountingTransport>(
+        std::string(LINE_SIZE, 'm') + "\nnext\n");
+    playerstream stream(transport, playerbuf_policy::growable());
+    std::string line;
+    ASSERT_TRUE(std::getline(stream, line));
+    EXPECT_EQ(LINE_SIZE, line.size());
+    // 1 KiB, 2 KiB, ..., 1 MiB.
+    EXPECT_LE(transport->reads, 12);
+    ASSERT_TRUE(std::getline(stream, line));
+    EXPECT_EQ("next", line);
+}
+
+TEST(PlayerBufPolicyTest, TestGrowthStopsAtMaxSize) {
+    constexpr int LINE_SIZE = 64 * 1024;
+    auto transport = std::make_shared<CountingTransport>(
+        std::string(LINE_SIZE, 'm') + "\n");
+    playerstream stream(transport, playerbuf_policy::growable(8192));
+    std::string line;
+    ASSERT_TRUE(std::getline(stream, line));
+    EXPECT_EQ(LINE_SIZE, line.size());
+    // 1 KiB, 2 KiB and 4 KiB, then 8 KiB at a time.
+    EXPECT_EQ(3 + (LINE_SIZE - 7 * 1024) / 8192 + 1, transport->reads);
+}
+
+TEST(PlayerBufPolicyTest, TestLargeWritesBypassTheBuffer) {
+    auto transport = std::make_shared<CountingTransport>("");
+    playerstream stream(transport);
+    const std::string big(10 * playerbuf::BUF_SIZE, 'w');
+    stream << "MAP " << big << std::flush;
+    EXPECT_EQ("MAP " + big, transport->output);
+    // The buffered prefix, then the rest in one piece.
+    EXPECT_EQ(2, transport->writes);
+}
+
 TEST(PlayerStreamTest, ReadAndWrite) {
     int pipefds[2];
     ASSERT_EQ(pipe(pipefds), 0);
@@ -333,4 +476,172 @@ TEST(PlayerStreamTest, ReadTimeout) {
     close(pipefds[1]);
 }
 
+// The judge's side of a bot: requests go out through one pipe and the
+// replies come back through another.
+class DeadlinePlayerStreamTest : public ::testing::Test {
+   protected:
+    static constexpr int SHORT_TIMEOUT_MS = 10;
+
+    DeadlinePlayerStreamTest() {
+        playerstream_base::ignore_sigpipe();
+        SYSCALL_WITH_CHECK(pipe(toBot));
+        SYSCALL_WITH_CHECK(pipe(fromBot));
+        stream.reset(new playerstream(fromBot[PIPE_READ_END],
+                                      toBot[PIPE_WRITE_END]));
+    }
+
+    ~DeadlinePlayerStreamTest() {
+        if (bot.joinable())
+            bot.join();
+        stream.reset();
+        for (int fd : {toBot[0], toBot[1], fromBot[0], fromBot[1]})
+            close(fd);
+    }
+
+    // Sends `pieces` one after another, `delay_ms` apart.
+    void Reply(std::vector<std::string> pieces, int delay_ms) {
+        bot = std::thread([this, pieces, delay_ms] {
+            for (const std::string& piece : pieces) {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(delay_ms));
+                if (write(fromBot[PIPE_WRITE_END], piece.data(),
+                          piece.size()) != static_cast<ssize_t>(piece.size()))
+                    return;
+            }
+        });
+    }
+
+    int toBot[2];
+    int fromBot[2];
+    std::unique_ptr<playerstream> stream;
+    std::thread bot;
+};
+
+TEST_F(DeadlinePlayerStreamTest, TestDripFedReplyCannotExtendTheDeadline) {
+    constexpr int TIMEOUT_MS = 50;
+    stream->set_timeout_ms(TIMEOUT_MS);
+    *stream << "MOVE" << std::endl;
+    // Every piece arrives well within the timeout of the one before.
+    Reply(std::vector<std::string>(20, "R"), 10);
+
+    auto start = std::chrono::steady_clock::now();
+    std::string line;
+    std::getline(*stream, line);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_TRUE(stream->eof());
+    EXPECT_EQ(ETIME, stream->get_last_error());
+    EXPECT_LT(line.size(), 20);
+    EXPECT_LT(elapsed, std::chrono::milliseconds(150));
+}
+
+TEST_F(DeadlinePlayerStreamTest, TestEveryRequestGetsItsOwnDeadline) {
+    constexpr int TIMEOUT_MS = 40;
+    stream->set_timeout_ms(TIMEOUT_MS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * TIMEOUT_MS));
+    *stream << "MOVE" << std::endl;
+    Reply({"ROCK\n"}, 10);
+    std::string line;
+    ASSERT_TRUE(std::getline(*stream, line));
+    EXPECT_EQ("ROCK", line);
+}
+
+TEST_F(DeadlinePlayerStreamTest, TestExplicitDeadline) {
+    stream->set_deadline(Monotonic::after_ms(20));
+    std::string line;
+    EXPECT_FALSE(std::getline(*stream, line));
+    EXPECT_EQ(ETIME, stream->get_last_error());
+}
+
+TEST_F(DeadlinePlayerStreamTest, TestThinkTimeOfTheLastReply) {
+    constexpr int DELAY_MS = 20;
+    EXPECT_EQ(0, stream->get_think_time_us());
+    stream->set_timeout_ms(1000);
+    *stream << "MOVE" << std::endl;
+    Reply({"PAPER\n"}, DELAY_MS);
+    std::string line;
+    ASSERT_TRUE(std::getline(*stream, line));
+    EXPECT_GE(stream->get_think_time_us(), DELAY_MS * 1000);
+    EXPECT_LT(stream->get_think_time_us(), 1000 * 1000);
+}
+
+TEST_F(DeadlinePlayerStreamTest, TestEveryRequestIsTimed) {
+    constexpr int DELAY_MS = 20;
+    stream->set_timeout_ms(1000);
+    std::string line;
+    for (int i = 0; i < 2; i++) {
+        *stream << "MOVE" << std::endl;
+        Reply({"ROCK\n"}, DELAY_MS);
+        ASSERT_TRUE(std::getline(*stream, line));
+        bot.join();
+    }
+    stream->set_timeout_ms(SHORT_TIMEOUT_MS);
+    *stream << "MOVE" << std::endl;
+    EXPECT_FALSE(std::getline(*stream, line));
+
+    latency_histogram times = stream->get_response_times();
+    EXPECT_EQ(2, times.count());
+    EXPECT_EQ(1, times.timeouts());
+    EXPECT_GE(times.percentile_us(0.5), DELAY_MS * 1000 * 15 / 16);
+}
+
+class FramePlayerStreamTest : public PlayerStreamTestBase {
+   protected:
+    FramePlayerStreamTest()
+        : input(GetReadPipe(), -1), output(-1, GetWritePipe()) {}
+
+    playerstream input;
+    playerstream output;
+};
+
+TEST_F(FramePlayerStreamTest, TestFramesAndLinesMix) {
+    std::string binary("\0\n\xff payload", 11);
+    ASSERT_TRUE(output.write_frame(binary));
+    output << "after" << std::endl;
+    ASSERT_TRUE(output.write_frame(""));
+    output.flush();
+
+    std::string_view frame;
+    ASSERT_TRUE(input.read_frame(frame));
+    EXPECT_EQ(frame, binary);
+    std::string line;
+    ASSERT_TRUE(std::getline(input, line));
+    EXPECT_EQ(line, "after");
+    ASSERT_TRUE(input.read_frame(frame));
+    EXPECT_EQ(frame, "");
+}
+
+TEST_F(FramePlayerStreamTest, TestFrameLargerThanTheBuffer) {
+    std::string big(10 * playerbuf::BUF_SIZE + 3, 'b');
+    output.set_write_timeout_ms(5000);
+    std::thread writer([&] {
+        EXPECT_TRUE(output.write_frame(big));
+        output.flush();
+    });
+    std::string_view frame;
+    ASSERT_TRUE(input.read_frame(frame));
+    EXPECT_EQ(frame, big);
+    writer.join();
+}
+
+TEST_F(FramePlayerStreamTest, TestOversizedFramesAreRejected) {
+    output.set_max_frame_size(4);
+    EXPECT_FALSE(output.write_frame("12345"));
+    EXPECT_EQ(EMSGSIZE, output.get_last_error());
+
+    ASSERT_TRUE(output.write_frame("1234"));
+    output.flush();
+    input.set_max_frame_size(3);
+    std::string_view frame;
+    EXPECT_FALSE(input.read_frame(frame));
+    EXPECT_EQ(EMSGSIZE, input.get_last_error());
+}
+
+TEST_F(FramePlayerStreamTest, TestIncompleteFrameTimesOut) {
+    input.set_timeout_ms(TIMEOUT_MS_SHORT);
+    ASSERT_EQ(6, write(GetWritePipe(), "\x05\0\0\0ab", 6));
+    std::string_view frame;
+    EXPECT_FALSE(input.read_frame(frame));
+    EXPECT_EQ(ETIME, input.get_last_error());
+}
+
 }  // namespace
@@ -0,0 +1,205 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "engine.h"
+#include "err.h"
+#include "resultcache.h"
+
+namespace {
+
+using Engine::GameResult;
+using Judge::ContentHash;
+using Judge::ContentHasher;
+using Judge::ResultCache;
+
+ContentHash key_of(int i) {
+    ContentHasher hasher;
+    hasher.update(static_cast<uint64_t>(i));
+    return hasher.digest();
+}
+
+GameResult result_of(int i) {
+    return GameResult::createRecorded(
+        i % 2 ? GameResult::Win : GameResult::Draw,
+        {i % 2 ? 1.0 : 0.5, i % 2 ? 0.0 : 0.5},
+        "match " + std::to_string(i));
+}
+
+class ResultCacheTest : public ::testing::Test {
+   protected:
+    ResultCacheTest() {
+        char dir_template[] = "/tmp/resultcache_test.XXXXXX";
+        if (mkdtemp(dir_template) == nullptr)
+            syserr("mkdtemp");
+        dir = dir_template;
+        path = dir + "/results.cache";
+    }
+
+    ~ResultCacheTest() {
+        unlink(path.c_str());
+        unlink((path + ".idx").c_str());
+        rmdir(dir.c_str());
+    }
+
+    off_t fileSize(const std::string& file) {
+        struct stat st;
+        SYSCALL_WITH_CHECK(stat(file.c_str(), &st));
+        return st.st_size;
+    }
+
+    void expectCached(ResultCache& cache, int i) {
+        std::optional<Judge::CachedResult> cached = cache.find(key_of(i));
+        ASSERT_TRUE(cached.has_value()) << "result " << i;
+        EXPECT_EQ(cached->result.type, result_of(i).type);
+        EXPECT_EQ(cached->result.player_scores, result_of(i).player_scores);
+        EXPECT_EQ(cached->result.pretty_result, result_of(i).pretty_result);
+        EXPECT_EQ(cached->game_us, 1000 + i);
+    }
+
+    std::string dir;
+    std::string path;
+};
+
+TEST(ContentHasherTest, TestChunkingDoesNotMatter) {
+    std::string data;
+    for (int i = 0; i < 1000; i++)
+        data += static_cast<char>(i * 7);
+    for (size_t length : {0, 1, 8, 15, 16, 17, 31, 100, 1000}) {
+        ContentHasher whole;
+        whole.update(data.data(), length);
+        ContentHasher pieces;
+        for (size_t at = 0; at < length; at += 3)
+            pieces.update(data.data() + at, std::min<size_t>(3, length - at));
+        EXPECT_EQ(whole.digest(), pieces.digest()) << "length " << length;
+    }
+}
+
+TEST(ContentHasherTest, TestInputsAreTold) {
+    ContentHasher empty;
+    ContentHasher byte;
+    byte.update("a", 1);
+    EXPECT_NE(empty.digest(), byte.digest());
+    // Strings carry their lengths.
+    ContentHasher ab_c, a_bc;
+    ab_c.update(std::string_view("ab"));
+    ab_c.update(std::string_view("c"));
+    a_bc.update(std::string_view("a"));
+    a_bc.update(std::string_view("bc"));
+    EXPECT_NE(ab_c.digest(), a_bc.digest());
+    EXPECT_EQ(key_of(1).hex().size(), 32u);
+    EXPECT_NE(key_of(1).hex(), key_of(2).hex());
+}
+
+TEST(ContentHasherTest, TestFindProgram) {
+    EXPECT_EQ(Judge::find_program("./judgetest"), "./judgetest");
+    EXPECT_EQ(Judge::find_program("./no-such-bot"), "");
+    EXPECT_NE(Judge::find_program("sh"), "");
+    EXPECT_EQ(Judge::find_program("no-such-bot-anywhere"), "");
+    EXPECT_EQ(Judge::hash_file("./judgetest"),
+              Judge::hash_file("./judgetest"));
+}
+
+TEST_F(ResultCacheTest, TestInsertAndFind) {
+    ResultCache cache(path);
+    EXPECT_FALSE(cache.find(key_of(1)).has_value());
+    cache.insert(key_of(1), result_of(1), 1001);
+    cache.insert(key_of(2), result_of(2), 1002);
+    expectCached(cache, 1);
+    expectCached(cache, 2);
+    // A key is stored once.
+    cache.insert(key_of(1), result_of(3), 5);
+    expectCached(cache, 1);
+    EXPECT_EQ(cache.size(), 2u);
+}
+
+TEST_F(ResultCacheTest, TestResultsOutliveTheCache) {
+    {
+        ResultCache cache(path);
+        for (int i = 0; i < 10; i++)
+            cache.insert(key_of(i), result_of(i), 1000 + i);
+    }
+    ResultCache cache(path);
+    EXPECT_EQ(cache.size(), 10u);
+    for (int i = 0; i < 10; i++)
+        expectCached(cache, i);
+}
+
+TEST_F(ResultCacheTest, TestIndexGrows) {
+    const int results = 5000;
+    {
+        ResultCache cache(path);
+        for (int i = 0; i < results; i++)
+            cache.insert(key_of(i), result_of(i), 1000 + i);
+        EXPECT_EQ(cache.size(), static_cast<uint64_t>(results));
+    }
+    // 64-byte header and 24-byte slots, at most half of them taken.
+    off_t index_size = fileSize(path + ".idx");
+    EXPECT_GE(index_size, 64 + 2 * 24 * results);
+    EXPECT_LE(index_size, 64 + 4 * 24 * results);
+    ResultCache cache(path);
+    for (int i = 0; i < results; i++)
+        expectCached(cache, i);
+    EXPECT_FALSE(cache.find(key_of(results)).has_value());
+}
+
+TEST_F(ResultCacheTest, TestLostIndexIsRebuilt) {
+    {
+        ResultCache cache(path);
+        for (int i = 0; i < 20; i++)
+            cache.insert(key_of(i), result_of(i), 1000 + i);
+    }
+    unlink((path + ".idx").c_str());
+    ResultCache cache(path);
+    EXPECT_EQ(cache.size(), 20u);
+    for (int i = 0; i < 20; i++)
+        expectCached(cache, i);
+}
+
+TEST_F(ResultCacheTest, TestUnindexedAndTornRecords) {
+    std::string old_index = dir + "/old.idx";
+    {
+        ResultCache cache(path);
+        cache.insert(key_of(1), result_of(1), 1001);
+    }
+    // Keep the index of one result, as if the judge had died after
+    // appending the next two without indexing them.
+    {
+        std::ifstream in(path + ".idx", std::ios::binary);
+        std::ofstream out(old_index, std::ios::binary);
+        out << in.rdbuf();
+    }
+    {
+        ResultCache cache(path);
+        cache.insert(key_of(2), result_of(2), 1002);
+        cache.insert(key_of(3), result_of(3), 1003);
+    }
+    off_t complete = fileSize(path);
+    ASSERT_EQ(rename(old_index.c_str(), (path + ".idx").c_str()), 0);
+    // And a record torn by a crash.
+    int fd;
+    SYSCALL_WITH_CHECK(fd = open(path.c_str(), O_WRONLY | O_APPEND));
+    ASSERT_EQ(write(fd, "torn", 4), 4);
+    SYSCALL_WITH_CHECK(close(fd));
+
+    ResultCache cache(path);
+    EXPECT_EQ(cache.size(), 3u);
+    for (int i = 1; i <= 3; i++)
+        expectCached(cache, i);
+    EXPECT_EQ(fileSize(path), complete);
+}
+
+TEST_F(ResultCacheTest, TestOneJudgeAtATime) {
+    ResultCache cache(path);
+    EXPECT_EXIT({ ResultCache other(path); }, ::testing::ExitedWithCode(1),
+                "used by another judge");
+}
+
+}  // namespace
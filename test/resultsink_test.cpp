@@ -0,0 +1,178 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "err.h"
+#include "resultsink.h"
+
+namespace {
+
+using Judge::MatchRecord;
+using Judge::ResultSink;
+
+MatchRecord make_record(int match_id) {
+    MatchRecord record;
+    record.match_id = match_id;
+    record.game = "rsp";
+    record.bots = {"./rock", "./paper"};
+    record.seeds = {7, 42};
+    record.scores = {0, 1};
+    record.result = "win";
+    record.duration_us = 1500;
+    record.details = "./paper won 6-4";
+    return record;
+}
+
+class ResultSinkTest : public ::testing::Test {
+   protected:
+    ResultSinkTest() {
+        char dir_template[] = "/tmp/resultsink_test.XXXXXX";
+        if (mkdtemp(dir_template) == nullptr)
+            syserr("mkdtemp");
+        dir = dir_template;
+    }
+
+    ~ResultSinkTest() {
+        for (const std::string& path : paths)
+            unlink(path.c_str());
+        rmdir(dir.c_str());
+    }
+
+    std::string path(const std::string& name) {
+        paths.push_back(dir + "/" + name);
+        return paths.back();
+    }
+
+    static std::vector<std::string> read_lines(const std::string& file) {
+        std::ifstream in(file);
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(in, line))
+            lines.push_back(line);
+        return lines;
+    }
+
+    std::string dir;
+    std::vector<std::string> paths;
+};
+
+TEST(ResultSinkFormatTest, TestFormatFollowsExtension) {
+    EXPECT_EQ(ResultSink::formatFor("results.csv"), ResultSink::Format::Csv);
+    EXPECT_EQ(ResultSink::formatFor("results.jsonl"),
+              ResultSink::Format::Jsonl);
+    EXPECT_EQ(ResultSink::formatFor("csv"), ResultSink::Format::Jsonl);
+}
+
+TEST(ResultSinkFormatTest, TestJsonRecord) {
+    MatchRecord record = make_record(3);
+    record.scores = {0.5, 0.5};
+    record.result = "draw";
+    record.details = "tab\there \"quoted\" back\\slash\nnext\x01";
+    EXPECT_EQ(ResultSink::formatRecord(ResultSink::Format::Jsonl, record),
+              "{\"match\":3,\"game\":\"rsp\","
+              "\"bots\":[\"./rock\",\"./paper\"],"
+              "\"seeds\":[7,42],\"scores\":[0.5,0.5],\"result\":\"draw\","
+              "\"duration_us\":1500,\"details\":\"tab\\there \\\"quoted\\\" "
+              "back\\\\slash\\nnext\\u0001\"}\n");
+}
+
+TEST(ResultSinkFormatTest, TestCsvRecord) {
+    MatchRecord record = make_record(4);
+    record.bots = {"./a,b", "./c"};
+    record.details = "said \"hi\"";
+    EXPECT_EQ(ResultSink::formatRecord(ResultSink::Format::Csv, record),
+              "4,rsp,\"./a,b;./c\",7;42,0;1,win,1500,\"said \"\"hi\"\"\"\n");
+}
+
+TEST_F(ResultSinkTest, TestRecordsAreBufferedUntilFlush) {
+    std::string file = path("results.jsonl");
+    ResultSink sink(file, ResultSink::Format::Jsonl, 1);
+    sink.append(0, make_record(0));
+    EXPECT_TRUE(read_lines(file).empty());
+    sink.flush();
+    std::vector<std::string> lines = read_lines(file);
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0] + "\n", ResultSink::formatRecord(
+                                   ResultSink::Format::Jsonl, make_record(0)));
+}
+
+TEST_F(ResultSinkTest, TestFullBufferIsWrittenWithoutFlush) {
+    std::string file = path("results.jsonl");
+    ResultSink sink(file, ResultSink::Format::Jsonl, 1);
+    size_t record_size =
+        ResultSink::formatRecord(ResultSink::Format::Jsonl, make_record(0))
+            .size();
+    size_t records = ResultSink::FLUSH_BYTES / record_size + 1;
+    for (size_t i = 0; i < records; i++)
+        sink.append(0, make_record(0));
+    EXPECT_EQ(read_lines(file).size(), records);
+}
+
+TEST_F(ResultSinkTest, TestIdleBufferIsWrittenAfterTheInterval) {
+    const int interval_ms = 50;
+    std::string file = path("results.jsonl");
+    ResultSink sink(file, ResultSink::Format::Jsonl, 2, interval_ms);
+    sink.append(1, make_record(0));
+    EXPECT_TRUE(read_lines(file).empty());
+    // Nothing else is appended, and no one flushes.
+    for (int waited_ms = 0; waited_ms < 20 * interval_ms &&
+                            read_lines(file).empty();
+         waited_ms += 5)
+        usleep(5000);
+    EXPECT_EQ(read_lines(file).size(), 1u);
+}
+
+TEST_F(ResultSinkTest, TestCsvHeaderOnlyInNewFile) {
+    std::string file = path("results.csv");
+    {
+        ResultSink sink(file, ResultSink::Format::Csv, 1);
+        sink.append(0, make_record(0));
+    }
+    {
+        ResultSink sink(file, ResultSink::Format::Csv, 1);
+        sink.append(0, make_record(1));
+    }
+    std::vector<std::string> lines = read_lines(file);
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[0],
+              "match,game,bots,seeds,scores,result,duration_us,details");
+    EXPECT_EQ(lines[1].substr(0, 2), "0,");
+    EXPECT_EQ(lines[2].substr(0, 2), "1,");
+}
+
+TEST_F(ResultSinkTest, TestConcurrentWorkersWriteWholeRecords) {
+    const int workers = 4;
+    const int per_worker = 1000;
+    std::string file = path("results.jsonl");
+    {
+        ResultSink sink(file, ResultSink::Format::Jsonl, workers);
+        std::vector<std::thread> threads;
+        for (int worker = 0; worker < workers; worker++)
+            threads.emplace_back([&sink, worker] {
+                for (int i = 0; i < per_worker; i++)
+                    sink.append(worker, make_record(worker * per_worker + i));
+            });
+        for (auto& thread : threads)
+            thread.join();
+    }
+    std::vector<std::string> lines = read_lines(file);
+    ASSERT_EQ(lines.size(), static_cast<size_t>(workers * per_worker));
+    std::vector<bool> seen(workers * per_worker);
+    for (const std::string& line : lines) {
+        ASSERT_EQ(line.substr(0, 9), "{\"match\":");
+        ASSERT_EQ(line.back(), '}');
+        int match_id = std::stoi(line.substr(9));
+        EXPECT_FALSE(seen[match_id]);
+        seen[match_id] = true;
+    }
+}
+
+}  // namespace
@@ -0,0 +1,159 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+#include "engine.h"
+#include "engineplugin.h"
+#include "err.h"
+
+namespace {
+
+using Engine::GameResult;
+using Engine::PlayerData;
+
+// The example engine plays 10 rounds, and asks for the 9 after the first
+// in one batch if both players offer batches.
+constexpr int ROUNDS = 10;
+
+const char* const MOVES[] = {"ROCK", "PAPER", "SCISSORS"};
+
+// A game of the example RSP engine between two players whose replies are
+// written before it starts.
+class RspMatch {
+   public:
+    RspMatch(const std::vector<std::string>& replies0,
+             const std::vector<std::string>& replies1) {
+        const std::vector<std::string>* replies[] = {&replies0, &replies1};
+        for (int id = 0; id < 2; id++) {
+            int to_player[2], from_player[2];
+            SYSCALL_WITH_CHECK(pipe(to_player));
+            SYSCALL_WITH_CHECK(pipe(from_player));
+            for (const std::string& reply : *replies[id]) {
+                std::string line = reply + "\n";
+                EXPECT_EQ(write(from_player[PIPE_WRITE_END], line.data(),
+                                line.size()),
+                          static_cast<ssize_t>(line.size()));
+            }
+            players.emplace_back(from_player[PIPE_READ_END],
+                                 to_player[PIPE_WRITE_END], -1,
+                                 "bot" + std::to_string(id), id);
+            request_fds.push_back(to_player[PIPE_READ_END]);
+            fds.insert(fds.end(), {to_player[0], to_player[1],
+                                   from_player[0], from_player[1]});
+        }
+    }
+
+    ~RspMatch() {
+        players.clear();
+        for (int fd : fds)
+            close(fd);
+    }
+
+    GameResult play() {
+        static const Judge::Game game =
+            Judge::load_engine_plugin("./rsp_engine.so");
+        return game.play_game(players);
+    }
+
+    // Everything the engine sent player `id`.
+    std::string requests(int id) {
+        SYSCALL_WITH_CHECK(fcntl(request_fds[id], F_SETFL, O_NONBLOCK));
+        std::string sent;
+        char buf[4096];
+        ssize_t rv;
+        while ((rv = read(request_fds[id], buf, sizeof(buf))) > 0)
+            sent.append(buf, rv);
+        return sent;
+    }
+
+   private:
+    std::vector<PlayerData> players;
+    std::vector<int> request_fds;
+    std::vector<int> fds;
+};
+
+// `moves` as the replies of a player that answers every MOVE alone, or
+// batches if `batch`.
+std::vector<std::string> replies_of(const std::vector<std::string>& moves,
+                                    bool batch) {
+    if (!batch)
+        return moves;
+    std::string rest;
+    for (size_t i = 1; i < moves.size(); i++)
+        rest += (i > 1 ? " " : "") + moves[i];
+    return {moves[0] + " BATCH", rest};
+}
+
+std::vector<std::string> repeat(const std::string& move, int times) {
+    return std::vector<std::string>(times, move);
+}
+
+TEST(RspEngineTest, AsksForBatchesIfBothPlayersOfferThem) {
+    RspMatch match(replies_of(repeat("ROCK", ROUNDS), true),
+                   replies_of(repeat("SCISSORS", ROUNDS), true));
+    GameResult result = match.play();
+    EXPECT_EQ(result.pretty_result, "Player #0 (bot0) won [10-0]");
+    EXPECT_EQ(match.requests(0), "MOVE\nMOVES 9\n");
+    EXPECT_EQ(match.requests(1), "MOVE\nMOVES 9\n");
+}
+
+TEST(RspEngineTest, AsksMoveByMoveIfAPlayerDoesNotOfferBatches) {
+    std::vector<std::string> offering = repeat("ROCK BATCH", ROUNDS);
+    RspMatch match(offering, repeat("SCISSORS", ROUNDS));
+    GameResult result = match.play();
+    EXPECT_EQ(result.pretty_result, "Player #0 (bot0) won [10-0]");
+    std::string one_by_one;
+    for (int round = 0; round < ROUNDS; round++)
+        one_by_one += "MOVE\n";
+    EXPECT_EQ(match.requests(0), one_by_one);
+    EXPECT_EQ(match.requests(1), one_by_one);
+}
+
+TEST(RspEngineTest, AShortBatchLosesAtItsFirstMissingMove) {
+    RspMatch match({"ROCK BATCH", "ROCK ROCK ROCK"},
+                   replies_of(repeat("ROCK", ROUNDS), true));
+    GameResult result = match.play();
+    EXPECT_EQ(result.type, GameResult::Win);
+    EXPECT_EQ(result.player_scores, (std::vector<double>{0, 1}));
+    EXPECT_EQ(result.pretty_result,
+              "Player #1 (bot1) won [Win by opponent error: move not "
+              "recognized: '']");
+}
+
+TEST(RspEngineTest, MovesBeyondTheBatchAreIgnored) {
+    std::vector<std::string> overlong =
+        replies_of(repeat("PAPER", ROUNDS), true);
+    overlong[1] += " SCISSORS SCISSORS";
+    RspMatch match(overlong, replies_of(repeat("ROCK", ROUNDS), true));
+    GameResult result = match.play();
+    EXPECT_EQ(result.pretty_result, "Player #0 (bot0) won [10-0]");
+}
+
+TEST(RspEngineTest, BatchesScoreLikeSingleMoves) {
+    std::mt19937 random(20240617);
+    for (int game = 0; game < 20; game++) {
+        std::vector<std::string> moves[2];
+        for (int id = 0; id < 2; id++) {
+            for (int round = 0; round < ROUNDS; round++)
+                moves[id].push_back(MOVES[random() % 3]);
+        }
+        RspMatch batched(replies_of(moves[0], true),
+                         replies_of(moves[1], true));
+        RspMatch single(replies_of(moves[0], false),
+                        replies_of(moves[1], false));
+        GameResult expected = single.play();
+        GameResult result = batched.play();
+        EXPECT_EQ(result.type, expected.type) << game;
+        EXPECT_EQ(result.player_scores, expected.player_scores) << game;
+        EXPECT_EQ(result.pretty_result, expected.pretty_result) << game;
+        EXPECT_EQ(batched.requests(0), "MOVE\nMOVES 9\n") << game;
+    }
+}
+
+}  // namespace
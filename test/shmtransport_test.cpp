@@ -0,0 +1,144 @@
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "botsdk.h"
+#include "common.h"
+#include "engine.h"
+#include "err.h"
+#include "exchange.h"
+#include "shmtransport.h"
+
+namespace {
+
+using Engine::PlayerData;
+using Engine::Reply;
+using Judge::ShmTransport;
+
+// Both ends of the transport in one process. The pipes stand in for the
+// bot's stdin and stdout, which only report hangups.
+class ShmTransportTest : public ::testing::Test {
+   protected:
+    static constexpr uint32_t RING_SIZE = 4096;
+
+    ShmTransportTest() {
+        playerstream_base::ignore_sigpipe();
+        SYSCALL_WITH_CHECK(pipe(botStdin));
+        SYSCALL_WITH_CHECK(pipe(botStdout));
+        transport = std::make_shared<ShmTransport>(botStdout[PIPE_READ_END],
+                                                   RING_SIZE);
+        std::vector<Judge::FdMapping> fds = transport->getChildFds();
+        bot.reset(new Bot::Connection(std::unique_ptr<Bot::ShmChannel>(
+            new Bot::ShmChannel(fds[0].parent_fd, fds[1].parent_fd,
+                                fds[2].parent_fd, botStdin[PIPE_READ_END]))));
+    }
+
+    ~ShmTransportTest() {
+        if (botThread.joinable())
+            botThread.join();
+        bot.reset();
+        transport.reset();
+        for (int fd : {botStdin[0], botStdin[1], botStdout[0], botStdout[1]})
+            if (fd != -1)
+                close(fd);
+    }
+
+    // Runs a bot that answers every line with `prefix` and the line.
+    void Echo(const std::string& prefix, int lines) {
+        botThread = std::thread([this, prefix, lines] {
+            std::string_view line;
+            for (int i = 0; i < lines && bot->readLine(line); i++) {
+                bot->write(prefix);
+                bot->reply(line);
+            }
+        });
+    }
+
+    void BotExits() {
+        close(botStdout[PIPE_WRITE_END]);
+        botStdout[PIPE_WRITE_END] = -1;
+    }
+
+    int botStdin[2];
+    int botStdout[2];
+    std::shared_ptr<ShmTransport> transport;
+    std::unique_ptr<Bot::Connection> bot;
+    std::thread botThread;
+};
+
+TEST_F(ShmTransportTest, TestPlayerstreamRoundTrip) {
+    Echo("echo ", 2);
+    playerstream stream(transport);
+    std::string line;
+    for (const char* msg : {"MOVE", "NEWGAME 7"}) {
+        stream << msg << std::endl;
+        ASSERT_TRUE(std::getline(stream, line));
+        EXPECT_EQ(line, std::string("echo ") + msg);
+    }
+}
+
+TEST_F(ShmTransportTest, TestMessagesLargerThanTheRings) {
+    Echo("", 1);
+    playerstream stream(transport);
+    stream.set_write_timeout_ms(5000);
+    std::string msg(25 * RING_SIZE + 17, 'x');
+    stream << msg << std::endl;
+    ASSERT_TRUE(stream.good());
+    std::string line;
+    ASSERT_TRUE(std::getline(stream, line));
+    EXPECT_EQ(line, msg);
+}
+
+TEST_F(ShmTransportTest, TestExchangeOverSharedMemory) {
+    Echo("", 1);
+    std::vector<PlayerData> players;
+    players.emplace_back(transport, -1, "bot", 0);
+    std::vector<Reply> replies = Engine::exchange(players, "ROCK", 1000);
+    ASSERT_TRUE(replies[0].ok());
+    EXPECT_EQ(replies[0].line, "ROCK");
+}
+
+TEST_F(ShmTransportTest, TestSilentBotTimesOut) {
+    std::vector<PlayerData> players;
+    players.emplace_back(transport, -1, "bot", 0);
+    std::vector<Reply> replies = Engine::exchange(players, "MOVE", 50);
+    EXPECT_EQ(replies[0].status, Reply::Timeout);
+}
+
+TEST_F(ShmTransportTest, TestLastWordsBeforeExitAreRead) {
+    bot->reply("bye");
+    BotExits();
+    playerstream stream(transport);
+    std::string line;
+    ASSERT_TRUE(std::getline(stream, line));
+    EXPECT_EQ(line, "bye");
+    EXPECT_FALSE(std::getline(stream, line));
+}
+
+TEST_F(ShmTransportTest, TestWritesFailOnceTheBotIsGone) {
+    BotExits();
+    playerstream stream(transport);
+    stream << std::string(2 * RING_SIZE, 'x') << std::flush;
+    EXPECT_FALSE(stream.good());
+    EXPECT_EQ(stream.get_last_error(), EPIPE);
+}
+
+TEST_F(ShmTransportTest, TestBotNoticesTheJudgeIsGone) {
+    close(botStdin[PIPE_WRITE_END]);
+    botStdin[PIPE_WRITE_END] = -1;
+    std::string_view line;
+    EXPECT_FALSE(bot->readLine(line));
+}
+
+TEST(ShmChannelTest, TestNoChannelWithoutEnvironment) {
+    unsetenv(Shm::ENV_VAR);
+    EXPECT_EQ(Bot::ShmChannel::fromEnvironment(), nullptr);
+}
+
+}  // namespace
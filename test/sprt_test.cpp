@@ -0,0 +1,99 @@
+#include <cmath>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "sprt.h"
+
+namespace {
+
+using Judge::ScoreStats;
+using Judge::Sprt;
+
+// Plays matches where the first bot wins with probability `win`, draws
+// with probability `draw` and loses otherwise, until the test decides.
+Sprt::Decision run_until_decided(const Sprt& sprt,
+                                 double win,
+                                 double draw,
+                                 unsigned seed,
+                                 int& matches) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    ScoreStats stats;
+    while (sprt.decide(stats) == Sprt::Decision::Continue &&
+           stats.getMatches() < 1000000) {
+        double u = uniform(random);
+        stats.add(u < win ? 1 : u < win + draw ? 0.5 : 0);
+    }
+    matches = stats.getMatches();
+    return sprt.decide(stats);
+}
+
+TEST(SprtTest, TestEloConversion) {
+    EXPECT_DOUBLE_EQ(Judge::elo_to_score(0), 0.5);
+    EXPECT_NEAR(Judge::elo_to_score(400), 10.0 / 11, 1e-12);
+    EXPECT_NEAR(Judge::score_to_elo(0.75), 190.85, 0.01);
+    EXPECT_NEAR(Judge::score_to_elo(Judge::elo_to_score(-35)), -35, 1e-9);
+}
+
+TEST(SprtTest, TestScoreStatsCountAVirtualWinAndLoss) {
+    ScoreStats stats;
+    EXPECT_EQ(stats.getMatches(), 0);
+    EXPECT_DOUBLE_EQ(stats.mean(), 0.5);
+    EXPECT_DOUBLE_EQ(stats.variance(), 0.25);
+    for (int i = 0; i < 2; i++)
+        stats.add(0.5);
+    EXPECT_EQ(stats.getMatches(), 2);
+    EXPECT_DOUBLE_EQ(stats.mean(), 0.5);
+    EXPECT_DOUBLE_EQ(stats.variance(), 0.125);
+    EXPECT_GT(stats.halfWidth(), 0);
+}
+
+TEST(SprtTest, TestHalfWidthShrinksWithMatches) {
+    ScoreStats stats;
+    for (int i = 0; i < 100; i++)
+        stats.add(i % 2);
+    double after_100 = stats.halfWidth();
+    for (int i = 0; i < 300; i++)
+        stats.add(i % 2);
+    EXPECT_NEAR(stats.halfWidth(), after_100 / 2, after_100 * 0.01);
+    EXPECT_NEAR(after_100, 1.96 * 0.5 / std::sqrt(102), 0.002);
+}
+
+TEST(SprtTest, TestBounds) {
+    Sprt sprt(0, 10, 0.05, 0.1);
+    EXPECT_DOUBLE_EQ(sprt.getLowerBound(), std::log(0.1 / 0.95));
+    EXPECT_DOUBLE_EQ(sprt.getUpperBound(), std::log(0.9 / 0.05));
+    EXPECT_EQ(sprt.decide(ScoreStats()), Sprt::Decision::Continue);
+}
+
+TEST(SprtTest, TestLopsidedPairIsDecidedQuickly) {
+    Sprt sprt(0, 10);
+    int matches;
+    EXPECT_EQ(run_until_decided(sprt, 1, 0, 1, matches),
+              Sprt::Decision::AcceptH1);
+    EXPECT_LT(matches, 100);
+    EXPECT_EQ(run_until_decided(sprt, 0, 0, 1, matches),
+              Sprt::Decision::AcceptH0);
+    EXPECT_LT(matches, 100);
+}
+
+TEST(SprtTest, TestDecidesForTheTrueHypothesis) {
+    // 60 Elo against 0 Elo, each tested on several seeds.
+    Sprt sprt(0, 60);
+    const double strong = Judge::elo_to_score(60);
+    int wrong = 0;
+    for (unsigned seed = 1; seed <= 20; seed++) {
+        int matches;
+        if (run_until_decided(sprt, strong - 0.15, 0.3, seed, matches) !=
+            Sprt::Decision::AcceptH1)
+            wrong++;
+        if (run_until_decided(sprt, 0.35, 0.3, seed + 100, matches) !=
+            Sprt::Decision::AcceptH0)
+            wrong++;
+    }
+    // alpha = beta = 0.05, so about 2 of the 40 runs may go wrong.
+    EXPECT_LE(wrong, 6);
+}
+
+}  // namespace
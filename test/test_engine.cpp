@@ -0,0 +1,17 @@
+// The engine plugin engineplugin_test.cpp loads: asks both players for a
+// move once and calls it a draw, with their answers as the details.
+
+#include "engineplugin.h"
+#include "exchange.h"
+
+namespace Engine {
+
+GameResult play_game(std::vector<PlayerData>& players) noexcept {
+    std::vector<Reply> replies = exchange(players, "MOVE", 1000);
+    return GameResult::createDraw(players,
+                                  replies[0].line + "-" + replies[1].line);
+}
+
+}  // namespace Engine
+
+BOTS_JUDGE_ENGINE("test")
@@ -0,0 +1,80 @@
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "err.h"
+#include "timebudget.h"
+
+namespace {
+
+using Engine::TimeBudget;
+
+// A child that burns CPU until killed.
+class BusyChild {
+   public:
+    BusyChild() {
+        SYSCALL_WITH_CHECK(pid = fork());
+        if (pid == 0) {
+            volatile unsigned long counter = 0;
+            while (true)
+                counter = counter + 1;
+        }
+    }
+
+    ~BusyChild() {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+
+    pid_t pid;
+};
+
+TEST(TimeBudgetTest, TestUnlimitedBudgetNeverExpires) {
+    TimeBudget budget;
+    EXPECT_FALSE(budget.isLimited());
+    budget.startMove();
+    EXPECT_TRUE(budget.stopMove());
+    EXPECT_FALSE(budget.isExpired());
+    EXPECT_EQ(-1, budget.getWallTimeoutMs());
+}
+
+TEST(TimeBudgetTest, TestIdleBotIsChargedAlmostNothing) {
+    pid_t pid;
+    SYSCALL_WITH_CHECK(pid = fork());
+    if (pid == 0) {
+        pause();
+        _exit(0);
+    }
+    TimeBudget budget(pid, 10, 5);
+    budget.startMove();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_TRUE(budget.stopMove());
+    EXPECT_LT(budget.getLastMoveUs(), 5000);
+    EXPECT_GE(budget.getRemainingMs(), 10);
+    EXPECT_EQ(1, budget.getMoves());
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+TEST(TimeBudgetTest, TestBusyBotRunsOutOfTime) {
+    BusyChild child;
+    TimeBudget budget(child.pid, 20, 0);
+    budget.startMove();
+    // Wait until the child has used up the budget, however busy the machine.
+    for (int i = 0; i < 1000; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        TimeBudget probe = budget;
+        if (!probe.stopMove())
+            break;
+    }
+    EXPECT_FALSE(budget.stopMove());
+    EXPECT_TRUE(budget.isExpired());
+    EXPECT_GE(budget.getUsedUs(), 20000);
+}
+
+}  // namespace
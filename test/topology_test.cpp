@@ -0,0 +1,157 @@
+#include <dirent.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "err.h"
+#include "topology.h"
+
+namespace {
+
+using Judge::CpuCore;
+using Judge::MatchSlot;
+
+TEST(TopologyTest, TestParseCpuList) {
+    EXPECT_EQ(Judge::parse_cpu_list("0-3,8,10-11\n"),
+              (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(Judge::parse_cpu_list("5"), (std::vector<int>{5}));
+    EXPECT_TRUE(Judge::parse_cpu_list("").empty());
+}
+
+TEST(TopologyTest, TestSmtSlotsUseSiblingsForTheJudge) {
+    // One package, four cores with two hardware threads each.
+    std::vector<CpuCore> cores;
+    for (int core = 0; core < 4; core++)
+        cores.push_back({0, core, {core, core + 4}});
+
+    std::vector<MatchSlot> slots = Judge::plan_match_slots(cores, 2);
+    ASSERT_EQ(slots.size(), 2u);
+    EXPECT_EQ(slots[0].bot_cpus, (std::vector<int>{0, 1}));
+    EXPECT_EQ(slots[0].judge_cpus, (std::vector<int>{4, 5}));
+    EXPECT_EQ(slots[1].bot_cpus, (std::vector<int>{2, 3}));
+    EXPECT_EQ(slots[1].judge_cpus, (std::vector<int>{6, 7}));
+}
+
+TEST(TopologyTest, TestSlotsNeverSpanPackages) {
+    // Two packages of three single-threaded cores: one judge core and one
+    // slot per package; the bots of a slot share a package.
+    std::vector<CpuCore> cores;
+    for (int cpu = 0; cpu < 6; cpu++)
+        cores.push_back({cpu / 3, cpu % 3, {cpu}});
+
+    std::vector<MatchSlot> slots = Judge::plan_match_slots(cores, 2);
+    ASSERT_EQ(slots.size(), 2u);
+    EXPECT_EQ(slots[0].bot_cpus, (std::vector<int>{1, 2}));
+    EXPECT_EQ(slots[0].judge_cpus, (std::vector<int>{0}));
+    EXPECT_EQ(slots[1].bot_cpus, (std::vector<int>{4, 5}));
+    EXPECT_EQ(slots[1].judge_cpus, (std::vector<int>{3}));
+}
+
+TEST(TopologyTest, TestTooFewCoresGiveNoSlots) {
+    std::vector<CpuCore> cores = {{0, 0, {0}}, {0, 1, {1}}};
+    EXPECT_TRUE(Judge::plan_match_slots(cores, 2).empty());
+    EXPECT_TRUE(Judge::plan_match_slots({}, 2).empty());
+}
+
+std::vector<pid_t> threads_of(pid_t pid) {
+    std::vector<pid_t> tids;
+    DIR* dir = opendir(("/proc/" + std::to_string(pid) + "/task").c_str());
+    if (dir == nullptr)
+        syserr("opendir");
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.')
+            tids.push_back(atoi(entry->d_name));
+    }
+    closedir(dir);
+    return tids;
+}
+
+TEST(TopologyTest, TestPinningAProcessPinsAllItsThreads) {
+    cpu_set_t allowed;
+    SYSCALL_WITH_CHECK(sched_getaffinity(0, sizeof(allowed), &allowed));
+    int cpu = CPU_SETSIZE - 1;
+    while (!CPU_ISSET(cpu, &allowed))
+        cpu--;
+
+    pid_t pid;
+    SYSCALL_WITH_CHECK(pid = fork());
+    if (pid == 0) {
+        std::thread([] { pause(); }).detach();
+        pause();
+        _exit(0);
+    }
+    while (threads_of(pid).size() < 2)
+        usleep(1000);
+    Judge::pin_to_cpus(pid, {cpu});
+    for (pid_t tid : threads_of(pid)) {
+        cpu_set_t set;
+        SYSCALL_WITH_CHECK(sched_getaffinity(tid, sizeof(set), &set));
+        EXPECT_EQ(CPU_COUNT(&set), 1) << tid;
+        EXPECT_TRUE(CPU_ISSET(cpu, &set)) << tid;
+    }
+    SYSCALL_WITH_CHECK(kill(pid, SIGKILL));
+    SYSCALL_WITH_CHECK(waitpid(pid, nullptr, 0));
+}
+
+class FakeSysfsTest : public ::testing::Test {
+   protected:
+    FakeSysfsTest() {
+        char dir_template[] = "/tmp/topology_test.XXXXXX";
+        if (mkdtemp(dir_template) == nullptr)
+            syserr("mkdtemp");
+        root = dir_template;
+    }
+
+    ~FakeSysfsTest() {
+        std::string command = "rm -rf " + root;
+        if (system(command.c_str()) != 0)
+            fatal("Cannot remove %s", root.c_str());
+    }
+
+    void write(const std::string& path, const std::string& contents) {
+        std::ofstream(root + "/" + path) << contents;
+    }
+
+    void addCpu(int cpu, int package, int core_id) {
+        std::string dir = root + "/cpu" + std::to_string(cpu);
+        SYSCALL_WITH_CHECK(mkdir(dir.c_str(), 0755));
+        SYSCALL_WITH_CHECK(mkdir((dir + "/topology").c_str(), 0755));
+        std::string topology = "cpu" + std::to_string(cpu) + "/topology/";
+        write(topology + "physical_package_id", std::to_string(package));
+        write(topology + "core_id", std::to_string(core_id));
+    }
+
+    std::string root;
+};
+
+TEST_F(FakeSysfsTest, TestDetectReadsOnlineAllowedCpus) {
+    cpu_set_t allowed;
+    SYSCALL_WITH_CHECK(sched_getaffinity(0, sizeof(allowed), &allowed));
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed))
+        cpu++;
+
+    addCpu(cpu, 3, 7);
+    // Online, but never in the judge's affinity mask.
+    addCpu(CPU_SETSIZE + 1, 0, 0);
+    write("online", std::to_string(cpu) + "," +
+                        std::to_string(CPU_SETSIZE + 1) + "\n");
+
+    std::vector<CpuCore> cores = Judge::detect_cpu_cores(root);
+    ASSERT_EQ(cores.size(), 1u);
+    EXPECT_EQ(cores[0].package, 3);
+    EXPECT_EQ(cores[0].core_id, 7);
+    EXPECT_EQ(cores[0].cpus, std::vector<int>{cpu});
+}
+
+}  // namespace
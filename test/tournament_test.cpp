@@ -0,0 +1,122 @@
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "tournament.h"
+
+namespace {
+
+using Judge::Crosstable;
+using Judge::Pairing;
+using Judge::SwissPairer;
+
+std::set<std::pair<int, int>> UnorderedPairs(
+    const std::vector<Pairing>& pairings) {
+    std::set<std::pair<int, int>> result;
+    for (const Pairing& p : pairings)
+        result.emplace(std::min(p.first, p.second),
+                       std::max(p.first, p.second));
+    return result;
+}
+
+TEST(RoundRobinTest, TestEveryPairPlaysOnceWithEvenBots) {
+    constexpr int BOTS = 6;
+    auto pairings = Judge::round_robin_pairings(BOTS);
+    EXPECT_EQ(BOTS * (BOTS - 1) / 2, pairings.size());
+    EXPECT_EQ(pairings.size(), UnorderedPairs(pairings).size());
+}
+
+TEST(RoundRobinTest, TestEveryPairPlaysOnceWithOddBots) {
+    constexpr int BOTS = 7;
+    auto pairings = Judge::round_robin_pairings(BOTS);
+    EXPECT_EQ(BOTS * (BOTS - 1) / 2, pairings.size());
+    EXPECT_EQ(pairings.size(), UnorderedPairs(pairings).size());
+    for (const Pairing& p : pairings) {
+        EXPECT_NE(p.first, p.second);
+        EXPECT_LT(p.first, BOTS);
+        EXPECT_LT(p.second, BOTS);
+    }
+}
+
+TEST(RoundRobinTest, TestConsecutivePairingsUseDifferentBots) {
+    constexpr int BOTS = 8;
+    auto pairings = Judge::round_robin_pairings(BOTS);
+    for (size_t round = 0; round < pairings.size(); round += BOTS / 2) {
+        std::set<int> seen;
+        for (size_t i = round; i < round + BOTS / 2; i++) {
+            seen.insert(pairings[i].first);
+            seen.insert(pairings[i].second);
+        }
+        EXPECT_EQ(BOTS, seen.size());
+    }
+}
+
+TEST(RoundRobinTest, TestLargeLadderIsCheap) {
+    constexpr int BOTS = 500;
+    auto pairings = Judge::round_robin_pairings(BOTS);
+    EXPECT_EQ(BOTS * (BOTS - 1) / 2, pairings.size());
+}
+
+TEST(CrosstableTest, TestResultsAreRecordedForBothBots) {
+    Crosstable table(3);
+    table.addResult({0, 2}, {1.0, 0.0});
+    table.addResult({2, 0}, {0.5, 0.5});
+    EXPECT_EQ(1.5, table.getScore(0));
+    EXPECT_EQ(0.5, table.getScore(2));
+    EXPECT_EQ(1.5, table.getScore(0, 2));
+    EXPECT_EQ(0.5, table.getScore(2, 0));
+    EXPECT_EQ(2, table.getGames(0, 2));
+    EXPECT_EQ(0, table.getGames(1));
+}
+
+TEST(SwissPairerTest, TestNoRematchesWhileFreshOpponentsRemain) {
+    constexpr int BOTS = 8;
+    Crosstable table(BOTS);
+    SwissPairer pairer(BOTS);
+    std::set<std::pair<int, int>> met;
+    for (int round = 0; round < 3; round++) {
+        auto pairings = pairer.nextRound(table);
+        EXPECT_EQ(BOTS / 2, pairings.size());
+        EXPECT_EQ(-1, pairer.getBye());
+        for (const Pairing& p : pairings) {
+            auto key = std::make_pair(std::min(p.first, p.second),
+                                      std::max(p.first, p.second));
+            EXPECT_TRUE(met.insert(key).second);
+            table.addResult(p, {1.0, 0.0});
+        }
+    }
+}
+
+TEST(SwissPairerTest, TestLeadersArePairedTogether) {
+    constexpr int BOTS = 4;
+    Crosstable table(BOTS);
+    SwissPairer pairer(BOTS);
+    for (const Pairing& p : pairer.nextRound(table))
+        table.addResult(p, {1.0, 0.0});
+
+    auto pairings = pairer.nextRound(table);
+    ASSERT_EQ(2, pairings.size());
+    EXPECT_EQ(1.0, table.getScore(pairings[0].first));
+    EXPECT_EQ(1.0, table.getScore(pairings[0].second));
+}
+
+TEST(SwissPairerTest, TestOddBotGetsByeOnlyOnce) {
+    constexpr int BOTS = 5;
+    Crosstable table(BOTS);
+    SwissPairer pairer(BOTS);
+    std::set<int> byes;
+    for (int round = 0; round < BOTS; round++) {
+        auto pairings = pairer.nextRound(table);
+        EXPECT_EQ(BOTS / 2, pairings.size());
+        ASSERT_NE(-1, pairer.getBye());
+        EXPECT_TRUE(byes.insert(pairer.getBye()).second);
+        for (const Pairing& p : pairings) {
+            EXPECT_NE(pairer.getBye(), p.first);
+            EXPECT_NE(pairer.getBye(), p.second);
+        }
+    }
+}
+
+}  // namespace
@@ -0,0 +1,149 @@
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common.h"
+#include "err.h"
+#include "playerstream.h"
+#include "transcript.h"
+
+namespace {
+
+using Judge::ReplayTransport;
+using Judge::TranscriptEvent;
+using Judge::TranscriptRecorder;
+
+bool poll_readable(int fd) {
+    pollfd pfd = {fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1;
+}
+
+// Records a short game over pipes, with the test playing the bot: it
+// answers the first MOVE, ignores the second and closes its output.
+std::string record_game() {
+    int to_bot[2], from_bot[2];
+    SYSCALL_WITH_CHECK(pipe(to_bot));
+    SYSCALL_WITH_CHECK(pipe(from_bot));
+    auto recorder = std::make_shared<TranscriptRecorder>();
+    {
+        playerstream stream(from_bot[PIPE_READ_END], to_bot[PIPE_WRITE_END]);
+        stream.get_playerbuf().set_recorder(recorder);
+        stream.set_timeout_ms(50);
+        std::string line;
+
+        stream << "MOVE" << std::endl;
+        EXPECT_EQ(write(from_bot[PIPE_WRITE_END], "ROCK\n", 5), 5);
+        EXPECT_TRUE(std::getline(stream, line));
+        EXPECT_EQ(line, "ROCK");
+
+        stream << "MOVE" << std::endl;
+        EXPECT_FALSE(std::getline(stream, line));
+        EXPECT_EQ(stream.get_last_error(), ETIME);
+        stream.clear();
+
+        stream << "QUIT" << std::endl;
+        close(from_bot[PIPE_WRITE_END]);
+        EXPECT_FALSE(std::getline(stream, line));
+    }
+    close(from_bot[PIPE_READ_END]);
+    close(to_bot[PIPE_READ_END]);
+    close(to_bot[PIPE_WRITE_END]);
+    return recorder->data();
+}
+
+TEST(TranscriptTest, TestRecorderKeepsEventsInOrder) {
+    std::string transcript = record_game();
+    std::vector<TranscriptEvent> events;
+    ASSERT_TRUE(Judge::parse_transcript(transcript, events));
+    ASSERT_EQ(events.size(), 5u);
+    EXPECT_EQ(events[0].kind, TranscriptEvent::Output);
+    EXPECT_EQ(events[0].data, "MOVE\n");
+    EXPECT_EQ(events[1].kind, TranscriptEvent::Input);
+    EXPECT_EQ(events[1].data, "ROCK\n");
+    EXPECT_EQ(events[2].kind, TranscriptEvent::Output);
+    EXPECT_EQ(events[3].kind, TranscriptEvent::Output);
+    EXPECT_EQ(events[3].data, "QUIT\n");
+    EXPECT_EQ(events[4].kind, TranscriptEvent::Eof);
+    EXPECT_EQ(Judge::describe_transcript(transcript),
+              "> MOVE\n< ROCK\n> MOVE\n> QUIT\n< EOF\n");
+}
+
+TEST(TranscriptTest, TestMalformedTranscriptIsRejected) {
+    std::vector<TranscriptEvent> events;
+    EXPECT_FALSE(Judge::parse_transcript(std::string("o\x05MO", 4), events));
+    EXPECT_FALSE(Judge::parse_transcript("?\x00", events));
+}
+
+TEST(TranscriptTest, TestReplayAnswersTheSameRequests) {
+    std::string transcript = record_game();
+    auto transport = std::make_shared<ReplayTransport>(transcript);
+    playerstream stream(transport);
+    stream.set_timeout_ms(50);
+    std::string line;
+
+    char buf[16];
+    EXPECT_EQ(transport->read(buf, sizeof(buf)), -1);
+    EXPECT_EQ(errno, EAGAIN);
+    EXPECT_FALSE(poll_readable(transport->get_poll_fd()));
+
+    stream << "MOVE" << std::endl;
+    EXPECT_TRUE(poll_readable(transport->get_poll_fd()));
+    EXPECT_TRUE(std::getline(stream, line));
+    EXPECT_EQ(line, "ROCK");
+
+    stream << "MOVE" << std::endl;
+    EXPECT_FALSE(std::getline(stream, line));
+    EXPECT_EQ(stream.get_last_error(), ETIME);
+    stream.clear();
+
+    stream << "QUIT" << std::endl;
+    EXPECT_FALSE(std::getline(stream, line));
+    EXPECT_TRUE(stream.eof());
+    EXPECT_TRUE(transport->outputComplete());
+}
+
+TEST(TranscriptTest, TestReplayNoticesOtherRequests) {
+    auto transport = std::make_shared<ReplayTransport>(record_game());
+    playerstream stream(transport);
+    stream << "MOVE" << std::endl;
+    EXPECT_TRUE(transport->outputMatches());
+    EXPECT_FALSE(transport->outputComplete());
+    stream << "QUIT" << std::endl;
+    EXPECT_FALSE(transport->outputMatches());
+}
+
+TEST(TranscriptTest, TestReplayFailsWritesThatFailed) {
+    TranscriptRecorder recorder;
+    iovec iov = {const_cast<char*>("MOVE\n"), 5};
+    recorder.on_output(&iov, 1, 5);
+    recorder.on_output_error(EPIPE);
+
+    ReplayTransport transport(recorder.data());
+    EXPECT_EQ(transport.write("MOVE\nMOVE\n", 10), 5);
+    EXPECT_EQ(transport.write("MOVE\n", 5), -1);
+    EXPECT_EQ(errno, EPIPE);
+    EXPECT_TRUE(transport.outputComplete());
+}
+
+TEST(TranscriptTest, TestLongInputSpansReads) {
+    TranscriptRecorder recorder;
+    std::string reply(1000, 'x');
+    recorder.on_input(reply.data(), reply.size());
+
+    ReplayTransport transport(recorder.data());
+    std::string replayed;
+    char buf[64];
+    ssize_t n;
+    while ((n = transport.read(buf, sizeof(buf))) > 0)
+        replayed.append(buf, n);
+    EXPECT_EQ(n, -1);
+    EXPECT_EQ(replayed, reply);
+}
+
+}  // namespace
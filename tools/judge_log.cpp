@@ -0,0 +1,72 @@
+// Prints records from a match log archive written by the judge.
+//
+//   judge_log <archive>                     list all matches
+//   judge_log <archive> <match_id> [player] print the logs of one match
+
+#include "matchlog.h"
+#include "transcript.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+using Judge::MatchLogEntry;
+using Judge::MatchLogReader;
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "USAGE: %s <archive> [<match_id> [<player_id>]]\n",
+            argv0);
+    exit(1);
+}
+
+static void list_matches(const MatchLogReader& reader) {
+    std::map<uint32_t, std::pair<int, uint64_t>> matches;
+    for (const MatchLogEntry& entry : reader) {
+        if (!entry.written)
+            continue;
+        auto& summary = matches[entry.match_id];
+        summary.first++;
+        summary.second += entry.length;
+    }
+    for (const auto& [match_id, summary] : matches)
+        printf("match %u: %d records, %llu bytes\n", match_id, summary.first,
+               static_cast<unsigned long long>(summary.second));
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4)
+        usage(argv[0]);
+    MatchLogReader reader(argv[1]);
+    if (argc == 2) {
+        list_matches(reader);
+        return 0;
+    }
+
+    int match_id = atoi(argv[2]);
+    bool all_players = (argc == 3);
+    int player_id = all_players ? 0 : atoi(argv[3]);
+    auto entries = reader.find(match_id);
+    if (entries.empty()) {
+        fprintf(stderr, "No records for match %d\n", match_id);
+        return 1;
+    }
+    for (const MatchLogEntry& entry : entries) {
+        if (!all_players && entry.player_id != player_id)
+            continue;
+        if (entry.player_id < 0)
+            printf("=== match %u: %s ===\n", entry.match_id,
+                   Judge::match_log_kind_name(entry.kind));
+        else
+            printf("=== match %u, player #%d: %s ===\n", entry.match_id,
+                   entry.player_id, Judge::match_log_kind_name(entry.kind));
+        std::string payload = entry.kind == MatchLogEntry::Transcript
+                                  ? Judge::describe_transcript(
+                                        reader.view(entry))
+                                  : reader.read(entry);
+        fwrite(payload.data(), 1, payload.size(), stdout);
+        if (!payload.empty() && payload.back() != '\n')
+            putchar('\n');
+    }
+    return 0;
+}